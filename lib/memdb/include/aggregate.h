@@ -0,0 +1,424 @@
+#pragma once
+
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <thread>
+#include <algorithm>
+#include <cstring>
+
+#include "base.h"
+#include "column.h"
+#include "value.h"
+#include "dictionary.h"
+
+namespace memdb
+{
+
+    enum class AggFunc
+    {
+        COUNT,
+        SUM,
+        MIN,
+        MAX
+    };
+
+    // Aggregate function in the column list of a select query, e.g. count(id)
+    struct Aggregate
+    {
+        AggFunc func;
+        std::string column; // "*" for count(*)
+
+        Aggregate(AggFunc func, const std::string &column) : func(func), column(column) {}
+
+        // Name of the result column
+        std::string name() const
+        {
+            switch (func)
+            {
+            case AggFunc::COUNT:
+                return "count(" + column + ")";
+            case AggFunc::SUM:
+                return "sum(" + column + ")";
+            case AggFunc::MIN:
+                return "min(" + column + ")";
+            case AggFunc::MAX:
+                return "max(" + column + ")";
+            }
+            throw std::runtime_error("Unreachable");
+        }
+    };
+
+    // Groups found by the aggregation operator
+    struct Groups
+    {
+        std::vector<size_t> first_row; // row representing the group (source of the key values)
+        std::vector<int64_t> acc;      // accumulators, one per aggregate for every group
+
+        size_t size() const { return first_row.size(); }
+    };
+
+    // Hash aggregation operator.
+    // Group keys are fixed-width byte strings taken directly from the table storage,
+    // so keys are compared with memcmp and no Value objects are created per row.
+    // Rows are split into chunks which are aggregated by separate threads into
+    // local hash tables, the partial results are then merged.
+    class HashAggregator
+    {
+        static constexpr size_t BATCH_SIZE = 1024;
+        static constexpr size_t MIN_ROWS_PER_THREAD = 65536;
+        static constexpr int64_t MAX_DIRECT_RANGE = 4096;
+
+    public:
+        struct Spec
+        {
+            AggFunc func;
+            const Column *column;   // nullptr for count(*)
+            const std::vector<uint32_t> *ranks; // code to rank, for min/max of a dictionary-encoded column
+        };
+
+    private:
+        // Open addressing hash table over fixed-width keys
+        struct HashTable
+        {
+            uint16_t key_width;
+            size_t num_aggs;
+            std::vector<uint8_t> keys;
+            std::vector<uint64_t> hashes;
+            std::vector<uint32_t> slots; // group index + 1, 0 for empty slot
+            Groups groups;
+
+            HashTable(uint16_t key_width, size_t num_aggs) : key_width(key_width), num_aggs(num_aggs), slots(16, 0) {}
+
+            size_t find(const uint8_t *key, uint64_t hash, bool &found)
+            {
+                size_t mask = slots.size() - 1;
+                size_t pos = hash & mask;
+                while (slots[pos] != 0)
+                {
+                    size_t g = slots[pos] - 1;
+                    if (hashes[g] == hash && memcmp(keys.data() + g * key_width, key, key_width) == 0)
+                    {
+                        found = true;
+                        return g;
+                    }
+                    pos = (pos + 1) & mask;
+                }
+                found = false;
+                return pos;
+            }
+
+            // Returns the group index and true if the group has been just created
+            std::pair<size_t, bool> find_or_add(const uint8_t *key, uint64_t hash, size_t row, const std::vector<Spec> &aggs)
+            {
+                if ((groups.size() + 1) * 2 > slots.size())
+                {
+                    grow();
+                }
+                bool found;
+                size_t pos = find(key, hash, found);
+                if (found)
+                {
+                    return std::make_pair(pos, false);
+                }
+                size_t g = groups.size();
+                keys.insert(keys.end(), key, key + key_width);
+                hashes.push_back(hash);
+                groups.first_row.push_back(row);
+                for (const auto &a : aggs)
+                {
+                    groups.acc.push_back(initial(a.func));
+                }
+                slots[pos] = (uint32_t)(g + 1);
+                return std::make_pair(g, true);
+            }
+
+            void grow()
+            {
+                std::vector<uint32_t> new_slots(slots.size() * 2, 0);
+                size_t mask = new_slots.size() - 1;
+                for (size_t g = 0; g < groups.size(); ++g)
+                {
+                    size_t pos = hashes[g] & mask;
+                    while (new_slots[pos] != 0)
+                        pos = (pos + 1) & mask;
+                    new_slots[pos] = (uint32_t)(g + 1);
+                }
+                slots.swap(new_slots);
+            }
+        };
+
+        const uint8_t *storage;
+        uint16_t row_size;
+        std::vector<const Column *> keys;
+        std::vector<Spec> aggs;
+        uint16_t key_width = 0;
+        size_t max_threads;
+
+    public:
+        // max_threads = 0 means the number of hardware threads
+        HashAggregator(const uint8_t *storage, uint16_t row_size, const std::vector<const Column *> &keys, const std::vector<Spec> &aggs,
+                       size_t max_threads = 0)
+            : storage(storage), row_size(row_size), keys(keys), aggs(aggs),
+              max_threads(max_threads > 0 ? max_threads : std::max(1u, std::thread::hardware_concurrency()))
+        {
+            for (const auto &c : keys)
+            {
+                key_width += c->width();
+            }
+        }
+
+        Groups run(const std::vector<size_t> &rows) const
+        {
+            // Direct-indexed fast path for a bool, narrow int32 or dictionary code key
+            int64_t min_key = 0;
+            int64_t range = 0;
+            bool direct = false;
+            if (keys.size() == 1 && keys[0]->type == Type::BOOL)
+            {
+                direct = true;
+                range = 2;
+            }
+            else if (keys.size() == 1 && (keys[0]->type == Type::INT || keys[0]->is_dict) && !rows.empty())
+            {
+                int32_t lo = INT32_MAX;
+                int32_t hi = INT32_MIN;
+                for (size_t row : rows)
+                {
+                    int32_t v = *((const int32_t *)(storage + row * row_size + keys[0]->offset));
+                    lo = std::min(lo, v);
+                    hi = std::max(hi, v);
+                }
+                if ((int64_t)hi - lo < MAX_DIRECT_RANGE)
+                {
+                    direct = true;
+                    min_key = lo;
+                    range = (int64_t)hi - lo + 1;
+                }
+            }
+
+            // Split rows into chunks, one chunk per thread
+            size_t num_threads = std::min<size_t>(max_threads, std::max<size_t>(1, rows.size() / MIN_ROWS_PER_THREAD));
+            std::vector<Groups> partial(num_threads);
+            size_t chunk = (rows.size() + num_threads - 1) / num_threads;
+            auto work = [&](size_t t)
+            {
+                size_t begin = std::min(rows.size(), t * chunk);
+                size_t end = std::min(rows.size(), begin + chunk);
+                if (direct)
+                    partial[t] = aggregate_direct(rows, begin, end, min_key, (size_t)range);
+                else
+                    partial[t] = aggregate_hash(rows, begin, end);
+            };
+
+            if (num_threads == 1)
+            {
+                work(0);
+            }
+            else
+            {
+                std::vector<std::thread> threads;
+                for (size_t t = 0; t < num_threads; ++t)
+                {
+                    threads.emplace_back(work, t);
+                }
+                for (auto &thread : threads)
+                {
+                    thread.join();
+                }
+            }
+
+            if (num_threads == 1)
+            {
+                return std::move(partial[0]);
+            }
+            return merge(partial);
+        }
+
+    private:
+        static int64_t initial(AggFunc func)
+        {
+            return (func == AggFunc::MIN || func == AggFunc::MAX) ? -1 : 0;
+        }
+
+        static uint64_t hash_key(const uint8_t *key, uint16_t size)
+        {
+            // FNV-1a
+            uint64_t h = 14695981039346656037ULL;
+            for (uint16_t i = 0; i < size; ++i)
+            {
+                h ^= key[i];
+                h *= 1099511628211ULL;
+            }
+            return h;
+        }
+
+        // Copies the group key of the row into the buffer.
+        // String values are padded with zeroes, so that equal strings
+        // have equal keys regardless of the garbage after the terminator.
+        void write_key(size_t row, uint8_t *out) const
+        {
+            const uint8_t *row_ptr = storage + row * row_size;
+            for (const auto &c : keys)
+            {
+                const uint8_t *p = row_ptr + c->offset;
+                if (c->type == Type::STRING && !c->is_dict)
+                {
+                    size_t n = std::find(p, p + c->size, 0) - p;
+                    memcpy(out, p, n);
+                    memset(out + n, 0, c->size - n);
+                }
+                else
+                {
+                    memcpy(out, p, c->width());
+                }
+                out += c->width();
+            }
+        }
+
+        // Updates accumulators of the group with the row values
+        void update(int64_t *acc, size_t row) const
+        {
+            const uint8_t *row_ptr = storage + row * row_size;
+            for (size_t a = 0; a < aggs.size(); ++a)
+            {
+                const Spec &spec = aggs[a];
+                switch (spec.func)
+                {
+                case AggFunc::COUNT:
+                    acc[a] += 1;
+                    break;
+                case AggFunc::SUM:
+                    acc[a] += *((const int32_t *)(row_ptr + spec.column->offset));
+                    break;
+                case AggFunc::MIN:
+                case AggFunc::MAX:
+                    if (acc[a] < 0 || better(spec, row, (size_t)acc[a]))
+                        acc[a] = (int64_t)row;
+                    break;
+                }
+            }
+        }
+
+        // Combines accumulators of the same group from two partial results
+        void combine(int64_t *acc, const int64_t *other) const
+        {
+            for (size_t a = 0; a < aggs.size(); ++a)
+            {
+                const Spec &spec = aggs[a];
+                if (spec.func == AggFunc::COUNT || spec.func == AggFunc::SUM)
+                {
+                    acc[a] += other[a];
+                }
+                else if (other[a] >= 0 && (acc[a] < 0 || better(spec, (size_t)other[a], (size_t)acc[a])))
+                {
+                    acc[a] = other[a];
+                }
+            }
+        }
+
+        // Checks if the value in the row x should replace the value in the row y for min/max
+        bool better(const Spec &spec, size_t x, size_t y) const
+        {
+            const Column &c = *spec.column;
+            const uint8_t *x_ptr = storage + x * row_size + c.offset;
+            const uint8_t *y_ptr = storage + y * row_size + c.offset;
+            int cmp = 0;
+            if (spec.ranks)
+            {
+                // codes are compared by their ranks in the sorted dictionary
+                uint32_t rx = (*spec.ranks)[*((const uint32_t *)x_ptr)];
+                uint32_t ry = (*spec.ranks)[*((const uint32_t *)y_ptr)];
+                cmp = (rx > ry) - (rx < ry);
+            }
+            else
+            {
+                cmp = compare_raw(c.type, x_ptr, y_ptr, c.size);
+            }
+            return spec.func == AggFunc::MIN ? cmp < 0 : cmp > 0;
+        }
+
+        Groups aggregate_hash(const std::vector<size_t> &rows, size_t begin, size_t end) const
+        {
+            HashTable table(key_width, aggs.size());
+            std::vector<uint8_t> batch_keys(BATCH_SIZE * key_width);
+            std::vector<uint64_t> batch_hashes(BATCH_SIZE);
+
+            // Rows are processed in batches: keys and hashes are computed for the
+            // whole batch first, then the hash table is probed.
+            for (size_t b = begin; b < end; b += BATCH_SIZE)
+            {
+                size_t n = std::min(BATCH_SIZE, end - b);
+                for (size_t i = 0; i < n; ++i)
+                {
+                    write_key(rows[b + i], batch_keys.data() + i * key_width);
+                }
+                for (size_t i = 0; i < n; ++i)
+                {
+                    batch_hashes[i] = hash_key(batch_keys.data() + i * key_width, key_width);
+                }
+                for (size_t i = 0; i < n; ++i)
+                {
+                    size_t g = table.find_or_add(batch_keys.data() + i * key_width, batch_hashes[i], rows[b + i], aggs).first;
+                    update(table.groups.acc.data() + g * aggs.size(), rows[b + i]);
+                }
+            }
+            return std::move(table.groups);
+        }
+
+        Groups aggregate_direct(const std::vector<size_t> &rows, size_t begin, size_t end, int64_t min_key, size_t range) const
+        {
+            const Column &c = *keys[0];
+            std::vector<size_t> first_row(range, SIZE_MAX);
+            std::vector<int64_t> acc;
+            for (size_t k = 0; k < range; ++k)
+            {
+                for (const auto &a : aggs)
+                    acc.push_back(initial(a.func));
+            }
+
+            for (size_t i = begin; i < end; ++i)
+            {
+                size_t row = rows[i];
+                const uint8_t *p = storage + row * row_size + c.offset;
+                size_t slot = c.type == Type::BOOL ? (*p != 0 ? 1 : 0) : (size_t)(*((const int32_t *)p) - min_key);
+                if (first_row[slot] == SIZE_MAX)
+                    first_row[slot] = row;
+                update(acc.data() + slot * aggs.size(), row);
+            }
+
+            // Compact: keep only non-empty slots, ordered by the key value
+            Groups groups;
+            for (size_t slot = 0; slot < range; ++slot)
+            {
+                if (first_row[slot] == SIZE_MAX)
+                    continue;
+                groups.first_row.push_back(first_row[slot]);
+                groups.acc.insert(groups.acc.end(), acc.begin() + slot * aggs.size(), acc.begin() + (slot + 1) * aggs.size());
+            }
+            return groups;
+        }
+
+        Groups merge(const std::vector<Groups> &partial) const
+        {
+            HashTable table(key_width, aggs.size());
+            std::vector<uint8_t> key(key_width);
+            for (const auto &p : partial)
+            {
+                for (size_t g = 0; g < p.size(); ++g)
+                {
+                    write_key(p.first_row[g], key.data());
+                    auto res = table.find_or_add(key.data(), hash_key(key.data(), key_width), p.first_row[g], aggs);
+                    int64_t *acc = table.groups.acc.data() + res.first * aggs.size();
+                    const int64_t *other = p.acc.data() + g * aggs.size();
+                    if (res.second)
+                        std::copy(other, other + aggs.size(), acc);
+                    else
+                        combine(acc, other);
+                }
+            }
+            return std::move(table.groups);
+        }
+    };
+
+}
@@ -1,15 +1,30 @@
 #pragma once
 
 #include <stdexcept>
+#include <string>
 #include <vector>
+#include <memory>
+#include <new>
+#include <cstddef>
 
+#include "base.h"
+#include "value.h"
 #include "lexem.h"
 
 namespace memdb
 {
+	enum class NodeKind
+	{
+		INTERNAL,
+		LEAF
+	};
+
+	// Nodes are allocated in ASTArena and do not own their children
 	struct ASTNode
 	{
-		virtual ~ASTNode() {}
+		NodeKind kind;
+
+		explicit ASTNode(NodeKind kind) : kind(kind) {}
 	};
 
 	struct InternalNode : public ASTNode
@@ -18,89 +33,177 @@ namespace memdb
 		ASTNode* left;
 		ASTNode* right;
 
-		InternalNode(Op op, ASTNode* left, ASTNode* right) : ASTNode(), op(op), left(left), right(right) {}
+		InternalNode(Op op, ASTNode* left, ASTNode* right) : ASTNode(NodeKind::INTERNAL), op(op), left(left), right(right) {}
+	};
 
-		~InternalNode()
+	struct LeafNode : public ASTNode
+	{
+		std::string id;
+		Value value;
+
+		LeafNode(const std::string& id) : ASTNode(NodeKind::LEAF), id(id)
+		{
+		}
+
+		LeafNode(const Value& value) : ASTNode(NodeKind::LEAF), value(value)
 		{
-			delete left;
-			delete right;
 		}
 	};
 
-	struct LeafNode : public ASTNode
+	inline InternalNode* as_internal(ASTNode* node)
 	{
-		std::string id;		
-		Value value;
+		return node && node->kind == NodeKind::INTERNAL ? static_cast<InternalNode*>(node) : nullptr;
+	}
 
-		/*LeafNode(const Lexem& lexem) : ASTNode()
+	inline LeafNode* as_leaf(ASTNode* node)
+	{
+		return node && node->kind == NodeKind::LEAF ? static_cast<LeafNode*>(node) : nullptr;
+	}
+
+	// Memory of the Abstract Syntax Tree of one query.
+	// Nodes are placed one after another in large blocks,
+	// and everything is freed at once when the arena is destroyed.
+	class ASTArena
+	{
+		static constexpr size_t BLOCK_SIZE = 4096;
+		static constexpr size_t ALIGN = alignof(std::max_align_t);
+
+		std::vector<std::unique_ptr<uint8_t[]>> blocks;
+		size_t used = BLOCK_SIZE;      // bytes used in the last block
+		std::vector<LeafNode*> leaves; // leaves hold strings and values and need destructors
+
+	public:
+		ASTArena() {}
+		ASTArena(const ASTArena&) = delete;
+		ASTArena& operator=(const ASTArena&) = delete;
+
+		~ASTArena()
 		{
-			if (is_literal(lexem))
-				value = lex_to_value(lexem);
-			else if (is_id(lexem))
-				id = lexem.value;
-			else
-				throw std::runtime_error("Unreachable");
-		}*/
-
-		LeafNode(const std::string& id) : ASTNode(), id(id)
-		{			
+			for (auto leaf : leaves)
+				leaf->~LeafNode();
 		}
 
-		LeafNode(const Value& value) : ASTNode(), value(value)
-		{			
+		InternalNode* internal(Op op, ASTNode* left, ASTNode* right)
+		{
+			return new (allocate(sizeof(InternalNode))) InternalNode(op, left, right);
+		}
+
+		LeafNode* leaf(const std::string& id)
+		{
+			LeafNode* node = new (allocate(sizeof(LeafNode))) LeafNode(id);
+			leaves.push_back(node);
+			return node;
+		}
+
+		LeafNode* leaf(const Value& value)
+		{
+			LeafNode* node = new (allocate(sizeof(LeafNode))) LeafNode(value);
+			leaves.push_back(node);
+			return node;
+		}
+
+	private:
+		void* allocate(size_t size)
+		{
+			size = (size + ALIGN - 1) & ~(ALIGN - 1);
+			if (used + size > BLOCK_SIZE)
+			{
+				blocks.emplace_back(new uint8_t[BLOCK_SIZE]);
+				used = 0;
+			}
+			void* ptr = blocks.back().get() + used;
+			used += size;
+			return ptr;
 		}
 	};
 
+	// Copies the tree into the arena
+	inline ASTNode* clone(ASTNode* root, ASTArena& arena)
+	{
+		if (LeafNode* leaf = as_leaf(root))
+			return leaf->id.empty() ? arena.leaf(leaf->value) : arena.leaf(leaf->id);
+		if (InternalNode* node = as_internal(root))
+			return arena.internal(node->op, clone(node->left, arena), clone(node->right, arena));
+		return nullptr;
+	}
+
 	inline bool is_cond_index_friendly(ASTNode* root)
 	{
-		InternalNode* internal_node = dynamic_cast<InternalNode*>(root);
+		InternalNode* internal_node = as_internal(root);
 		return
 			internal_node == nullptr ||
 			(internal_node->op != Op::OR && internal_node->op != Op::XOR);
 	}
 
-	inline std::vector<ASTNode*> split_cond_by_and(ASTNode* root)
+	// Returns the terms of the conjunction, leaving the tree intact
+	inline std::vector<ASTNode*> get_and_terms(ASTNode* root)
 	{
-		// assert(is_cond_index_friendly(root))
-
 		std::vector<ASTNode*> terms;
-		
-		InternalNode* internal_node = dynamic_cast<InternalNode*>(root);
+		InternalNode* internal_node = as_internal(root);
 		while (internal_node && internal_node->op == Op::AND)
 		{
-			
-			ASTNode* left = internal_node->left;
-			ASTNode* right = internal_node->right;			
-			internal_node->left = nullptr;
-			internal_node->right = nullptr;
-			delete internal_node;
-			terms.push_back(right);
-			root = left;			
-			internal_node = dynamic_cast<InternalNode*>(root);
+			terms.push_back(internal_node->right);
+			root = internal_node->left;
+			internal_node = as_internal(root);
 		}
 		terms.push_back(root);
-
 		return terms;
 	}
 
-
+	// Disjunctive normal form of the condition: the terms of every conjunction of the disjunction.
+	// "and" is distributed over "or" only while there are at most max_disjuncts conjunctions,
+	// the result is empty if there would be more.
+	inline std::vector<std::vector<ASTNode*>> to_dnf(ASTNode* root, size_t max_disjuncts)
+	{
+		InternalNode* node = as_internal(root);
+		if (!node || (node->op != Op::OR && node->op != Op::AND))
+			return { { root } };
+
+		auto left = to_dnf(node->left, max_disjuncts);
+		auto right = to_dnf(node->right, max_disjuncts);
+		if (left.empty() || right.empty())
+			return {};
+		if (node->op == Op::OR)
+		{
+			if (left.size() + right.size() > max_disjuncts)
+				return {};
+			left.insert(left.end(), right.begin(), right.end());
+			return left;
+		}
+		if (left.size() * right.size() > max_disjuncts)
+			return {};
+		std::vector<std::vector<ASTNode*>> result;
+		for (const auto& x : left)
+		{
+			for (const auto& y : right)
+			{
+				result.push_back(x);
+				result.back().insert(result.back().end(), y.begin(), y.end());
+			}
+		}
+		return result;
+	}
 
 	inline bool is_expr_simple(ASTNode* root)
 	{
-		InternalNode* internal_node = dynamic_cast<InternalNode*>(root);
+		InternalNode* internal_node = as_internal(root);
 		if (!internal_node)
 		{
 			return true;
 		}
 		if (is_rel_op(internal_node->op))
 		{
-			LeafNode* left = dynamic_cast<LeafNode*>(internal_node->left);
-			LeafNode* right = dynamic_cast<LeafNode*>(internal_node->right);
+			LeafNode* left = as_leaf(internal_node->left);
+			LeafNode* right = as_leaf(internal_node->right);
 			if (left && right)
 			{
+				// the pattern of like and starts_with must be the literal
+				if ((internal_node->op == Op::LIKE || internal_node->op == Op::STARTS_WITH) && left->id.empty())
+					return false;
+				// a column compared to a literal (the leaves of the columns hold the values of the last checked row)
 				return
-					(!left->id.empty() && !right->value.is_empty()) ||
-					(left->id.empty() && right->value.is_empty());
+					(!left->id.empty() && right->id.empty()) ||
+					(left->id.empty() && !right->id.empty());
 			}
 		}
 		return false;
@@ -108,26 +211,16 @@ namespace memdb
 
 	inline bool is_condition_simple(ASTNode* root)
 	{
-		// assert(is_cond_index_friendly(root))		
+		// assert(is_cond_index_friendly(root))
 
-		InternalNode* internal_node = dynamic_cast<InternalNode*>(root);
+		InternalNode* internal_node = as_internal(root);
 		while (internal_node && internal_node->op == Op::AND)
-		{								
+		{
 			if (!is_expr_simple(internal_node->right))
 				return false;
 			root = internal_node->left;
-			internal_node = dynamic_cast<InternalNode*>(root);
+			internal_node = as_internal(root);
 		}
 		return is_expr_simple(root);
 	}
-
-	inline bool is_condition_simple(const std::vector<ASTNode*>& terms)
-	{
-		for (const auto& term : terms)
-		{
-			if (!is_expr_simple(term))
-				return false;
-			return true;
-		}
-	}
 }
@@ -30,7 +30,9 @@ namespace memdb
         LT,
         GT,
         LE,
-        GE
+        GE,
+        LIKE,
+        STARTS_WITH
     };
 
     enum class Op
@@ -48,6 +50,8 @@ namespace memdb
         GT,
         LE,
         GE,
+        LIKE,
+        STARTS_WITH,
         // Logic
         AND,
         OR,
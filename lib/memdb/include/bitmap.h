@@ -0,0 +1,229 @@
+#pragma once
+
+#include <stdexcept>
+#include <vector>
+#include <algorithm>
+#include <iterator>
+#include <cstdint>
+
+#include "index.h"
+
+namespace memdb
+{
+
+    // Compressed set of row numbers in the manner of Roaring bitmaps. Rows are split into chunks
+    // of 65536 by the high bits, the low 16 bits of the rows of a chunk are kept either as a sorted
+    // array (sparse chunks) or as a bitset of 1024 words (dense chunks). Iteration gives rows
+    // in ascending order.
+    class RowBitmap
+    {
+        static constexpr size_t CHUNK_BITS = 16;
+        static constexpr size_t CHUNK_SIZE = size_t(1) << CHUNK_BITS;
+        static constexpr size_t WORDS = CHUNK_SIZE / 64;
+        static constexpr size_t MAX_ARRAY = 4096; // larger chunks take less memory as bitsets
+
+        struct Chunk
+        {
+            size_t key = 0;                // row >> CHUNK_BITS
+            size_t count = 0;
+            std::vector<uint16_t> array;   // sorted, if the chunk is sparse
+            std::vector<uint64_t> bits;    // WORDS words, if the chunk is dense
+
+            bool is_dense() const { return !bits.empty(); }
+
+            bool contains(uint16_t low) const
+            {
+                if (is_dense())
+                    return (bits[low >> 6] >> (low & 63)) & 1;
+                return std::binary_search(array.begin(), array.end(), low);
+            }
+
+            // Keeps the representation taking less memory
+            void optimize()
+            {
+                if (is_dense() && count <= MAX_ARRAY)
+                {
+                    array.reserve(count);
+                    for (size_t w = 0; w < WORDS; ++w)
+                    {
+                        for (uint64_t word = bits[w]; word != 0; word &= word - 1)
+                            array.push_back((uint16_t)(w * 64 + __builtin_ctzll(word)));
+                    }
+                    std::vector<uint64_t>().swap(bits);
+                }
+                else if (!is_dense() && count > MAX_ARRAY)
+                {
+                    bits.assign(WORDS, 0);
+                    for (uint16_t low : array)
+                        bits[low >> 6] |= uint64_t(1) << (low & 63);
+                    std::vector<uint16_t>().swap(array);
+                }
+            }
+        };
+
+        std::vector<Chunk> chunks; // ascending keys, no empty chunks
+
+    public:
+        // Bitmap of the rows given in any order without repetitions
+        template <typename It>
+        static RowBitmap from_rows(It first, It last)
+        {
+            std::vector<std::vector<uint16_t>> lows;
+            add_lows(first, last, lows);
+            return from_lows(lows);
+        }
+
+        // Bitmap of the rows in the disjoint ranges of an index
+        static RowBitmap from_ranges(const std::vector<IndexRange> &ranges)
+        {
+            std::vector<std::vector<uint16_t>> lows;
+            for (const auto &range : ranges)
+                add_lows(range.index->index.begin() + range.begin, range.index->index.begin() + range.end, lows);
+            return from_lows(lows);
+        }
+
+        size_t size() const
+        {
+            size_t n = 0;
+            for (const auto &chunk : chunks)
+                n += chunk.count;
+            return n;
+        }
+
+        bool contains(size_t row) const
+        {
+            auto it = std::lower_bound(chunks.begin(), chunks.end(), row >> CHUNK_BITS,
+                [](const Chunk &chunk, size_t key) { return chunk.key < key; });
+            return it != chunks.end() && it->key == (row >> CHUNK_BITS) && it->contains((uint16_t)(row & (CHUNK_SIZE - 1)));
+        }
+
+        // Rows present in both bitmaps
+        RowBitmap intersect(const RowBitmap &other) const
+        {
+            RowBitmap result;
+            size_t i = 0, j = 0;
+            while (i < chunks.size() && j < other.chunks.size())
+            {
+                const Chunk &x = chunks[i];
+                const Chunk &y = other.chunks[j];
+                if (x.key < y.key)
+                {
+                    ++i;
+                    continue;
+                }
+                if (y.key < x.key)
+                {
+                    ++j;
+                    continue;
+                }
+                Chunk chunk = intersect(x, y);
+                if (chunk.count > 0)
+                    result.chunks.push_back(std::move(chunk));
+                ++i;
+                ++j;
+            }
+            return result;
+        }
+
+        // Calls f(row) for every row in ascending order
+        template <typename F>
+        void for_each(F f) const
+        {
+            for (const auto &chunk : chunks)
+            {
+                size_t base = chunk.key << CHUNK_BITS;
+                if (chunk.is_dense())
+                {
+                    for (size_t w = 0; w < WORDS; ++w)
+                    {
+                        for (uint64_t word = chunk.bits[w]; word != 0; word &= word - 1)
+                            f(base + w * 64 + __builtin_ctzll(word));
+                    }
+                }
+                else
+                {
+                    for (uint16_t low : chunk.array)
+                        f(base + low);
+                }
+            }
+        }
+
+    private:
+        // Rows are grouped by chunks first, the low bits of every chunk are
+        // then either set in a bitset or sorted as a small array
+        template <typename It>
+        static void add_lows(It first, It last, std::vector<std::vector<uint16_t>> &lows)
+        {
+            for (It it = first; it != last; ++it)
+            {
+                size_t row = *it;
+                size_t key = row >> CHUNK_BITS;
+                if (key >= lows.size())
+                    lows.resize(key + 1);
+                lows[key].push_back((uint16_t)(row & (CHUNK_SIZE - 1)));
+            }
+        }
+
+        static RowBitmap from_lows(std::vector<std::vector<uint16_t>> &lows)
+        {
+            RowBitmap bitmap;
+            for (size_t key = 0; key < lows.size(); ++key)
+            {
+                if (lows[key].empty())
+                    continue;
+                Chunk chunk;
+                chunk.key = key;
+                chunk.count = lows[key].size();
+                if (chunk.count > MAX_ARRAY)
+                {
+                    chunk.bits.assign(WORDS, 0);
+                    for (uint16_t low : lows[key])
+                        chunk.bits[low >> 6] |= uint64_t(1) << (low & 63);
+                }
+                else
+                {
+                    chunk.array.swap(lows[key]);
+                    std::sort(chunk.array.begin(), chunk.array.end());
+                }
+                bitmap.chunks.push_back(std::move(chunk));
+            }
+            return bitmap;
+        }
+
+        static Chunk intersect(const Chunk &x, const Chunk &y)
+        {
+            Chunk chunk;
+            chunk.key = x.key;
+            if (x.is_dense() && y.is_dense())
+            {
+                chunk.bits.resize(WORDS);
+                for (size_t w = 0; w < WORDS; ++w)
+                {
+                    chunk.bits[w] = x.bits[w] & y.bits[w];
+                    chunk.count += __builtin_popcountll(chunk.bits[w]);
+                }
+                chunk.optimize();
+            }
+            else if (x.is_dense() || y.is_dense())
+            {
+                // the sparse chunk is probed in the dense one
+                const Chunk &sparse = x.is_dense() ? y : x;
+                const Chunk &dense = x.is_dense() ? x : y;
+                for (uint16_t low : sparse.array)
+                {
+                    if (dense.contains(low))
+                        chunk.array.push_back(low);
+                }
+                chunk.count = chunk.array.size();
+            }
+            else
+            {
+                std::set_intersection(x.array.begin(), x.array.end(), y.array.begin(), y.array.end(),
+                    std::back_inserter(chunk.array));
+                chunk.count = chunk.array.size();
+            }
+            return chunk;
+        }
+    };
+
+}
@@ -0,0 +1,135 @@
+#pragma once
+
+#include <stdexcept>
+#include <vector>
+#include <iostream>
+#include <algorithm>
+
+#include "base.h"
+#include "column.h"
+#include "value.h"
+#include "utils.h"
+#include "zonemap.h"
+
+namespace memdb
+{
+
+    // Bloom filters for a column, one filter for every block of rows
+    // (blocks are the same as in zone maps).
+    // A filter answers "definitely absent" or "may be present" for a value,
+    // so a block can be skipped when looking for a particular value.
+    struct BloomFilter
+    {
+        static constexpr size_t BLOCK_SIZE = ZoneMap::BLOCK_SIZE;
+        static constexpr size_t BITS_PER_BLOCK = 65536; // 16 bits per row
+        static constexpr size_t WORDS_PER_BLOCK = BITS_PER_BLOCK / 64;
+        static constexpr size_t NUM_HASHES = 7;
+
+        size_t col;
+        Type type;
+        uint16_t size;
+        std::vector<uint64_t> bits; // WORDS_PER_BLOCK words per block
+
+        BloomFilter(size_t col, const Column &column) : col(col), type(column.type), size(column.size) {}
+
+        size_t num_blocks() const { return bits.size() / WORDS_PER_BLOCK; }
+
+        // Adds the value of the new row into the filter of its block
+        void add(size_t row, const uint8_t *val_ptr)
+        {
+            size_t block = row / BLOCK_SIZE;
+            if (block == num_blocks())
+            {
+                bits.resize(bits.size() + WORDS_PER_BLOCK, 0);
+            }
+            uint64_t *words = bits.data() + block * WORDS_PER_BLOCK;
+            uint64_t h1, h2;
+            hash(val_ptr, length(val_ptr, size), h1, h2);
+            for (size_t i = 0; i < NUM_HASHES; ++i)
+            {
+                size_t bit = (h1 + i * h2) & (BITS_PER_BLOCK - 1);
+                words[bit / 64] |= (uint64_t)1 << (bit % 64);
+            }
+        }
+
+        // Checks if the block may contain the value
+        bool may_contain(size_t block, const Value &val) const
+        {
+            if (val.type != type)
+                return true; // let the row check report the error
+            uint64_t h1, h2;
+            hash(val.val_ptr, length(val.val_ptr, val.size), h1, h2);
+            return may_contain(block, h1, h2);
+        }
+
+        // Returns the blocks which may contain the value
+        std::vector<size_t> find_blocks(const Value &val) const
+        {
+            std::vector<size_t> blocks;
+            if (val.type != type)
+                return blocks;
+            uint64_t h1, h2;
+            hash(val.val_ptr, length(val.val_ptr, val.size), h1, h2);
+            for (size_t block = 0; block < num_blocks(); ++block)
+            {
+                if (may_contain(block, h1, h2))
+                    blocks.push_back(block);
+            }
+            return blocks;
+        }
+
+        void save_to_file(std::ostream &out) const
+        {
+            write_int(out, col);
+            write_int(out, num_blocks());
+            out.write((const char *)bits.data(), bits.size() * sizeof(uint64_t));
+        }
+
+        static BloomFilter load_from_file(std::istream &in, const std::vector<Column> &columns)
+        {
+            size_t col = read_int<size_t>(in);
+            BloomFilter filter(col, columns.at(col));
+            filter.bits.resize(read_int<size_t>(in) * WORDS_PER_BLOCK);
+            in.read((char *)filter.bits.data(), filter.bits.size() * sizeof(uint64_t));
+            return filter;
+        }
+
+    private:
+        bool may_contain(size_t block, uint64_t h1, uint64_t h2) const
+        {
+            const uint64_t *words = bits.data() + block * WORDS_PER_BLOCK;
+            for (size_t i = 0; i < NUM_HASHES; ++i)
+            {
+                size_t bit = (h1 + i * h2) & (BITS_PER_BLOCK - 1);
+                if ((words[bit / 64] & ((uint64_t)1 << (bit % 64))) == 0)
+                    return false;
+            }
+            return true;
+        }
+
+        // Number of significant bytes: strings are hashed up to the terminator
+        size_t length(const uint8_t *val_ptr, size_t n) const
+        {
+            if (type == Type::STRING)
+                return std::find(val_ptr, val_ptr + n, 0) - val_ptr;
+            return n;
+        }
+
+        static void hash(const uint8_t *data, size_t n, uint64_t &h1, uint64_t &h2)
+        {
+            // FNV-1a and a finalizer mix of it (double hashing)
+            h1 = 14695981039346656037ULL;
+            for (size_t i = 0; i < n; ++i)
+            {
+                h1 ^= data[i];
+                h1 *= 1099511628211ULL;
+            }
+            h2 = h1;
+            h2 ^= h2 >> 33;
+            h2 *= 0xff51afd7ed558ccdULL;
+            h2 ^= h2 >> 33;
+            h2 |= 1;
+        }
+    };
+
+}
@@ -4,6 +4,9 @@
 #include <stdexcept>
 #include <iomanip>
 #include <sstream>
+#include <string_view>
+#include <charconv>
+#include <algorithm>
 
 #include "base.h"
 
@@ -12,12 +15,29 @@ namespace memdb
 
     typedef std::vector<uint8_t> Bytes;
 
-    Bytes bytes_from_hex_string(const std::string &str)
+    // Non-owning view of a bytes value
+    struct BytesView
+    {
+        const uint8_t *ptr = nullptr;
+        size_t len = 0;
+
+        BytesView() {}
+        BytesView(const uint8_t *ptr, size_t len) : ptr(ptr), len(len) {}
+
+        const uint8_t *data() const { return ptr; }
+        size_t size() const { return len; }
+        const uint8_t *begin() const { return ptr; }
+        const uint8_t *end() const { return ptr + len; }
+        uint8_t operator[](size_t i) const { return ptr[i]; }
+    };
+
+    Bytes bytes_from_hex_string(std::string_view str)
     {
         Bytes bytes;
         for (size_t i = 2; i < str.size(); i += 2)
         {
-            uint8_t byte = (uint8_t)stoul(str.substr(i, 2), 0, 16);
+            uint8_t byte = 0;
+            std::from_chars(str.data() + i, str.data() + std::min(i + 2, str.size()), byte, 16);
             bytes.push_back(byte);
         }
         return bytes;
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <cstring>
+#include <cerrno>
+
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "resultset.h"
+#include "protocol.h"
+
+namespace memdb
+{
+
+    // Client of memdb_server.
+    // execute() sends a query and waits for its result. For pipelining, send() several
+    // queries and then receive() their results in the same order.
+    class Client
+    {
+        int fd = -1;
+        uint32_t next_id = 0;
+        uint32_t next_expected = 0;
+
+    public:
+        Client(const std::string &path)
+        {
+            sockaddr_un addr;
+            if (path.size() >= sizeof(addr.sun_path))
+                throw std::runtime_error("Socket path too long.");
+            std::memset(&addr, 0, sizeof(addr));
+            addr.sun_family = AF_UNIX;
+            std::memcpy(addr.sun_path, path.c_str(), path.size());
+
+            fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+            if (fd < 0)
+                throw std::runtime_error("Cannot create socket: " + std::string(std::strerror(errno)));
+            if (::connect(fd, (sockaddr *)&addr, sizeof(addr)) < 0)
+            {
+                std::string error = std::strerror(errno);
+                ::close(fd);
+                throw std::runtime_error("Cannot connect to " + path + ": " + error);
+            }
+        }
+
+        Client(const Client &) = delete;
+        Client &operator=(const Client &) = delete;
+
+        ~Client()
+        {
+            ::close(fd);
+        }
+
+        ResultSet execute(std::string_view query)
+        {
+            send(query);
+            return receive();
+        }
+
+        // Sends the query without waiting for the result, returns the request id
+        uint32_t send(std::string_view query)
+        {
+            uint32_t id = next_id++;
+            Protocol::write_request(fd, id, query);
+            return id;
+        }
+
+        // Waits for the result of the oldest query without a result
+        ResultSet receive()
+        {
+            if (pending() == 0)
+                throw std::runtime_error("No query to receive the result of.");
+            uint32_t id;
+            ResultSet rs;
+            if (!Protocol::read_response(fd, id, rs))
+                throw std::runtime_error("Connection closed by the server.");
+            if (id != next_expected++)
+                throw std::runtime_error("Response out of order.");
+            return rs;
+        }
+
+        // Number of queries sent but not received
+        size_t pending() const
+        {
+            return next_id - next_expected;
+        }
+    };
+
+}
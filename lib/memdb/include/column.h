@@ -21,6 +21,8 @@ namespace memdb
         bool is_auto = false;
         bool is_key = false;
         bool has_default = false;
+        bool has_bloom = false;
+        bool is_dict = false; // dictionary-encoded string
         int32_t autoincrement_value = 1;
         Value def_value;
 
@@ -47,6 +49,12 @@ namespace memdb
             }
         }
 
+        // Number of bytes occupied by the column in a table row
+        uint16_t width() const
+        {
+            return is_dict ? (uint16_t)sizeof(uint32_t) : size;
+        }
+
         void save_to_file(std::ostream &out) const
         {
             write_int(out, (int)type);
@@ -57,6 +65,8 @@ namespace memdb
             write_int(out, is_auto);
             write_int(out, is_key);
             write_int(out, has_default);
+            write_int(out, has_bloom);
+            write_int(out, is_dict);
             if (is_auto)
             {
                 write_int(out, autoincrement_value);
@@ -86,6 +96,8 @@ namespace memdb
             column.is_auto = read_int<bool>(in);
             column.is_key = read_int<bool>(in);
             column.has_default = read_int<bool>(in);
+            column.has_bloom = read_int<bool>(in);
+            column.is_dict = read_int<bool>(in);
             if (column.is_auto)
             {
                 column.autoincrement_value = read_int<int32_t>(in);
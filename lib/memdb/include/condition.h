@@ -1,9 +1,11 @@
 #pragma once
 
 #include <stdexcept>
+#include <memory>
 
 #include "base.h"
 #include "value.h"
+#include "pattern.h"
 
 namespace memdb
 {
@@ -12,8 +14,18 @@ namespace memdb
     {
         Value that;
         RelOp op;
+        std::shared_ptr<const LikePattern> pattern; // compiled pattern of like and starts_with
 
-        Condition(const Value &rhs, RelOp op) : that(rhs), op(op) {}
+        Condition(const Value &rhs, RelOp op) : that(rhs), op(op)
+        {
+            if (op == RelOp::LIKE || op == RelOp::STARTS_WITH)
+            {
+                if (that.type != Type::STRING)
+                    throw std::runtime_error("Operations like and starts_with are only allowed for strings.");
+                std::string p = that.get<std::string>();
+                pattern = std::make_shared<const LikePattern>(op == RelOp::LIKE ? LikePattern(p) : LikePattern::prefix(p));
+            }
+        }
 
         bool match(const Value &lhs) const
         {
@@ -31,6 +43,9 @@ namespace memdb
                 return lhs <= that;
             case RelOp::GE:
                 return lhs >= that;
+            case RelOp::LIKE:
+            case RelOp::STARTS_WITH:
+                return pattern->match(lhs);
             default:
                 throw std::runtime_error("Invalid operation");
             }
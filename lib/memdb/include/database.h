@@ -3,11 +3,23 @@
 #include <stdexcept>
 #include <string>
 #include <map>
+#include <unordered_map>
 #include <set>
 #include <iostream>
+#include <memory>
+#include <chrono>
+#include <future>
+#include <functional>
+#include <mutex>
+#include <shared_mutex>
 
 #include "base.h"
 #include "table.h"
+#include "partitioned_table.h"
+#include "writer.h"
+#include "executor.h"
+#include "resultcache.h"
+#include "plancache.h"
 #include "lexer.h"
 #include "parser.h"
 #include "utils.h"
@@ -18,12 +30,36 @@ namespace memdb
 	class Database
 	{
 		std::map<std::string, Table *> tables;
+		std::map<std::string, PartitionedTable *> partitioned;
+
+		// Header of the file written by save_to_file. The version is raised with every change
+		// of the layout of the file, files of other versions are rejected by load_from_file.
+		static constexpr uint32_t FILE_MAGIC = 0x42444d4d; // "MMDB"
+		static constexpr uint32_t FILE_VERSION = 1;
+
+		// Selects run in parallel, other queries are exclusive. Every public entry point takes
+		// the lock, so the direct calls are safe alongside the asynchronous queries.
+		mutable std::shared_mutex mutex;
+
+		// Thread pool of the asynchronous queries, started by the first of them
+		size_t async_threads;
+		std::unique_ptr<Executor> executor;
+		std::once_flag executor_started;
+
+		// Results of the selects, disabled unless a memory budget is set
+		std::unique_ptr<ResultCache> result_cache;
+
+		// Parsed selects by the query text without literals
+		std::unique_ptr<PlanCache> plan_cache{ new PlanCache(PlanCache::DEFAULT_CAPACITY) };
 
 	public:
-		Database() {}
+		// async_threads is the number of threads running asynchronous queries
+		// (0 means the number of hardware threads)
+		Database(size_t async_threads = 0) : async_threads(async_threads) {}
 
 		~Database()
 		{
+			executor.reset(); // finish the queued queries
 			clear();
 		}
 
@@ -34,9 +70,287 @@ namespace memdb
 				delete p.second;
 			}
 			tables.clear();
+			for (auto &p : partitioned)
+			{
+				delete p.second;
+			}
+			partitioned.clear();
+			if (result_cache)
+				result_cache->clear();
+			if (plan_cache)
+				plan_cache->clear();
+		}
+
+		// Enables caching the results of the selects within the memory budget (in bytes),
+		// 0 disables the cache. Cached results are returned while their tables do not change.
+		void set_result_cache(size_t budget)
+		{
+			std::unique_lock<std::shared_mutex> lock(mutex);
+			result_cache.reset(budget > 0 ? new ResultCache(budget) : nullptr);
+		}
+
+		ResultCacheStats get_result_cache_stats()
+		{
+			std::shared_lock<std::shared_mutex> lock(mutex);
+			return result_cache ? result_cache->get_stats() : ResultCacheStats();
+		}
+
+		// Sets the number of the parsed selects kept for reuse by the queries differing
+		// only in literals (PlanCache::DEFAULT_CAPACITY by default), 0 disables the cache
+		void set_plan_cache(size_t capacity)
+		{
+			std::unique_lock<std::shared_mutex> lock(mutex);
+			plan_cache.reset(capacity > 0 ? new PlanCache(capacity) : nullptr);
+		}
+
+		PlanCacheStats get_plan_cache_stats()
+		{
+			std::shared_lock<std::shared_mutex> lock(mutex);
+			return plan_cache ? plan_cache->get_stats() : PlanCacheStats();
+		}
+
+		// Creates a table, split into partitions if the scheme is given
+		ResultSet create_table(const std::string &name, const std::vector<Column> &columns,
+			const PartitionScheme &partition = PartitionScheme())
+		{
+			std::unique_lock<std::shared_mutex> lock(mutex);
+			return create_table_unlocked(name, columns, partition);
+		}
+
+		ResultSet insert(const std::string &name, const std::vector<Value> &values)
+		{
+			std::unique_lock<std::shared_mutex> lock(mutex);
+			return insert_unlocked(name, values);
+		}
+
+		// Typed row builder for the table, see RowWriter.
+		// The writer locks the database while it changes the table.
+		// Partitioned tables are not supported: the partition is only known when the row is complete.
+		RowWriter writer(const std::string &name)
+		{
+			std::shared_lock<std::shared_mutex> lock(mutex);
+			if (find_partitioned(name))
+				return RowWriter::unsupported("RowWriter is not supported for partitioned tables, insert the rows by queries.");
+			return RowWriter(find(name), &mutex);
+		}
+
+		ResultSet select_all(const std::string &name)
+		{
+			std::shared_lock<std::shared_mutex> lock(mutex);
+			return select_all_unlocked(name);
+		}
+
+		ResultSet select(const std::string &name, const std::vector<std::string>& cols, std::vector<std::pair<Condition, size_t>> conditions)
+		{
+			std::shared_lock<std::shared_mutex> lock(mutex);
+			return select_unlocked(name, cols, std::move(conditions));
+		}
+
+		ResultSet select(const std::string& name, const std::vector<std::string>& columns, ASTNode* ast)
+		{
+			std::shared_lock<std::shared_mutex> lock(mutex);
+			return select_unlocked(name, columns, ast);
+		}
+
+		ResultSet select(const std::string& name, const std::vector<std::string>& columns, const std::vector<Aggregate>& aggregates,
+			const std::vector<std::string>& group_by, ASTNode* ast)
+		{
+			std::shared_lock<std::shared_mutex> lock(mutex);
+			return select_unlocked(name, columns, aggregates, group_by, ast);
+		}
+
+		// Describes the plan of the select.
+		// With analyze the select is also executed and the actual figures are reported.
+		ResultSet explain(const SelectDef& def, bool analyze, int64_t parse_ns = 0)
+		{
+			std::shared_lock<std::shared_mutex> lock(mutex);
+			return explain_unlocked(def, analyze, parse_ns);
+		}
+
+		ResultSet create_ordered_index(const std::string &table_name, const std::vector<std::string> &columns)
+		{
+			std::unique_lock<std::shared_mutex> lock(mutex);
+			return create_ordered_index_unlocked(table_name, columns);
+		}
+
+		ResultSet create_trigram_index(const std::string &table_name, const std::vector<std::string> &columns)
+		{
+			std::unique_lock<std::shared_mutex> lock(mutex);
+			return create_trigram_index_unlocked(table_name, columns);
+		}
+
+		// Drops the partitions of a range-partitioned table holding only values below the bound
+		ResultSet drop_partitions(const std::string &name, int32_t before)
+		{
+			try
+			{
+				std::unique_lock<std::shared_mutex> lock(mutex);
+				get_partitioned(name)->drop_partitions(before);
+				return ResultSet();
+			}
+			catch (std::runtime_error &e)
+			{
+				return error_result(e.what());
+			}
+		}
+
+		// Compacts the partitions of a range-partitioned table holding only values below the bound
+		// and rejects further inserts into them
+		ResultSet freeze_partitions(const std::string &name, int32_t before)
+		{
+			try
+			{
+				std::unique_lock<std::shared_mutex> lock(mutex);
+				get_partitioned(name)->freeze_partitions(before);
+				return ResultSet();
+			}
+			catch (std::runtime_error &e)
+			{
+				return error_result(e.what());
+			}
+		}
+
+		// Executes the query. Queries may be executed from several threads:
+		// selects and explains share the database, other queries lock it exclusively.
+		ResultSet execute(const std::string &query)
+		{
+			try
+			{
+				std::chrono::steady_clock::time_point t1 = std::chrono::steady_clock::now();
+				Lexer lexer(query);
+				const auto &lexems = lexer.tokenize();
+				if (lexems.empty())
+				{
+					throw std::runtime_error("Empty query.");
+				}
+				if (lexems[0].type == LexemType::SELECT || lexems[0].type == LexemType::EXPLAIN)
+				{
+					std::shared_lock<std::shared_mutex> lock(mutex);
+					return execute(lexems, t1);
+				}
+				std::unique_lock<std::shared_mutex> lock(mutex);
+				return execute(lexems, t1);
+			}
+			catch (std::exception &e) // LexicalError is not a runtime_error
+			{
+				return error_result(e.what());
+			}
+		}
+
+		// Executes the query on the thread pool of the database
+		std::future<ResultSet> execute_async(const std::string &query)
+		{
+			auto task = std::make_shared<std::packaged_task<ResultSet()>>([this, query]() { return execute(query); });
+			std::future<ResultSet> result = task->get_future();
+			get_executor().submit([task]() { (*task)(); });
+			return result;
+		}
+
+		// Executes the query on the thread pool and passes the result to the callback.
+		// The callback is called on a thread of the pool and must not throw.
+		void execute_async(const std::string &query, std::function<void(ResultSet)> callback)
+		{
+			get_executor().submit([this, query, callback]() { callback(execute(query)); });
+		}
+
+		// Submits the queries to the thread pool at once.
+		// They are started in the given order, but may run in parallel.
+		std::vector<std::future<ResultSet>> execute_batch(const std::vector<std::string> &queries)
+		{
+			std::vector<std::future<ResultSet>> results;
+			std::vector<std::function<void()>> funcs;
+			results.reserve(queries.size());
+			funcs.reserve(queries.size());
+			for (const auto &query : queries)
+			{
+				auto task = std::make_shared<std::packaged_task<ResultSet()>>([this, query]() { return execute(query); });
+				results.push_back(task->get_future());
+				funcs.push_back([task]() { (*task)(); });
+			}
+			get_executor().submit(std::move(funcs));
+			return results;
+		}
+
+		// Queue depth and timing of the asynchronous queries
+		ExecutorStats get_executor_stats()
+		{
+			return get_executor().get_stats();
+		}
+
+		void save_to_file(std::ostream &out) const
+		{
+			std::shared_lock<std::shared_mutex> lock(mutex);
+			write_int(out, FILE_MAGIC);
+			write_int(out, FILE_VERSION);
+			write_int(out, tables.size());			
+			for (const auto &p : tables)
+			{
+				const auto &name = p.first;
+				Table *table = p.second;
+				write_string(out, name);
+				table->save_to_file(out);
+			}
+			write_int(out, partitioned.size());
+			for (const auto &p : partitioned)
+			{
+				write_string(out, p.first);
+				p.second->save_to_file(out);
+			}
+		}
+
+		void load_from_file(std::istream &in)
+		{
+			std::unique_lock<std::shared_mutex> lock(mutex);
+			uint32_t magic = read_int<uint32_t>(in);
+			if (!in || magic != FILE_MAGIC)
+				throw std::runtime_error("Not a database file.");
+			uint32_t version = read_int<uint32_t>(in);
+			if (version != FILE_VERSION)
+				throw std::runtime_error("Unsupported version " + std::to_string(version) + " of the database file, expected " +
+					std::to_string(FILE_VERSION) + ".");
+			clear();
+			size_t num_tables = read_int<size_t>(in);
+			for (size_t i = 0; i < num_tables; ++i)
+			{
+				std::string name = read_string(in);
+				Table *table = Table::load_from_file(in);
+				tables.insert(std::make_pair(name, table));
+			}
+			size_t num_partitioned = read_int<size_t>(in);
+			for (size_t i = 0; i < num_partitioned; ++i)
+			{
+				std::string name = read_string(in);
+				PartitionedTable *table = PartitionedTable::load_from_file(in);
+				partitioned.insert(std::make_pair(name, table));
+			}
+		}
+
+		void info(std::ostream &out)
+		{
+			std::shared_lock<std::shared_mutex> lock(mutex);
+			out << "Database info:" << std::endl;
+			size_t i = 1;
+			for (const auto &p : tables)
+			{
+				const auto &name = p.first;
+				Table *table = p.second;
+				out << i++ << ": " << name << " (" << table->columns.size() << " columns, " << table->row_count << " rows)" << std::endl;
+			}
+			for (const auto &p : partitioned)
+			{
+				const auto &name = p.first;
+				PartitionedTable *table = p.second;
+				out << i++ << ": " << name << " (" << table->columns.size() << " columns, " << table->row_count() << " rows, "
+					<< table->partitions.size() << " partitions)" << std::endl;
+			}
+			out << std::endl;
 		}
 
-		ResultSet create_table(const std::string &name, const std::vector<Column> &columns)
+	private:
+		// The entry points below expect the caller to hold the lock
+
+		ResultSet create_table_unlocked(const std::string &name, const std::vector<Column> &columns,
+			const PartitionScheme &partition)
 		{
 			try
 			{
@@ -44,10 +358,15 @@ namespace memdb
 				{
 					throw std::runtime_error("The column definition contains duplicate names.");
 				}
-				if (find(name) != nullptr)
+				if (find(name) != nullptr || partitioned.count(name) > 0)
 				{
 					throw std::runtime_error("A table with the given name already exists.");
 				}
+				if (partition.kind != PartitionKind::NONE)
+				{
+					partitioned.insert(std::make_pair(name, new PartitionedTable(columns, partition)));
+					return ResultSet();
+				}
 				Table *table = new Table(columns);
 				tables.insert(std::make_pair(name, table));
 				return ResultSet();
@@ -58,10 +377,12 @@ namespace memdb
 			}
 		}
 
-		ResultSet insert(const std::string &name, const std::vector<Value> &values)
+		ResultSet insert_unlocked(const std::string &name, const std::vector<Value> &values)
 		{
 			try
 			{
+				if (PartitionedTable *table = find_partitioned(name))
+					return table->insert(values);
 				Table *table = get(name);
 				return table->insert(values);
 			}
@@ -71,10 +392,12 @@ namespace memdb
 			}
 		}
 
-		ResultSet select_all(const std::string &name)
+		ResultSet select_all_unlocked(const std::string &name)
 		{
 			try
 			{
+				if (PartitionedTable* table = find_partitioned(name))
+					return table->select_all();
 				Table* table = get(name);
 				return table->select_all();
 			}
@@ -84,10 +407,12 @@ namespace memdb
 			}
 		}
 
-		ResultSet select(const std::string &name, const std::vector<std::string>& cols, std::vector<std::pair<Condition, size_t>> conditions)
+		ResultSet select_unlocked(const std::string &name, const std::vector<std::string>& cols, std::vector<std::pair<Condition, size_t>> conditions)
 		{
 			try
 			{
+				if (PartitionedTable *table = find_partitioned(name))
+					return table->select(cols, conditions);
 				Table *table = get(name);
 				return table->select(cols, conditions);
 			}
@@ -97,10 +422,12 @@ namespace memdb
 			}
 		}
 
-		ResultSet select(const std::string& name, const std::vector<std::string>& columns, ASTNode* ast)
+		ResultSet select_unlocked(const std::string& name, const std::vector<std::string>& columns, ASTNode* ast)
 		{
 			try
 			{
+				if (PartitionedTable* table = find_partitioned(name))
+					return table->select(columns, ast);
 				Table* table = get(name);
 				return table->select(columns, ast);
 			}
@@ -110,129 +437,237 @@ namespace memdb
 			}
 		}
 
-		ResultSet create_ordered_index(const std::string &table_name, const std::vector<std::string> &columns)
+		ResultSet select_unlocked(const std::string& name, const std::vector<std::string>& columns, const std::vector<Aggregate>& aggregates,
+			const std::vector<std::string>& group_by, ASTNode* ast)
 		{
 			try
 			{
-				Table *table = get(table_name);
-				return table->create_ordered_index(columns);
+				if (PartitionedTable* table = find_partitioned(name))
+					return table->select(columns, aggregates, group_by, ast);
+				Table* table = get(name);
+				return table->select(columns, aggregates, group_by, ast);
 			}
-			catch (std::runtime_error &e)
+			catch (std::runtime_error& e)
 			{
 				return error_result(e.what());
 			}
 		}
 
-		ResultSet execute(const std::string &query)
+		ResultSet explain_unlocked(const SelectDef& def, bool analyze, int64_t parse_ns)
 		{
 			try
 			{
-				Lexer lexer(query);
-				const auto &lexems = lexer.tokenize();
-				if (lexems.empty())
+				std::vector<std::pair<std::string, std::string>> items;
+				if (PartitionedTable* partitioned_table = find_partitioned(def.name))
 				{
-					throw std::runtime_error("Empty query.");
-				}
-				if (lexems[0].type == LexemType::CREATE)
-				{
-					if (lexems.size() < 2)
+					// the plan of the first scanned partition, the others have their own
+					std::vector<size_t> parts = partitioned_table->prune(def.ast);
+					items.push_back(std::make_pair("partitions", std::to_string(parts.size()) + " of " + std::to_string(partitioned_table->partitions.size())));
+					if (parts.empty())
 					{
-						throw std::runtime_error("Query too short.");
-					}
-
-					if (lexems[1].type == LexemType::TABLE)
-					{
-						CreateTableParser parser(lexems);
-						CreateTableDef def = parser.parse();
-						return create_table(def.name, def.columns);
+						items.push_back(std::make_pair("access path", to_string(AccessPath::NONE)));
 					}
 					else
 					{
-						CreateIndexParser parser(lexems);
-						IndexDef def = parser.parse();
-						if (def.is_ordered)
-						{
-							return create_ordered_index(def.name, def.columns);
-						}
+						Table* table = partitioned_table->partitions[parts.front()];
+						auto plan_items = table->describe(table->plan_select(def.ast));
+						items.insert(items.end(), plan_items.begin(), plan_items.end());
 					}
 				}
-				else if (lexems[0].type == LexemType::INSERT)
+				else
 				{
-					InsertParser parser(lexems);
-					InsertDef def = parser.parse();
-					if (!def.using_named_values)
-					{
-						return insert(def.name, def.values);
-					}
-					// Prepare values
-					std::vector<Value> values;
-					Table *table = get(def.name);
-					for (const auto &column : table->columns)
-					{
-						if (def.named_values.count(column.name) > 0)
-						{
-							values.push_back(def.named_values.at(column.name));
-						}
-						else
-						{
-							values.push_back(Value()); // to use default
-						}
-					}
-					return insert(def.name, values);
+					Table* table = get(def.name);
+					items = table->describe(table->plan_select(def.ast));
 				}
-				else if (lexems[0].type == LexemType::SELECT)
+				if (analyze)
 				{
-					SelectParser parser(lexems);
-					SelectDef def = parser.parse();
-
-					return select(def.name, def.columns, def.ast);
+					ResultSet rs = !def.aggregates.empty() || !def.group_by.empty()
+						? select_unlocked(def.name, def.columns, def.aggregates, def.group_by, def.ast)
+						: select_unlocked(def.name, def.columns, def.ast);
+					if (!rs.is_ok())
+						return rs;
+					const QueryStats& stats = rs.stats;
+					items.push_back(std::make_pair("rows examined", std::to_string(stats.rows_examined)));
+					items.push_back(std::make_pair("rows matched", std::to_string(stats.rows_matched)));
+					items.push_back(std::make_pair("result rows", std::to_string(rs.get_row_count())));
+					items.push_back(std::make_pair("index probes", std::to_string(stats.index_probes)));
+					items.push_back(std::make_pair("comparisons", std::to_string(stats.comparisons)));
+					items.push_back(std::make_pair("parse time", std::to_string(parse_ns) + " ns"));
+					items.push_back(std::make_pair("plan time", std::to_string(stats.plan_ns) + " ns"));
+					items.push_back(std::make_pair("scan time", std::to_string(stats.scan_ns) + " ns"));
+					items.push_back(std::make_pair("materialize time", std::to_string(stats.materialize_ns) + " ns"));
 				}
-				throw std::runtime_error("Not implemented yet");
+
+				std::vector<std::vector<std::string>> rows;
+				for (const auto& item : items)
+					rows.push_back({ item.first, item.second });
+				return Table::make_text_result({ "property", "value" }, rows);
 			}
-			catch (std::runtime_error &e)
+			catch (std::runtime_error& e)
 			{
 				return error_result(e.what());
 			}
 		}
 
-		void save_to_file(std::ostream &out) const
-		{			
-			write_int(out, tables.size());			
-			for (const auto &p : tables)
+		ResultSet create_ordered_index_unlocked(const std::string &table_name, const std::vector<std::string> &columns)
+		{
+			try
 			{
-				const auto &name = p.first;
-				Table *table = p.second;
-				write_string(out, name);
-				table->save_to_file(out);
+				if (PartitionedTable *table = find_partitioned(table_name))
+					return table->create_ordered_index(columns);
+				Table *table = get(table_name);
+				return table->create_ordered_index(columns);
+			}
+			catch (std::runtime_error &e)
+			{
+				return error_result(e.what());
 			}
 		}
 
-		void load_from_file(std::istream &in)
+		ResultSet create_trigram_index_unlocked(const std::string &table_name, const std::vector<std::string> &columns)
 		{
-			clear();
-			size_t num_tables = read_int<size_t>(in);
-			for (size_t i = 0; i < num_tables; ++i)
+			try
 			{
-				std::string name = read_string(in);
-				Table *table = Table::load_from_file(in);
-				tables.insert(std::make_pair(name, table));
+				if (PartitionedTable *table = find_partitioned(table_name))
+					return table->create_trigram_index(columns);
+				Table *table = get(table_name);
+				return table->create_trigram_index(columns);
+			}
+			catch (std::runtime_error &e)
+			{
+				return error_result(e.what());
 			}
 		}
 
-		void info(std::ostream &out)
+		ResultSet execute(const std::vector<Lexem> &lexems, std::chrono::steady_clock::time_point t1)
 		{
-			out << "Database info:" << std::endl;
-			size_t i = 1;
-			for (const auto &p : tables)
+			if (lexems[0].type == LexemType::CREATE)
 			{
-				const auto &name = p.first;
-				Table *table = p.second;
-				out << i++ << ": " << name << " (" << table->columns.size() << " columns, " << table->row_count << " rows)" << std::endl;
+				if (lexems.size() < 2)
+				{
+					throw std::runtime_error("Query too short.");
+				}
+
+				if (lexems[1].type == LexemType::TABLE)
+				{
+					CreateTableParser parser(lexems);
+					CreateTableDef def = parser.parse();
+					return create_table_unlocked(def.name, def.columns, def.partition);
+				}
+				else
+				{
+					CreateIndexParser parser(lexems);
+					IndexDef def = parser.parse();
+					if (def.is_ordered)
+					{
+						return create_ordered_index_unlocked(def.name, def.columns);
+					}
+					if (def.is_trigram)
+					{
+						return create_trigram_index_unlocked(def.name, def.columns);
+					}
+				}
 			}
-			out << std::endl;
+			else if (lexems[0].type == LexemType::INSERT)
+			{
+				InsertParser parser(lexems);
+				InsertDef def = parser.parse();
+				if (!def.using_named_values)
+				{
+					return insert_unlocked(def.name, def.values);
+				}
+				// Prepare values
+				std::vector<Value> values;
+				for (const auto &column : get_columns(def.name))
+				{
+					if (def.named_values.count(column.name) > 0)
+					{
+						values.push_back(def.named_values.at(column.name));
+					}
+					else
+					{
+						values.push_back(Value()); // to use default
+					}
+				}
+				return insert_unlocked(def.name, values);
+			}
+			else if (lexems[0].type == LexemType::SELECT)
+			{
+				std::string key;
+				if (result_cache)
+				{
+					key = query_key(lexems);
+					ResultSet rs;
+					if (result_cache->find(key, [this](const std::string &name) { return table_version(name); }, rs))
+					{
+						rs.stats = QueryStats();
+						rs.stats.total_ns = elapsed_ns(t1);
+						rs.time_ms = 0;
+						return rs;
+					}
+				}
+
+				std::string fingerprint;
+				std::shared_ptr<const PlanTemplate> plan;
+				if (plan_cache)
+				{
+					fingerprint = query_key(lexems, false);
+					plan = plan_cache->find(fingerprint);
+				}
+
+				ResultSet rs;
+				std::string name;
+				if (plan && plan->simple)
+				{
+					// the conditions are ready, only the literals are replaced
+					std::vector<std::pair<Condition, size_t>> conditions = plan->bind_conditions(lexems);
+					int64_t parse_ns = elapsed_ns(t1);
+					name = plan->def.name;
+					rs = select_unlocked(name, plan->def.columns, conditions);
+					rs.stats.parse_ns = parse_ns;
+					rs.stats.total_ns += parse_ns;
+				}
+				else
+				{
+					bool reused = plan && plan->reusable;
+					SelectDef def = reused ? plan->bind(lexems) : SelectParser(lexems).parse();
+					check_removed(def);
+					// the template is made of a copy taken before the select, which changes the leaves of the columns
+					SelectDef pristine;
+					if (plan_cache && !plan)
+						pristine = PlanTemplate::copy(def);
+					int64_t parse_ns = elapsed_ns(t1);
+					name = def.name;
+					rs = !def.aggregates.empty() || !def.group_by.empty()
+						? select_unlocked(def.name, def.columns, def.aggregates, def.group_by, def.ast)
+						: select_unlocked(def.name, def.columns, def.ast);
+					rs.stats.parse_ns = parse_ns;
+					rs.stats.total_ns += parse_ns;
+					if (plan_cache && !plan && rs.ok)
+						plan_cache->add(fingerprint, PlanTemplate::make(pristine, get_columns(def.name)));
+				}
+				if (result_cache && rs.ok)
+					result_cache->add(key, name, table_version(name), rs);
+				return rs;
+			}
+			else if (lexems[0].type == LexemType::EXPLAIN)
+			{
+				bool analyze = lexems.size() > 1 && lexems[1].type == LexemType::ANALYZE;
+				std::vector<Lexem> select_lexems(lexems.begin() + (analyze ? 2 : 1), lexems.end());
+				SelectParser parser(select_lexems);
+				SelectDef def = parser.parse();
+				check_removed(def);
+				return explain_unlocked(def, analyze, elapsed_ns(t1));
+			}
+			throw std::runtime_error("Not implemented yet");
+		}
+
+		Executor &get_executor()
+		{
+			std::call_once(executor_started, [this]() { executor.reset(new Executor(async_threads)); });
+			return *executor;
 		}
 
-	private:
 		bool check_column_names(const std::vector<Column> &columns)
 		{
 			std::set<std::string> names;
@@ -248,6 +683,75 @@ namespace memdb
 			return nullptr;
 		}
 
+		PartitionedTable *find_partitioned(const std::string &name)
+		{
+			if (partitioned.count(name) > 0)
+				return partitioned.at(name);
+			return nullptr;
+		}
+
+		PartitionedTable *get_partitioned(const std::string &name)
+		{
+			if (partitioned.count(name) > 0)
+				return partitioned.at(name);
+			throw std::runtime_error("No partitioned table with the given name was found.");
+		}
+
+		const std::vector<Column> &get_columns(const std::string &name)
+		{
+			if (PartitionedTable *table = find_partitioned(name))
+				return table->columns;
+			return get(name)->columns;
+		}
+
+		// The parts of the condition dropped by the simplification (nosuch && false is false) are not
+		// seen by the planner. They are checked like the condition: the columns exist, the literals
+		// compared with a column are of its type.
+		void check_removed(const SelectDef &def)
+		{
+			if (def.removed.empty() || (tables.count(def.name) == 0 && partitioned.count(def.name) == 0))
+				return; // the select reports the missing table
+			std::unordered_map<std::string, Type> types;
+			for (const auto &column : get_columns(def.name))
+				types.insert(std::make_pair(column.name, column.type));
+			SymbolVisitor visitor;
+			for (ASTNode *root : def.removed)
+			{
+				for (const auto &item : visitor.visit(root))
+				{
+					if (types.count(item.first) == 0)
+						throw std::runtime_error("Unknown symbol \"" + item.first + "\" in the condition.");
+				}
+			}
+			std::vector<ASTNode *> nodes(def.removed.begin(), def.removed.end());
+			while (!nodes.empty())
+			{
+				InternalNode *node = as_internal(nodes.back());
+				nodes.pop_back();
+				if (!node)
+					continue;
+				LeafNode *left = as_leaf(node->left);
+				LeafNode *right = as_leaf(node->right);
+				if (is_rel_op(node->op) && left && right && left->id.empty() != right->id.empty())
+				{
+					LeafNode *column = left->id.empty() ? right : left;
+					LeafNode *literal = left->id.empty() ? left : right;
+					if (types.at(column->id) != literal->value.type)
+						throw std::runtime_error("Invalid type");
+				}
+				nodes.push_back(node->left);
+				nodes.push_back(node->right);
+			}
+		}
+
+		// Version of the rows of the table, see ResultCache
+		uint64_t table_version(const std::string &name)
+		{
+			if (PartitionedTable *table = find_partitioned(name))
+				return table->version;
+			return get(name)->version;
+		}
+
 		Table *get(const std::string &name)
 		{
 			if (tables.count(name) > 0)
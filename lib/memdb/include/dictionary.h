@@ -0,0 +1,202 @@
+#pragma once
+
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <deque>
+#include <unordered_map>
+#include <algorithm>
+#include <iostream>
+#include <memory>
+#include <mutex>
+
+#include "base.h"
+#include "value.h"
+#include "condition.h"
+#include "utils.h"
+
+namespace memdb
+{
+
+    // Dictionary of a dictionary-encoded string column.
+    // Rows store 32-bit codes instead of the strings. Codes are assigned in the
+    // order of appearance, and the dictionary also keeps the rank of every code
+    // in the sorted order of values, so comparisons can be done on codes.
+    // The ranks are brought up to date by the first comparison after new values,
+    // so adding a value (or loading many of them) does not reorder the others.
+    struct Dictionary
+    {
+        std::deque<std::string> values;                  // code to value (deque keeps the strings in place)
+        std::unordered_map<std::string, uint32_t> codes; // value to code
+
+        Dictionary() {}
+        Dictionary(const Dictionary &) = delete;
+        Dictionary &operator=(const Dictionary &) = delete;
+
+        size_t size() const { return values.size(); }
+
+        // Returns the code of the value, adding it to the dictionary if necessary
+        uint32_t encode(const std::string &val)
+        {
+            auto it = codes.find(val);
+            if (it != codes.end())
+                return it->second;
+
+            uint32_t code = (uint32_t)values.size();
+            values.push_back(val);
+            codes.insert(std::make_pair(val, code));
+            return code;
+        }
+
+        // Code to position in the sorted order of values.
+        // Selects sharing the lock of the database may ask at once, the first one sorts.
+        const std::vector<uint32_t> &ranks() const
+        {
+            std::lock_guard<std::mutex> guard(order_mutex);
+            if (sorted.size() != values.size())
+                sort_new_values();
+            return code_ranks;
+        }
+
+        const std::string &decode(uint32_t code) const
+        {
+            return values[code];
+        }
+
+        bool contains(const std::string &val) const
+        {
+            return codes.count(val) > 0;
+        }
+
+        // Number of values less than val
+        size_t lower_rank(const std::string &val) const
+        {
+            ranks();
+            return std::lower_bound(sorted.begin(), sorted.end(), val,
+                                    [this](uint32_t code, const std::string &v)
+                                    { return values[code] < v; }) -
+                   sorted.begin();
+        }
+
+        // Number of values less than or equal to val
+        size_t upper_rank(const std::string &val) const
+        {
+            ranks();
+            return std::upper_bound(sorted.begin(), sorted.end(), val,
+                                    [this](const std::string &v, uint32_t code)
+                                    { return v < values[code]; }) -
+                   sorted.begin();
+        }
+
+        void save_to_file(std::ostream &out) const
+        {
+            write_int(out, values.size());
+            for (const auto &val : values)
+            {
+                write_string(out, val);
+            }
+        }
+
+        static std::unique_ptr<Dictionary> load_from_file(std::istream &in)
+        {
+            std::unique_ptr<Dictionary> dict(new Dictionary());
+            size_t n = read_int<size_t>(in);
+            dict->codes.reserve(n);
+            for (size_t i = 0; i < n; ++i)
+            {
+                dict->encode(read_string(in));
+            }
+            return dict;
+        }
+
+    private:
+        mutable std::mutex order_mutex;
+        mutable std::vector<uint32_t> sorted;     // codes in the order of values
+        mutable std::vector<uint32_t> code_ranks; // code to position in sorted
+
+        // Sorts the codes added since the last call and merges them into the order
+        void sort_new_values() const
+        {
+            auto less = [this](uint32_t x, uint32_t y) { return values[x] < values[y]; };
+            size_t old_size = sorted.size();
+            for (size_t code = old_size; code < values.size(); ++code)
+                sorted.push_back((uint32_t)code);
+            std::sort(sorted.begin() + old_size, sorted.end(), less);
+            std::inplace_merge(sorted.begin(), sorted.begin() + old_size, sorted.end(), less);
+            code_ranks.resize(sorted.size());
+            for (size_t r = 0; r < sorted.size(); ++r)
+                code_ranks[sorted[r]] = (uint32_t)r;
+        }
+    };
+
+    // Condition on a dictionary-encoded column converted to a range of ranks:
+    // a row matches if the rank of its code is in [begin, end) (or outside of it, if negated).
+    // Patterns are matched once per dictionary value instead.
+    struct CodeRange
+    {
+        const Dictionary *dict = nullptr;
+        const std::vector<uint32_t> *ranks = nullptr;
+        size_t begin = 0;
+        size_t end = 0;
+        bool negate = false;
+        bool by_pattern = false;
+        std::vector<bool> matching; // codes matching the pattern
+
+        CodeRange() {}
+
+        CodeRange(const Dictionary *dict, const Condition &cond) : dict(dict)
+        {
+            if (cond.pattern)
+            {
+                by_pattern = true;
+                matching.resize(dict->size());
+                for (size_t code = 0; code < dict->size(); ++code)
+                    matching[code] = cond.pattern->match(dict->values[code].data(), dict->values[code].size());
+                return;
+            }
+            ranks = &dict->ranks();
+            const std::string val = cond.that.get<std::string>();
+            size_t lower = dict->lower_rank(val);
+            size_t upper = dict->upper_rank(val);
+            switch (cond.op)
+            {
+            case RelOp::EQ:
+                begin = lower;
+                end = upper;
+                break;
+            case RelOp::NE:
+                begin = lower;
+                end = upper;
+                negate = true;
+                break;
+            case RelOp::LT:
+                begin = 0;
+                end = lower;
+                break;
+            case RelOp::LE:
+                begin = 0;
+                end = upper;
+                break;
+            case RelOp::GT:
+                begin = upper;
+                end = dict->size();
+                break;
+            case RelOp::GE:
+                begin = lower;
+                end = dict->size();
+                break;
+            default:
+                break;
+            }
+        }
+
+        bool match(uint32_t code) const
+        {
+            if (by_pattern)
+                return matching[code];
+            size_t rank = (*ranks)[code];
+            return (rank >= begin && rank < end) != negate;
+        }
+    };
+
+}
@@ -0,0 +1,142 @@
+#pragma once
+
+#include <stdexcept>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <chrono>
+#include <algorithm>
+
+#include "base.h"
+#include "querystats.h"
+
+namespace memdb
+{
+
+    // Metrics of the executor of asynchronous queries
+    struct ExecutorStats
+    {
+        size_t threads = 0;
+        size_t queue_depth = 0;     // tasks waiting for a thread now
+        size_t max_queue_depth = 0; // the largest queue depth seen
+        size_t submitted = 0;
+        size_t completed = 0;
+        int64_t wait_ns = 0;        // total time the tasks spent in the queue
+        int64_t exec_ns = 0;        // total time of running the tasks
+    };
+
+    // Fixed pool of threads running the submitted tasks in the order of submission.
+    // The destructor runs the tasks left in the queue and joins the threads.
+    class Executor
+    {
+        struct Task
+        {
+            std::function<void()> func;
+            std::chrono::steady_clock::time_point submitted;
+        };
+
+        std::vector<std::thread> threads;
+        std::deque<Task> queue;
+        mutable std::mutex mutex;
+        std::condition_variable cv;
+        bool stopping = false;
+        ExecutorStats stats;
+
+    public:
+        // num_threads = 0 means the number of hardware threads
+        Executor(size_t num_threads = 0)
+        {
+            num_threads = num_threads > 0 ? num_threads : std::max(1u, std::thread::hardware_concurrency());
+            stats.threads = num_threads;
+            for (size_t i = 0; i < num_threads; ++i)
+            {
+                threads.emplace_back([this]() { work(); });
+            }
+        }
+
+        Executor(const Executor &) = delete;
+        Executor &operator=(const Executor &) = delete;
+
+        ~Executor()
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                stopping = true;
+            }
+            cv.notify_all();
+            for (auto &thread : threads)
+            {
+                thread.join();
+            }
+        }
+
+        void submit(std::function<void()> func)
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                push(std::move(func));
+            }
+            cv.notify_one();
+        }
+
+        // Submits the tasks at once, taking the lock once
+        void submit(std::vector<std::function<void()>> funcs)
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                for (auto &func : funcs)
+                {
+                    push(std::move(func));
+                }
+            }
+            cv.notify_all();
+        }
+
+        ExecutorStats get_stats() const
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            ExecutorStats result = stats;
+            result.queue_depth = queue.size();
+            return result;
+        }
+
+    private:
+        void push(std::function<void()> func)
+        {
+            if (stopping)
+                throw std::runtime_error("The executor is stopped.");
+            queue.push_back(Task{ std::move(func), std::chrono::steady_clock::now() });
+            stats.submitted++;
+            stats.max_queue_depth = std::max(stats.max_queue_depth, queue.size());
+        }
+
+        void work()
+        {
+            while (true)
+            {
+                Task task;
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    cv.wait(lock, [this]() { return stopping || !queue.empty(); });
+                    if (queue.empty())
+                        return; // stopping and nothing left to do
+                    task = std::move(queue.front());
+                    queue.pop_front();
+                    stats.wait_ns += elapsed_ns(task.submitted);
+                }
+
+                std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+                task.func();
+                int64_t exec_ns = elapsed_ns(start);
+
+                std::lock_guard<std::mutex> lock(mutex);
+                stats.exec_ns += exec_ns;
+                stats.completed++;
+            }
+        }
+    };
+
+}
@@ -0,0 +1,149 @@
+#pragma once
+
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <thread>
+#include <algorithm>
+#include <cstring>
+
+#include "base.h"
+#include "column.h"
+#include "dictionary.h"
+
+namespace memdb
+{
+
+    // Copy of a run of bytes from a table row to a result row
+    struct CopySegment
+    {
+        uint16_t src; // offset in the table row
+        uint16_t dst; // offset in the result row
+        uint16_t len;
+    };
+
+    // Dictionary-encoded column decoded into a result row
+    struct DecodeStep
+    {
+        const Dictionary *dict;
+        uint16_t src; // offset of the code in the table row
+        uint16_t dst; // offset of the string in the result row
+        uint16_t size; // size of the result column
+    };
+
+    // Plan of copying the selected columns of table rows into a result.
+    // It is built once per query: columns which are adjacent both in the table row
+    // and in the result row are merged into one segment, so selecting all columns
+    // in the table order is a single copy per row.
+    // Large results are copied by several threads.
+    class GatherPlan
+    {
+        static constexpr size_t MIN_BYTES_PER_THREAD = 4 * 1024 * 1024;
+
+        std::vector<CopySegment> segments;
+        std::vector<DecodeStep> decodes;
+        size_t max_threads;
+
+    public:
+        // max_threads = 0 means the number of hardware threads
+        GatherPlan(size_t max_threads = 0)
+            : max_threads(max_threads > 0 ? max_threads : std::max(1u, std::thread::hardware_concurrency()))
+        {
+        }
+
+        // Adds the next column of the result
+        void add(const Column &column, uint16_t dst, const Dictionary *dict)
+        {
+            if (column.is_dict)
+            {
+                decodes.push_back({ dict, column.offset, dst, column.size });
+                return;
+            }
+            if (!segments.empty())
+            {
+                CopySegment &last = segments.back();
+                if (last.src + last.len == column.offset && last.dst + last.len == dst)
+                {
+                    last.len += column.size;
+                    return;
+                }
+            }
+            segments.push_back({ column.offset, dst, column.size });
+        }
+
+        const std::vector<CopySegment> &get_segments() const { return segments; }
+
+        void run(const uint8_t *storage, uint16_t row_size, const std::vector<size_t> &rows, uint8_t *out, uint16_t out_row_size) const
+        {
+            size_t bytes = rows.size() * out_row_size;
+            size_t num_threads = std::min<size_t>(max_threads, std::max<size_t>(1, bytes / MIN_BYTES_PER_THREAD));
+            if (num_threads == 1)
+            {
+                run(storage, row_size, rows, 0, rows.size(), out, out_row_size);
+                return;
+            }
+            size_t chunk = (rows.size() + num_threads - 1) / num_threads;
+            std::vector<std::thread> threads;
+            for (size_t t = 0; t < num_threads; ++t)
+            {
+                size_t begin = std::min(rows.size(), t * chunk);
+                size_t end = std::min(rows.size(), begin + chunk);
+                threads.emplace_back([=, &rows]() { run(storage, row_size, rows, begin, end, out, out_row_size); });
+            }
+            for (auto &thread : threads)
+            {
+                thread.join();
+            }
+        }
+
+    private:
+        void run(const uint8_t *storage, uint16_t row_size, const std::vector<size_t> &rows, size_t begin, size_t end,
+                 uint8_t *out, uint16_t out_row_size) const
+        {
+            if (segments.size() == 1 && decodes.empty())
+            {
+                // the most frequent cases get copies of a constant size
+                switch (segments[0].len)
+                {
+                case 4:
+                    return copy_fixed<4>(storage, row_size, rows, begin, end, out, out_row_size);
+                case 8:
+                    return copy_fixed<8>(storage, row_size, rows, begin, end, out, out_row_size);
+                case 16:
+                    return copy_fixed<16>(storage, row_size, rows, begin, end, out, out_row_size);
+                case 32:
+                    return copy_fixed<32>(storage, row_size, rows, begin, end, out, out_row_size);
+                }
+            }
+            for (size_t i = begin; i < end; ++i)
+            {
+                const uint8_t *row_ptr = storage + rows[i] * row_size;
+                uint8_t *out_ptr = out + i * out_row_size;
+                for (const auto &segment : segments)
+                {
+                    std::memcpy(out_ptr + segment.dst, row_ptr + segment.src, segment.len);
+                }
+                for (const auto &step : decodes)
+                {
+                    uint32_t code;
+                    std::memcpy(&code, row_ptr + step.src, sizeof(code));
+                    const std::string &val = step.dict->decode(code);
+                    std::memcpy(out_ptr + step.dst, val.c_str(), std::min<size_t>(val.size() + 1, step.size));
+                }
+            }
+        }
+
+        template <size_t LEN>
+        void copy_fixed(const uint8_t *storage, uint16_t row_size, const std::vector<size_t> &rows, size_t begin, size_t end,
+                        uint8_t *out, uint16_t out_row_size) const
+        {
+            uint16_t src = segments[0].src;
+            uint16_t dst = segments[0].dst;
+            for (size_t i = begin; i < end; ++i)
+            {
+                std::memcpy(out + i * out_row_size + dst, storage + rows[i] * row_size + src, LEN);
+            }
+        }
+    };
+
+}
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <string>
+#include <string_view>
 
 namespace memdb
 {
@@ -11,6 +12,8 @@ namespace memdb
 		UNIQUE,
 		AUTO,
 		KEY,
+		BLOOM,
+		DICT,
 		INSERT,
 		TO,
 		SELECT,
@@ -23,8 +26,14 @@ namespace memdb
 		INDEX,
 		ON,
 		BY,
+		GROUP,
+		EXPLAIN,
+		ANALYZE,
+		PARTITION,
+		INTO,
 		ORDERED,
 		UNORDERED,
+		TRIGRAM,
 		INT32,
 		BOOL,
 		STRING,
@@ -40,6 +49,8 @@ namespace memdb
 		GT,
 		LE,
 		GE,
+		LIKE,
+		STARTS_WITH,
 		AND,
 		NOT,
 		OR,
@@ -65,7 +76,7 @@ namespace memdb
 	struct Lexem
 	{
 		LexemType type = LexemType::EOQ;
-		std::string value;
+		std::string_view value; // points into the query text
 		size_t line = 0;
 		size_t col = 0;
 		size_t begin = 0;
@@ -3,33 +3,68 @@
 #include <stdexcept>
 #include <string>
 #include <vector>
-#include <set>
-#include <map>
+#include <string_view>
 #include <sstream>
-#include <cctype>
+#include <cstdint>
 
 #include "lexem.h"
 #include "utils.h"
 
 namespace memdb
 {
-	// Whitespace characters
-	std::set<char> WS = {' ', '\t', '\r', '\n'};
-	// Punctuation characters
-	std::set<char> PUNCT = {
-		'.', ',', ':', '{',
-		'}', '(', ')', '[',
-		']', '<', '>', '=',
-		'!', '&', '|', '^',
-		'+', '-', '*', '/',
-		'%'};
-
-	std::map<std::string, LexemType> RESERVED = {
+	// Character classes
+	enum CharClass : uint8_t
+	{
+		CH_WS = 1,	  // whitespace
+		CH_PUNCT = 2, // punctuation
+		CH_ALPHA = 4, // letters and underscore (identifier start)
+		CH_DIGIT = 8,
+		CH_HEX = 16 // hexadecimal digits
+	};
+
+	// Classes of all 256 characters, so classification is a single table lookup
+	struct CharTable
+	{
+		uint8_t classes[256] = {};
+
+		constexpr CharTable()
+		{
+			for (char c : std::string_view(" \t\r\n"))
+				classes[(uint8_t)c] |= CH_WS;
+			for (char c : std::string_view(".,:{}()[]<>=!&|^+-*/%"))
+				classes[(uint8_t)c] |= CH_PUNCT;
+			for (int c = 'a'; c <= 'z'; ++c)
+				classes[c] |= CH_ALPHA;
+			for (int c = 'A'; c <= 'Z'; ++c)
+				classes[c] |= CH_ALPHA;
+			classes[(uint8_t)'_'] |= CH_ALPHA;
+			for (int c = '0'; c <= '9'; ++c)
+				classes[c] |= CH_DIGIT | CH_HEX;
+			for (int c = 'a'; c <= 'f'; ++c)
+				classes[c] |= CH_HEX;
+			for (int c = 'A'; c <= 'F'; ++c)
+				classes[c] |= CH_HEX;
+		}
+
+		constexpr bool is(char c, uint8_t cls) const { return (classes[(uint8_t)c] & cls) != 0; }
+	};
+
+	constexpr CharTable CHARS;
+
+	struct Keyword
+	{
+		std::string_view text;
+		LexemType type;
+	};
+
+	constexpr Keyword KEYWORDS[] = {
 		{"create", LexemType::CREATE},
 		{"table", LexemType::TABLE},
 		{"unique", LexemType::UNIQUE},
 		{"autoincrement", LexemType::AUTO},
 		{"key", LexemType::KEY},
+		{"bloom", LexemType::BLOOM},
+		{"dict", LexemType::DICT},
 		{"insert", LexemType::INSERT},
 		{"to", LexemType::TO},
 		{"select", LexemType::SELECT},
@@ -42,27 +77,110 @@ namespace memdb
 		{"index", LexemType::INDEX},
 		{"on", LexemType::ON},
 		{"by", LexemType::BY},
+		{"group", LexemType::GROUP},
+		{"explain", LexemType::EXPLAIN},
+		{"analyze", LexemType::ANALYZE},
+		{"partition", LexemType::PARTITION},
+		{"into", LexemType::INTO},
+		{"like", LexemType::LIKE},
+		{"starts_with", LexemType::STARTS_WITH},
 		{"ordered", LexemType::ORDERED},
 		{"unordered", LexemType::UNORDERED},
+		{"trigram", LexemType::TRIGRAM},
 		{"int32", LexemType::INT32},
 		{"bool", LexemType::BOOL},
 		{"string", LexemType::STRING},
 		{"bytes", LexemType::BYTES},
 		{"true", LexemType::BOOL_LIT},
-		{"false", LexemType::BOOL_LIT}};	
+		{"false", LexemType::BOOL_LIT}};
+
+	constexpr char to_lower(char c)
+	{
+		return c >= 'A' && c <= 'Z' ? (char)(c - 'A' + 'a') : c;
+	}
+
+	// Case-insensitive FNV-1a with a finalizer, so all bits of the seed affect the low bits
+	constexpr uint32_t keyword_hash(std::string_view s, uint32_t seed)
+	{
+		uint32_t h = seed;
+		for (char c : s)
+		{
+			h ^= (uint8_t)to_lower(c);
+			h *= 16777619u;
+		}
+		h ^= h >> 16;
+		h *= 0x85ebca6bu;
+		h ^= h >> 13;
+		return h;
+	}
+
+	// Perfect hash table of the keywords. The seed of the hash function
+	// giving no collisions is found at compile time.
+	struct KeywordTable
+	{
+		static constexpr size_t SIZE = 128;
+		static constexpr size_t NUM_KEYWORDS = sizeof(KEYWORDS) / sizeof(KEYWORDS[0]);
+
+		uint32_t seed = 0;
+		uint8_t slots[SIZE] = {}; // keyword index + 1, 0 for an empty slot
+		bool ok = false;
+
+		constexpr KeywordTable()
+		{
+			for (uint32_t candidate = 2166136261u; !ok && candidate < 2166136261u + 10000; ++candidate)
+			{
+				for (size_t i = 0; i < SIZE; ++i)
+					slots[i] = 0;
+				ok = true;
+				for (size_t k = 0; k < NUM_KEYWORDS && ok; ++k)
+				{
+					size_t slot = keyword_hash(KEYWORDS[k].text, candidate) % SIZE;
+					if (slots[slot] != 0)
+						ok = false;
+					else
+						slots[slot] = (uint8_t)(k + 1);
+				}
+				seed = candidate;
+			}
+		}
+
+		// Returns the keyword matching the identifier or nullptr
+		const Keyword *find(std::string_view id) const
+		{
+			uint8_t k = slots[keyword_hash(id, seed) % SIZE];
+			if (k == 0)
+				return nullptr;
+			const Keyword &keyword = KEYWORDS[k - 1];
+			if (keyword.text.size() != id.size())
+				return nullptr;
+			for (size_t i = 0; i < id.size(); ++i)
+			{
+				if (to_lower(id[i]) != keyword.text[i])
+					return nullptr;
+			}
+			return &keyword;
+		}
+	};
+
+	constexpr KeywordTable RESERVED;
+	static_assert(RESERVED.ok, "No perfect hash seed for the keywords");
 
 	class LexicalError : public std::exception
 	{
 		size_t line;
 		size_t col;
+		std::string message;
 
 	public:
-		LexicalError(size_t line, size_t col) : std::exception(), line(line), col(col) {}
-		virtual const char *what() const noexcept
+		LexicalError(size_t line, size_t col) : std::exception(), line(line), col(col)
 		{
 			std::ostringstream oss;
 			oss << "Lexical error at line " << line << " position " << col;
-			return oss.str().c_str();
+			message = oss.str();
+		}
+		virtual const char *what() const noexcept
+		{
+			return message.c_str();
 		}
 	};
 
@@ -73,15 +191,10 @@ namespace memdb
 		size_t col = 1;
 		const std::string &s;
 
-		static bool is_hex_digit(char c)
-		{
-			return isdigit(c) || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F');
-		}
-
 		void skip_ws()
 		{
 			// Skip whitespace characters
-			while (pos < s.size() && WS.count(s[pos]) > 0)
+			while (pos < s.size() && CHARS.is(s[pos], CH_WS))
 			{
 				if (s[pos] == '\n')
 				{
@@ -193,40 +306,27 @@ namespace memdb
 				lexem.type == LexemType::XOR)
 			{
 				lexem.end = pos + 2;
-				lexem.value = s.substr(pos, 2);
+				lexem.value = std::string_view(s).substr(pos, 2);
 			}
 			else
 			{
 				lexem.end = pos + 1;
-				lexem.value = s.substr(pos, 1);
+				lexem.value = std::string_view(s).substr(pos, 1);
 			}
 		}
 
 		void scan_id(Lexem &lexem)
 		{
 			size_t p = pos;
-			while (p < s.size() && (isalnum(s[p]) || s[p] == '_'))
+			while (p < s.size() && CHARS.is(s[p], CH_ALPHA | CH_DIGIT))
 			{
 				p += 1;
 			}
 			lexem.end = p;
-			lexem.value = s.substr(lexem.begin, lexem.end - lexem.begin);
+			lexem.value = std::string_view(s).substr(lexem.begin, lexem.end - lexem.begin);
 
-			bool is_keyword = false;
-			for (const auto &kv : RESERVED)
-			{
-				const std::string &keyword = kv.first;
-				if (strcmpi(keyword, lexem.value))
-				{
-					lexem.type = kv.second;
-					is_keyword = true;
-					break;
-				}
-			}
-			if (!is_keyword)
-			{
-				lexem.type = LexemType::ID;
-			}
+			const Keyword *keyword = RESERVED.find(lexem.value);
+			lexem.type = keyword ? keyword->type : LexemType::ID;
 		}
 
 		void scan_number(Lexem &lexem)
@@ -235,28 +335,28 @@ namespace memdb
 			{
 				// bytes literal
 				size_t p = pos + 2;
-				while (p < s.size() && is_hex_digit(s[p]))
+				while (p < s.size() && CHARS.is(s[p], CH_HEX))
 				{
 					p++;
 				}
-				if (p < s.size() && WS.count(s[p]) == 0 && PUNCT.count(s[p]) == 0)
+				if (p < s.size() && !CHARS.is(s[p], CH_WS | CH_PUNCT))
 					throw LexicalError(line, col);
 				lexem.end = p;
-				lexem.value = s.substr(lexem.begin, lexem.end - lexem.begin);
+				lexem.value = std::string_view(s).substr(lexem.begin, lexem.end - lexem.begin);
 				lexem.type = LexemType::BT_LIT;
 			}
 			else
 			{
 				// int32 literal or just number
 				size_t p = pos + 1;
-				while (p < s.size() && isdigit(s[p]))
+				while (p < s.size() && CHARS.is(s[p], CH_DIGIT))
 				{
 					p++;
 				}
-				if (p < s.size() && WS.count(s[p]) == 0 && PUNCT.count(s[p]) == 0)
+				if (p < s.size() && !CHARS.is(s[p], CH_WS | CH_PUNCT))
 					throw LexicalError(line, col);
 				lexem.end = p;
-				lexem.value = s.substr(lexem.begin, lexem.end - lexem.begin);
+				lexem.value = std::string_view(s).substr(lexem.begin, lexem.end - lexem.begin);
 				lexem.type = LexemType::INT_LIT;
 				if (lexem.value.length() > 1 && lexem.value.front() == '0')
 					throw LexicalError(line, col); // Leading zero(es) not allowed
@@ -289,7 +389,7 @@ namespace memdb
 			}
 			lexem.begin += 1;
 			lexem.end = p;
-			lexem.value = s.substr(lexem.begin, lexem.end - lexem.begin);
+			lexem.value = std::string_view(s).substr(lexem.begin, lexem.end - lexem.begin);
 			lexem.type = LexemType::STR_LIT;
 			pos = p + 1;
 		}
@@ -300,6 +400,7 @@ namespace memdb
 		std::vector<Lexem> tokenize()
 		{
 			std::vector<Lexem> lexems;
+			lexems.reserve(s.size() / 4 + 1);
 			skip_ws();
 			while (pos < s.size())
 			{
@@ -309,15 +410,15 @@ namespace memdb
 				lexem.line = line;
 				lexem.col = col;
 
-				if (PUNCT.count(c) > 0)
+				if (CHARS.is(c, CH_PUNCT))
 				{
 					scan_punct(lexem);
 				}
-				else if (isalpha(c) || c == '_')
+				else if (CHARS.is(c, CH_ALPHA))
 				{
 					scan_id(lexem);
 				}
-				else if (isdigit(c))
+				else if (CHARS.is(c, CH_DIGIT))
 				{
 					scan_number(lexem);
 				}
@@ -351,4 +452,24 @@ namespace memdb
 		}
 	};
 
+
+	// Key of the query without the differences in spaces and keyword case: the lexem types
+	// and the text of identifiers and literals. Without literals queries differing only
+	// in the literal values have the same key.
+	inline std::string query_key(const std::vector<Lexem>& lexems, bool with_literals = true)
+	{
+		std::string key;
+		for (const auto& lexem : lexems)
+		{
+			key += std::to_string((int)lexem.type);
+			if (lexem.type == LexemType::ID || (with_literals && is_literal(lexem)))
+			{
+				key += ":" + std::to_string(lexem.value.size()) + ":";
+				key += lexem.value;
+			}
+			key += ' ';
+		}
+		return key;
+	}
+
 }
@@ -5,8 +5,14 @@
 #include "column.h"
 #include "value.h"
 #include "condition.h"
+#include "aggregate.h"
+#include "stats.h"
+#include "plan.h"
+#include "querystats.h"
 #include "resultrow.h"
 #include "resultset.h"
 #include "table.h"
+#include "partitioned_table.h"
+#include "writer.h"
 #include "database.h"
 
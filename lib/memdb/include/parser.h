@@ -7,6 +7,7 @@
 #include <map>
 #include <sstream>
 #include <cctype>
+#include <memory>
 
 #include "base.h"
 #include "value.h"
@@ -15,6 +16,8 @@
 #include "utils.h"
 #include "ast.h"
 #include "visitor.h"
+#include "aggregate.h"
+#include "partition.h"
 
 namespace memdb
 {
@@ -22,6 +25,7 @@ namespace memdb
 	{
 		std::string name;
 		std::vector<Column> columns;
+		PartitionScheme partition;
 	};
 
 	struct InsertDef
@@ -37,13 +41,19 @@ namespace memdb
 		std::string name;
 		std::vector<std::string> columns;
 		bool is_ordered = false;
+		bool is_trigram = false;
 	};	
 
 	struct SelectDef
 	{
 		std::string name;
 		std::vector<std::string> columns;
+		std::vector<Aggregate> aggregates;
+		std::vector<std::string> group_by;
 		ASTNode *ast = nullptr;
+		std::shared_ptr<ASTArena> arena; // owns the nodes of ast
+		std::vector<std::pair<LeafNode*, size_t>> literals; // leaves made of literals with the positions of their lexems
+		std::vector<ASTNode*> removed; // parts of the condition dropped by the simplification, in the arena too
 	};
 	
 	class Parser
@@ -93,6 +103,8 @@ namespace memdb
 		bool is_unique = false;
 		bool is_auto = false;
 		bool is_key = false;
+		bool has_bloom = false;
+		bool is_dict = false;
 		std::string name;
 		Type type = Type::NONE;
 		uint16_t size = 0;
@@ -109,11 +121,49 @@ namespace memdb
 			accept(LexemType::LPAR);
 			parse_column_def_list();
 			accept(LexemType::RPAR);
+			if (peek().type == LexemType::PARTITION)
+			{
+				parse_partition();
+			}
 			accept(LexemType::EOQ);
 
 			return def;
 		}
 
+		// partition by hash(column) into N
+		// partition by range(column) [every N]
+		void parse_partition()
+		{
+			accept(LexemType::PARTITION);
+			accept(LexemType::BY);
+			const Lexem &kind = accept(LexemType::ID);
+			if (strcmpi(kind.value, "hash"))
+				def.partition.kind = PartitionKind::HASH;
+			else if (strcmpi(kind.value, "range"))
+				def.partition.kind = PartitionKind::RANGE;
+			else
+				syntax_error(); // Unknown partitioning
+			accept(LexemType::LPAR);
+			def.partition.column = accept(LexemType::ID).value;
+			accept(LexemType::RPAR);
+
+			if (def.partition.kind == PartitionKind::HASH)
+			{
+				accept(LexemType::INTO);
+				int32_t count = lex_to_int(accept(LexemType::INT_LIT).value);
+				if (count <= 0)
+					throw std::runtime_error("The number of partitions must be positive.");
+				def.partition.count = (size_t)count;
+			}
+			else if (peek().type == LexemType::ID && strcmpi(peek().value, "every"))
+			{
+				accept(LexemType::ID);
+				def.partition.width = lex_to_int(accept(LexemType::INT_LIT).value);
+				if (def.partition.width <= 0)
+					throw std::runtime_error("The partition range must be positive.");
+			}
+		}
+
 		void parse_column_def_list()
 		{
 			parse_column_def();
@@ -130,6 +180,8 @@ namespace memdb
 			def.columns.back().is_auto = is_auto;
 			def.columns.back().is_key = is_key;
 			def.columns.back().is_unique = is_unique;
+			def.columns.back().has_bloom = has_bloom;
+			def.columns.back().is_dict = is_dict;
 			if (!def_value.is_empty())
 			{
 				def.columns.back().has_default = true;
@@ -148,6 +200,8 @@ namespace memdb
 			is_unique = false;
 			is_auto = false;
 			is_key = false;
+			has_bloom = false;
+			is_dict = false;
 			def_value = Value();
 
 			parse_column_attr();
@@ -199,6 +253,16 @@ namespace memdb
 				is_key = true;
 				accept(LexemType::KEY);
 			}
+			else if (peek().type == LexemType::BLOOM)
+			{
+				has_bloom = true;
+				accept(LexemType::BLOOM);
+			}
+			else if (peek().type == LexemType::DICT)
+			{
+				is_dict = true;
+				accept(LexemType::DICT);
+			}
 			else
 			{
 				// Unknown attribute
@@ -240,7 +304,7 @@ namespace memdb
 			accept(LexemType::STRING);
 			accept(LexemType::LBRK);
 			// TODO: check int value
-			size = (uint16_t)std::stoi(accept(LexemType::INT_LIT).value);
+			size = (uint16_t)lex_to_int(accept(LexemType::INT_LIT).value);
 			accept(LexemType::RBRK);
 		}
 
@@ -249,7 +313,7 @@ namespace memdb
 			accept(LexemType::BYTES);
 			accept(LexemType::LBRK);
 			// TODO: check int value
-			size = (uint16_t)std::stoi(accept(LexemType::INT_LIT).value);
+			size = (uint16_t)lex_to_int(accept(LexemType::INT_LIT).value);
 			accept(LexemType::RBRK);
 		}
 
@@ -260,7 +324,7 @@ namespace memdb
 				accept(LexemType::EQ);
 				if (peek().type == LexemType::INT_LIT)
 				{
-					def_value = Value(std::stoi(accept(LexemType::INT_LIT).value));
+					def_value = Value(lex_to_int(accept(LexemType::INT_LIT).value));
 				}
 				else if (peek().type == LexemType::BOOL_LIT)
 				{
@@ -275,7 +339,7 @@ namespace memdb
 				}
 				else if (peek().type == LexemType::STR_LIT)
 				{
-					def_value = Value(accept(LexemType::STR_LIT).value);
+					def_value = Value(std::string(accept(LexemType::STR_LIT).value));
 				}
 				else if (peek().type == LexemType::BT_LIT)
 				{
@@ -349,7 +413,7 @@ namespace memdb
 				Value value;
 				if (peek().type == LexemType::INT_LIT)
 				{
-					value = Value(std::stoi(accept(LexemType::INT_LIT).value));
+					value = Value(lex_to_int(accept(LexemType::INT_LIT).value));
 				}
 				else if (peek().type == LexemType::BOOL_LIT)
 				{
@@ -364,7 +428,7 @@ namespace memdb
 				}
 				else if (peek().type == LexemType::STR_LIT)
 				{
-					value = Value(accept(LexemType::STR_LIT).value);
+					value = Value(std::string(accept(LexemType::STR_LIT).value));
 				}
 				else if (peek().type == LexemType::BT_LIT)
 				{
@@ -396,12 +460,12 @@ namespace memdb
 
 		void parse_value_def2()
 		{
-			std::string name = accept(LexemType::ID).value;
+			std::string name(accept(LexemType::ID).value);
 			accept(LexemType::EQ);
 			Value value;
 			if (peek().type == LexemType::INT_LIT)
 			{
-				value = Value(std::stoi(accept(LexemType::INT_LIT).value));
+				value = Value(lex_to_int(accept(LexemType::INT_LIT).value));
 			}
 			else if (peek().type == LexemType::BOOL_LIT)
 			{
@@ -416,7 +480,7 @@ namespace memdb
 			}
 			else if (peek().type == LexemType::STR_LIT)
 			{
-				value = Value(accept(LexemType::STR_LIT).value);
+				value = Value(std::string(accept(LexemType::STR_LIT).value));
 			}
 			else if (peek().type == LexemType::BT_LIT)
 			{
@@ -451,6 +515,11 @@ namespace memdb
 				accept(LexemType::UNORDERED);
 				def.is_ordered = false;
 			}
+			else if (peek().type == LexemType::TRIGRAM)
+			{
+				accept(LexemType::TRIGRAM);
+				def.is_trigram = true;
+			}
 			else
 			{
 				// Unexpected lexem
@@ -468,7 +537,7 @@ namespace memdb
 
 		void parse_column_list()
 		{
-			def.columns.push_back(accept(LexemType::ID).value);
+			def.columns.emplace_back(accept(LexemType::ID).value);
 			parse_column_list_tail();
 		}
 
@@ -491,26 +560,89 @@ namespace memdb
 
 		SelectDef parse()
 		{
+			def.arena = std::make_shared<ASTArena>();
 			accept(LexemType::SELECT);
 			parse_columns();			
 			accept(LexemType::FROM);			
 			def.name = accept(LexemType::ID).value;
-			accept(LexemType::WHERE);
-			def.ast = parse_or();
+			if (peek().type == LexemType::WHERE)
+			{
+				accept(LexemType::WHERE);
+				def.ast = parse_or();
+			}
+			else
+			{
+				def.ast = def.arena->leaf(Value(true)); // select all
+			}
+			if (peek().type == LexemType::GROUP)
+			{
+				accept(LexemType::GROUP);
+				accept(LexemType::BY);
+				parse_group_by();
+			}
 			accept(LexemType::EOQ);
 
-			CondSimplifyVisitor visitor;
+			CondSimplifyVisitor visitor(*def.arena);
 			def.ast = visitor.visit(def.ast);
+			def.removed = visitor.removed;
 			return def;
 		}
 	private:
 		void parse_columns()
 		{			
-			def.columns.push_back(accept(LexemType::ID).value);
+			parse_column();
+			while (peek().type == LexemType::COMMA)
+			{
+				accept(LexemType::COMMA);
+				parse_column();
+			}
+		}
+
+		void parse_column()
+		{
+			const std::string name(accept(LexemType::ID).value);
+			if (peek().type != LexemType::LPAR)
+			{
+				def.columns.push_back(name);
+				return;
+			}
+
+			// Aggregate function
+			AggFunc func = AggFunc::COUNT;
+			if (strcmpi(name, "count"))
+				func = AggFunc::COUNT;
+			else if (strcmpi(name, "sum"))
+				func = AggFunc::SUM;
+			else if (strcmpi(name, "min"))
+				func = AggFunc::MIN;
+			else if (strcmpi(name, "max"))
+				func = AggFunc::MAX;
+			else
+				syntax_error(); // Unknown function
+			accept(LexemType::LPAR);
+			std::string column;
+			if (func == AggFunc::COUNT && peek().type == LexemType::MULT)
+			{
+				accept(LexemType::MULT);
+				column = "*";
+			}
+			else
+			{
+				column = accept(LexemType::ID).value;
+			}
+			accept(LexemType::RPAR);
+			Aggregate agg(func, column);
+			def.columns.push_back(agg.name());
+			def.aggregates.push_back(agg);
+		}
+
+		void parse_group_by()
+		{
+			def.group_by.emplace_back(accept(LexemType::ID).value);
 			while (peek().type == LexemType::COMMA)
 			{
 				accept(LexemType::COMMA);
-				def.columns.push_back(accept(LexemType::ID).value);
+				def.group_by.emplace_back(accept(LexemType::ID).value);
 			}
 		}
 
@@ -520,7 +652,7 @@ namespace memdb
 			while (peek().type == LexemType::OR)
 			{				
 				accept(peek().type);
-				node = new InternalNode(Op::OR, node, parse_xor());
+				node = def.arena->internal(Op::OR, node, parse_xor());
 			}
 			return node;
 		}
@@ -531,7 +663,7 @@ namespace memdb
 			while (peek().type == LexemType::XOR)
 			{				
 				accept(peek().type);
-				node = new InternalNode(Op::XOR, node, parse_and());
+				node = def.arena->internal(Op::XOR, node, parse_and());
 			}
 			return node;
 		}
@@ -542,7 +674,7 @@ namespace memdb
 			while (peek().type == LexemType::AND)
 			{				
 				accept(peek().type);
-				node = new InternalNode(Op::AND, node, parse_rel());
+				node = def.arena->internal(Op::AND, node, parse_rel());
 			}
 			return node;
 		}
@@ -553,7 +685,7 @@ namespace memdb
 			if (is_rel_op(peek()))
 			{
 				const auto& lex = accept(peek().type);
-				return new InternalNode(lex_to_op(lex), node, parse_sum_expr());
+				return def.arena->internal(lex_to_op(lex), node, parse_sum_expr());
 			}
 			return node;
 		}
@@ -564,7 +696,7 @@ namespace memdb
 			while (peek().type == LexemType::PLUS || peek().type == LexemType::MINUS)
 			{
 				const auto& lex = accept(peek().type);
-				node = new InternalNode(lex_to_op(lex), node, parse_mul_expr());
+				node = def.arena->internal(lex_to_op(lex), node, parse_mul_expr());
 			}
 			return node;
 		}
@@ -575,7 +707,7 @@ namespace memdb
 			while (peek().type == LexemType::MULT || peek().type == LexemType::DIV || peek().type == LexemType::MOD)
 			{
 				const auto& lex = accept(peek().type);
-				node = new InternalNode(lex_to_op(lex), node, parse_factor());
+				node = def.arena->internal(lex_to_op(lex), node, parse_factor());
 			}
 			return node;
 		}
@@ -587,23 +719,26 @@ namespace memdb
 			{
 				// Unary operation
 				const auto& lex = accept(peek().type);
-				return new InternalNode(lex_to_op(lex), parse_factor(), nullptr);
+				return def.arena->internal(lex_to_op(lex), parse_factor(), nullptr);
 			}
 			if (peek().type == LexemType::NOT)
 			{
 				// Unary operation
 				accept(peek().type);
-				return new InternalNode(Op::NOT, parse_factor(), nullptr);
+				return def.arena->internal(Op::NOT, parse_factor(), nullptr);
 			}
 			if (peek().type == LexemType::ID)
 			{
 				// Variable				
-				return new LeafNode(accept(peek().type).value);
+				return def.arena->leaf(std::string(accept(peek().type).value));
 			}
 			else if (is_literal(peek()))
 			{
-				// Literal				
-				return new LeafNode(lex_to_value(accept(peek().type)));
+				// Literal
+				size_t lexem_pos = pos;
+				LeafNode* leaf = def.arena->leaf(lex_to_value(accept(peek().type)));
+				def.literals.push_back(std::make_pair(leaf, lexem_pos));
+				return leaf;
 			}
 			else if (peek().type == LexemType::LPAR)
 			{
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <stdexcept>
+#include <string>
+#include <iostream>
+#include <algorithm>
+
+#include "base.h"
+#include "value.h"
+#include "utils.h"
+
+namespace memdb
+{
+
+    enum class PartitionKind
+    {
+        NONE,
+        HASH,
+        RANGE
+    };
+
+    // How the rows of a table are split between partitions,
+    // e.g. "partition by hash(login) into 8" or "partition by range(id) every 100000"
+    struct PartitionScheme
+    {
+        static constexpr int32_t DEFAULT_RANGE_WIDTH = 65536;
+
+        PartitionKind kind = PartitionKind::NONE;
+        std::string column;
+        size_t count = 0;                        // number of hash partitions
+        int32_t width = DEFAULT_RANGE_WIDTH;     // values per range partition
+
+        // Number of the range partition of the value, partition k holds [k * width, (k + 1) * width)
+        int64_t range_of(int64_t val) const
+        {
+            int64_t k = val / width;
+            return val % width < 0 ? k - 1 : k;
+        }
+
+        void save_to_file(std::ostream &out) const
+        {
+            write_int(out, (int)kind);
+            write_string(out, column);
+            write_int(out, count);
+            write_int(out, width);
+        }
+
+        static PartitionScheme load_from_file(std::istream &in)
+        {
+            PartitionScheme scheme;
+            scheme.kind = (PartitionKind)read_int<int>(in);
+            scheme.column = read_string(in);
+            scheme.count = read_int<size_t>(in);
+            scheme.width = read_int<int32_t>(in);
+            return scheme;
+        }
+    };
+
+    // Hash of the value used to choose its partition: FNV-1a with a finalizer mix,
+    // strings are hashed up to the terminator
+    inline uint64_t partition_hash(const Value &val)
+    {
+        size_t n = val.size;
+        if (val.type == Type::STRING)
+            n = std::find(val.val_ptr, val.val_ptr + val.size, 0) - val.val_ptr;
+        uint64_t h = 14695981039346656037ULL;
+        for (size_t i = 0; i < n; ++i)
+        {
+            h ^= val.val_ptr[i];
+            h *= 1099511628211ULL;
+        }
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdULL;
+        h ^= h >> 33;
+        return h;
+    }
+
+}
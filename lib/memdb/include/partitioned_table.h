@@ -0,0 +1,751 @@
+#pragma once
+
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <numeric>
+#include <thread>
+#include <chrono>
+#include <cstring>
+
+#include "base.h"
+#include "value.h"
+#include "column.h"
+#include "condition.h"
+#include "resultset.h"
+#include "utils.h"
+#include "ast.h"
+#include "aggregate.h"
+#include "partition.h"
+#include "querystats.h"
+#include "table.h"
+
+namespace memdb
+{
+
+    // Table split into partitions by the partitioning column, see PartitionScheme.
+    // Every partition is a Table with its own indices, zone maps and statistics.
+    // Selects are executed partition-wise: a condition on the partitioning column prunes
+    // the partitions which cannot contain matching rows, the remaining ones are scanned
+    // in parallel and their results are concatenated (aggregates are merged).
+    //
+    // Range partitions are created by the inserts as the values grow. When a partition above
+    // all others is created, the previous last one is compacted: it is not expected to grow.
+    // Old partitions may be frozen (no more inserts) or dropped as a whole.
+    class PartitionedTable
+    {
+        friend class Database;
+
+        // Partitions are scanned by separate threads if they have this many rows together
+        static constexpr size_t MIN_ROWS_PER_THREAD = 16384;
+
+        std::vector<Column> columns;
+        std::unordered_map<std::string, size_t> mapping; // column name to column index mapping
+        PartitionScheme scheme;
+        size_t part_col = 0; // index of the partitioning column
+        std::vector<Table *> partitions;
+        std::vector<int64_t> ranges; // range numbers of the partitions in ascending order (range partitioning)
+        std::vector<bool> frozen;    // partitions not accepting inserts
+        std::vector<std::string> indexed; // columns with ordered indices, also made in the new partitions
+        std::vector<std::string> trigram_indexed; // columns with trigram indices, also made in the new partitions
+        uint64_t version = 0; // incremented by every change of the rows
+
+        PartitionedTable(const std::vector<Column> &cols, const PartitionScheme &scheme) : columns(cols), scheme(scheme)
+        {
+            for (size_t i = 0; i < columns.size(); ++i)
+                mapping.insert(std::make_pair(columns[i].name, i));
+            if (mapping.count(scheme.column) == 0)
+                throw std::runtime_error("No column named \"" + scheme.column + "\" to partition by.");
+            part_col = mapping.at(scheme.column);
+            if (scheme.kind == PartitionKind::RANGE)
+            {
+                if (columns[part_col].type != Type::INT)
+                    throw std::runtime_error("Range partitioning is only allowed for numeric columns.");
+                if (scheme.width <= 0)
+                    throw std::runtime_error("The partition range must be positive.");
+                return; // partitions are created by the inserts
+            }
+            if (scheme.count == 0)
+                throw std::runtime_error("The number of partitions must be positive.");
+            for (size_t p = 0; p < scheme.count; ++p)
+            {
+                partitions.push_back(new Table(columns));
+                frozen.push_back(false);
+            }
+        }
+
+        PartitionedTable(const PartitionedTable &) = delete;
+        PartitionedTable &operator=(const PartitionedTable &) = delete;
+
+        ~PartitionedTable()
+        {
+            for (Table *partition : partitions)
+                delete partition;
+        }
+
+        size_t row_count() const
+        {
+            size_t n = 0;
+            for (const auto &partition : partitions)
+                n += partition->row_count;
+            return n;
+        }
+
+        // Inserts values into the partition of the partitioning column value.
+        // Autoincrement counters are shared by the partitions and unique values are checked in all of them.
+        ResultSet insert(const std::vector<Value> &values)
+        {
+            std::chrono::steady_clock::time_point t1 = std::chrono::steady_clock::now();
+            ResultSet rs;
+
+            try
+            {
+                if (values.size() != columns.size())
+                    throw std::runtime_error("Columns mismatch");
+
+                Value key = inserted_value(values, part_col);
+                if (key.type != columns[part_col].type)
+                    throw std::runtime_error("Type mismatch");
+                size_t p = partition_of(key);
+                Table *target = p < partitions.size() && (scheme.kind == PartitionKind::HASH || ranges[p] == range_of(key))
+                    ? partitions[p] : nullptr; // a range partition is created after the checks
+                if (target && frozen[p])
+                    throw std::runtime_error("Partition is frozen.");
+                for (size_t i = 0; i < columns.size(); ++i)
+                {
+                    if (columns[i].is_auto || !(columns[i].is_unique || columns[i].is_key) || i == part_col)
+                        continue;
+                    Value val = inserted_value(values, i);
+                    if (val.type != columns[i].type)
+                        continue; // reported by the partition
+                    for (const auto &partition : partitions)
+                    {
+                        if (partition != target && !partition->check_unique_value(val, i))
+                            throw std::runtime_error("Value is not unique");
+                    }
+                }
+
+                if (!target)
+                    target = add_range_partition(p, range_of(key));
+                for (size_t i = 0; i < columns.size(); ++i)
+                    target->columns[i].autoincrement_value = columns[i].autoincrement_value;
+                rs = target->insert(values);
+                if (rs.ok)
+                {
+                    version++;
+                    for (auto &column : columns)
+                    {
+                        if (column.is_auto)
+                            column.autoincrement_value++;
+                    }
+                }
+            }
+            catch (std::runtime_error &e)
+            {
+                rs.ok = false;
+                rs.error = e.what();
+            }
+
+            finish(rs, t1);
+            return rs;
+        }
+
+        // Selects all rows and all columns
+        ResultSet select_all()
+        {
+            std::vector<std::string> cols;
+            for (const auto &c : columns)
+                cols.push_back(c.name);
+            return select(cols, std::vector<std::pair<Condition, size_t>>());
+        }
+
+        // Selects specific columns by the given conditions
+        ResultSet select(const std::vector<std::string> &cols, std::vector<std::pair<Condition, size_t>> conditions)
+        {
+            std::chrono::steady_clock::time_point t1 = std::chrono::steady_clock::now();
+            ResultSet rs;
+
+            try
+            {
+                std::vector<std::pair<RelOp, Value>> part_conditions;
+                for (const auto &cond : conditions)
+                {
+                    if (cond.second == part_col && cond.first.that.type == columns[part_col].type)
+                        part_conditions.push_back(std::make_pair(cond.first.op, cond.first.that));
+                }
+                rs = concat(fan_out(prune(part_conditions), nullptr,
+                    [&cols, &conditions](Table &table, ASTNode *) { return table.select(cols, conditions); }));
+            }
+            catch (std::runtime_error &e)
+            {
+                rs.ok = false;
+                rs.error = e.what();
+            }
+
+            finish(rs, t1);
+            return rs;
+        }
+
+        // Select specific columns based on conditions
+        // given as Abstract Syntax Tree.
+        ResultSet select(const std::vector<std::string> &cols, ASTNode *ast)
+        {
+            std::chrono::steady_clock::time_point t1 = std::chrono::steady_clock::now();
+            ResultSet rs;
+
+            try
+            {
+                rs = concat(fan_out(prune(ast), ast, [&cols](Table &table, ASTNode *cond) { return table.select(cols, cond); }));
+            }
+            catch (std::runtime_error &e)
+            {
+                rs.ok = false;
+                rs.error = e.what();
+            }
+
+            finish(rs, t1);
+            return rs;
+        }
+
+        // Selects groups of rows matching the condition.
+        // Every partition aggregates its rows, the partial groups are merged by the group by columns.
+        // Partitions also return the group by columns missing in the column list and count(*),
+        // which tells the partitions without rows for min and max.
+        ResultSet select(const std::vector<std::string> &cols, const std::vector<Aggregate> &aggregates,
+                         const std::vector<std::string> &group_by, ASTNode *ast)
+        {
+            std::chrono::steady_clock::time_point t1 = std::chrono::steady_clock::now();
+            ResultSet rs;
+
+            try
+            {
+                std::vector<std::string> part_cols = cols;
+                std::vector<Aggregate> part_aggregates = aggregates;
+                for (const auto &name : group_by)
+                {
+                    if (std::find(part_cols.begin(), part_cols.end(), name) == part_cols.end())
+                        part_cols.push_back(name);
+                }
+                Aggregate count_all(AggFunc::COUNT, "*");
+                if (std::find(part_cols.begin(), part_cols.end(), count_all.name()) == part_cols.end())
+                {
+                    part_cols.push_back(count_all.name());
+                    part_aggregates.push_back(count_all);
+                }
+
+                std::vector<ResultSet> results = fan_out(prune(ast), ast,
+                    [&](Table &table, ASTNode *cond) { return table.select(part_cols, part_aggregates, group_by, cond, true); });
+                ResultSet merged = merge_groups(results, part_cols, part_aggregates, group_by);
+                rs = project(merged, cols);
+                rs.stats = merged.stats;
+            }
+            catch (std::runtime_error &e)
+            {
+                rs.ok = false;
+                rs.error = e.what();
+            }
+
+            finish(rs, t1);
+            return rs;
+        }
+
+        ResultSet create_ordered_index(const std::vector<std::string> &cols)
+        {
+            Table empty(columns); // checks the columns when there are no partitions yet
+            ResultSet rs = empty.create_ordered_index(cols);
+            for (size_t p = 0; p < partitions.size() && rs.ok; ++p)
+                rs = partitions[p]->create_ordered_index(cols);
+            if (rs.ok)
+                indexed.insert(indexed.end(), cols.begin(), cols.end());
+            return rs;
+        }
+
+        ResultSet create_trigram_index(const std::vector<std::string> &cols)
+        {
+            Table empty(columns);
+            ResultSet rs = empty.create_trigram_index(cols);
+            for (size_t p = 0; p < partitions.size() && rs.ok; ++p)
+                rs = partitions[p]->create_trigram_index(cols);
+            if (rs.ok)
+                trigram_indexed.insert(trigram_indexed.end(), cols.begin(), cols.end());
+            return rs;
+        }
+
+        // Partitions which may contain rows matching the condition given as Abstract Syntax Tree
+        std::vector<size_t> prune(ASTNode *ast) const
+        {
+            // Terms of the conjunction comparing the partitioning column with a literal
+            std::vector<std::pair<RelOp, Value>> conditions;
+            for (ASTNode *term : get_and_terms(ast))
+            {
+                InternalNode *node = as_internal(term);
+                if (!node || !is_rel_op(node->op))
+                    continue;
+                LeafNode *left = as_leaf(node->left);
+                LeafNode *right = as_leaf(node->right);
+                if (!left || !right)
+                    continue;
+                const Column &column = columns[part_col];
+                if (left->id == column.name && right->id.empty() && right->value.type == column.type)
+                    conditions.push_back(std::make_pair(op_to_relop(node->op), right->value));
+                else if (right->id == column.name && left->id.empty() && left->value.type == column.type)
+                    conditions.push_back(std::make_pair(mirror(op_to_relop(node->op)), left->value));
+            }
+            return prune(conditions);
+        }
+
+        // Partitions which may contain rows matching all the conditions on the partitioning column:
+        // an equality leaves one hash partition, the bounds leave the range partitions between them
+        std::vector<size_t> prune(const std::vector<std::pair<RelOp, Value>> &conditions) const
+        {
+            if (scheme.kind == PartitionKind::HASH)
+            {
+                for (const auto &cond : conditions)
+                {
+                    if (cond.first == RelOp::EQ)
+                        return { partition_of(cond.second) };
+                }
+                return all_partitions();
+            }
+
+            int64_t lo = INT64_MIN, hi = INT64_MAX;
+            for (const auto &cond : conditions)
+            {
+                int64_t val = cond.second.get<int>();
+                switch (cond.first)
+                {
+                case RelOp::EQ:
+                    lo = std::max(lo, val);
+                    hi = std::min(hi, val);
+                    break;
+                case RelOp::LT:
+                    hi = std::min(hi, val - 1);
+                    break;
+                case RelOp::LE:
+                    hi = std::min(hi, val);
+                    break;
+                case RelOp::GT:
+                    lo = std::max(lo, val + 1);
+                    break;
+                case RelOp::GE:
+                    lo = std::max(lo, val);
+                    break;
+                default:
+                    break;
+                }
+            }
+            std::vector<size_t> parts;
+            if (lo > hi)
+                return parts;
+            int64_t first = lo == INT64_MIN ? INT64_MIN : scheme.range_of(lo);
+            int64_t last = hi == INT64_MAX ? INT64_MAX : scheme.range_of(hi);
+            for (size_t p = std::lower_bound(ranges.begin(), ranges.end(), first) - ranges.begin();
+                 p < ranges.size() && ranges[p] <= last; ++p)
+            {
+                parts.push_back(p);
+            }
+            return parts;
+        }
+
+        // Drops the range partitions holding only values below the bound, returns the number of dropped rows
+        size_t drop_partitions(int32_t before)
+        {
+            size_t n = count_partitions_before(before);
+            size_t rows = 0;
+            for (size_t p = 0; p < n; ++p)
+            {
+                rows += partitions[p]->row_count;
+                delete partitions[p];
+            }
+            partitions.erase(partitions.begin(), partitions.begin() + n);
+            ranges.erase(ranges.begin(), ranges.begin() + n);
+            frozen.erase(frozen.begin(), frozen.begin() + n);
+            if (n > 0)
+                version++;
+            return rows;
+        }
+
+        // Compacts the range partitions holding only values below the bound and rejects further inserts into them,
+        // returns the number of frozen partitions
+        size_t freeze_partitions(int32_t before)
+        {
+            size_t n = count_partitions_before(before);
+            for (size_t p = 0; p < n; ++p)
+            {
+                partitions[p]->compact();
+                frozen[p] = true;
+            }
+            return n;
+        }
+
+        void save_to_file(std::ostream &out) const
+        {
+            scheme.save_to_file(out);
+            // Columns keep the autoincrement counters
+            write_int(out, columns.size());
+            for (const auto &c : columns)
+            {
+                c.save_to_file(out);
+            }
+            write_int(out, indexed.size());
+            for (const auto &col : indexed)
+            {
+                write_string(out, col);
+            }
+            write_int(out, trigram_indexed.size());
+            for (const auto &col : trigram_indexed)
+            {
+                write_string(out, col);
+            }
+            write_int(out, partitions.size());
+            for (size_t p = 0; p < partitions.size(); ++p)
+            {
+                write_int(out, scheme.kind == PartitionKind::RANGE ? ranges[p] : 0);
+                write_int(out, (bool)frozen[p]);
+                partitions[p]->save_to_file(out);
+            }
+        }
+
+        static PartitionedTable *load_from_file(std::istream &in)
+        {
+            PartitionScheme scheme = PartitionScheme::load_from_file(in);
+            size_t num_cols = read_int<size_t>(in);
+            std::vector<Column> columns;
+            columns.reserve(num_cols);
+            for (size_t i = 0; i < num_cols; ++i)
+            {
+                columns.push_back(Column::load_from_file(in));
+            }
+
+            PartitionedTable *table = new PartitionedTable(columns, scheme);
+            for (Table *partition : table->partitions)
+                delete partition;
+            table->partitions.clear();
+            table->frozen.clear();
+
+            size_t num_indexed = read_int<size_t>(in);
+            for (size_t i = 0; i < num_indexed; ++i)
+            {
+                table->indexed.push_back(read_string(in));
+            }
+            size_t num_trigram_indexed = read_int<size_t>(in);
+            for (size_t i = 0; i < num_trigram_indexed; ++i)
+            {
+                table->trigram_indexed.push_back(read_string(in));
+            }
+            size_t num_partitions = read_int<size_t>(in);
+            for (size_t p = 0; p < num_partitions; ++p)
+            {
+                int64_t range = read_int<int64_t>(in);
+                if (scheme.kind == PartitionKind::RANGE)
+                    table->ranges.push_back(range);
+                table->frozen.push_back(read_int<bool>(in));
+                table->partitions.push_back(Table::load_from_file(in));
+            }
+            return table;
+        }
+
+    private:
+        // Partition of the value: for range partitioning the position of its range among the partitions,
+        // which is where it has to be created if it is not there
+        size_t partition_of(const Value &val) const
+        {
+            if (scheme.kind == PartitionKind::RANGE)
+                return std::lower_bound(ranges.begin(), ranges.end(), range_of(val)) - ranges.begin();
+            return (size_t)(partition_hash(val) % partitions.size());
+        }
+
+        int64_t range_of(const Value &val) const
+        {
+            return scheme.range_of(val.get<int>());
+        }
+
+        // Creates the partition of the range at the position, compacting the previous last partition
+        // if the new one is above all others
+        Table *add_range_partition(size_t p, int64_t range)
+        {
+            Table *table = new Table(columns);
+            for (const auto &col : indexed)
+            {
+                if (!table->has_ordered_index(table->mapping.at(col)))
+                    table->create_ordered_index(table->mapping.at(col));
+            }
+            for (const auto &col : trigram_indexed)
+                table->create_trigram_index(table->mapping.at(col));
+            if (p == partitions.size() && p > 0)
+                partitions.back()->compact();
+            partitions.insert(partitions.begin() + p, table);
+            ranges.insert(ranges.begin() + p, range);
+            frozen.insert(frozen.begin() + p, false);
+            return table;
+        }
+
+        size_t count_partitions_before(int32_t before) const
+        {
+            if (scheme.kind != PartitionKind::RANGE)
+                throw std::runtime_error("The table is not partitioned by range.");
+            size_t n = 0;
+            while (n < ranges.size() && (ranges[n] + 1) * scheme.width <= before)
+                ++n;
+            return n;
+        }
+
+        std::vector<size_t> all_partitions() const
+        {
+            std::vector<size_t> parts(partitions.size());
+            std::iota(parts.begin(), parts.end(), 0);
+            return parts;
+        }
+
+        // Value the partition will store in the column: the autoincrement or the default one if not given
+        Value inserted_value(const std::vector<Value> &values, size_t col) const
+        {
+            if (columns[col].is_auto)
+                return Value(columns[col].autoincrement_value);
+            if (values[col].type == Type::NONE && columns[col].has_default)
+                return columns[col].def_value;
+            return values[col];
+        }
+
+        // Runs the select on the partitions, in parallel if they are large enough.
+        // Filtering writes the row values into the tree, so every partition gets its own copy.
+        // Without partitions to scan the select runs on an empty table to get the columns of the result.
+        template <typename Select>
+        std::vector<ResultSet> fan_out(const std::vector<size_t> &parts, ASTNode *ast, Select select)
+        {
+            if (parts.empty())
+            {
+                Table empty(columns);
+                ASTArena arena;
+                return { check(select(empty, clone(ast, arena))) };
+            }
+
+            std::vector<ResultSet> results(parts.size());
+            size_t rows = 0;
+            for (size_t p : parts)
+                rows += partitions[p]->row_count;
+            size_t num_threads = rows < MIN_ROWS_PER_THREAD ? 1
+                : std::min<size_t>(parts.size(), std::max(1u, std::thread::hardware_concurrency()));
+            auto work = [&](size_t t)
+            {
+                for (size_t i = t; i < parts.size(); i += num_threads)
+                {
+                    ASTArena arena;
+                    results[i] = select(*partitions[parts[i]], clone(ast, arena));
+                }
+            };
+
+            if (num_threads == 1)
+            {
+                work(0);
+            }
+            else
+            {
+                std::vector<std::thread> threads;
+                for (size_t t = 0; t < num_threads; ++t)
+                {
+                    threads.emplace_back(work, t);
+                }
+                for (auto &thread : threads)
+                {
+                    thread.join();
+                }
+            }
+
+            for (const auto &rs : results)
+                check(rs);
+            return results;
+        }
+
+        static const ResultSet &check(const ResultSet &rs)
+        {
+            if (!rs.ok)
+                throw std::runtime_error(rs.error);
+            return rs;
+        }
+
+        // Concatenates the rows of the results with the same columns
+        static ResultSet concat(const std::vector<ResultSet> &results)
+        {
+            ResultSet rs;
+            const ResultSet &first = results.front();
+            for (const auto &column : first.layout)
+                rs.add_column(column);
+            for (const auto &part : results)
+            {
+                rs.row_count += part.row_count;
+                rs.stats += part.stats;
+            }
+
+            rs.storage.reset(new uint8_t[rs.row_size * rs.row_count]);
+            rs.stats.allocations++;
+            rs.stats.bytes_copied += (size_t)rs.row_size * rs.row_count;
+            uint8_t *dst = rs.storage.get();
+            for (const auto &part : results)
+            {
+                size_t size = (size_t)part.row_size * part.row_count;
+                if (size > 0)
+                    std::memcpy(dst, part.storage.get(), size);
+                dst += size;
+            }
+            return rs;
+        }
+
+        // Merges the partial groups of the partitions with equal group by values
+        static ResultSet merge_groups(const std::vector<ResultSet> &results, const std::vector<std::string> &cols,
+                                      const std::vector<Aggregate> &aggregates, const std::vector<std::string> &group_by)
+        {
+            const ResultSet &first = results.front();
+            std::vector<const Column *> keys;
+            for (const auto &name : group_by)
+                keys.push_back(&first.mapping.at(name));
+            std::vector<std::pair<const Column *, AggFunc>> accs;
+            for (size_t i = 0; i < cols.size(); ++i)
+            {
+                auto agg_it = std::find_if(aggregates.begin(), aggregates.end(), [&](const Aggregate &a) { return a.name() == cols[i]; });
+                if (agg_it != aggregates.end())
+                    accs.push_back(std::make_pair(&first.layout[i], agg_it->func));
+            }
+            const Column &count = first.mapping.at(Aggregate(AggFunc::COUNT, "*").name());
+            auto count_at = [&count](const uint8_t *row) { return *((const int32_t *)(row + count.offset)); };
+
+            ResultSet rs;
+            for (const auto &column : first.layout)
+                rs.add_column(column);
+            std::vector<uint8_t> rows;
+            std::unordered_map<std::string, size_t> groups; // group by values to the merged row
+            for (const auto &part : results)
+            {
+                rs.stats += part.stats;
+                for (size_t r = 0; r < part.row_count; ++r)
+                {
+                    const uint8_t *row = part.storage.get() + r * part.row_size;
+                    // strings are compared up to the terminator, the bytes after it are arbitrary
+                    std::string key;
+                    for (const Column *column : keys)
+                    {
+                        const char *p = (const char *)row + column->offset;
+                        if (column->type == Type::STRING && !column->is_dict)
+                        {
+                            size_t n = strnlen(p, column->size);
+                            key.append(p, n);
+                            key.append(column->size - n, '\0');
+                        }
+                        else
+                            key.append(p, column->width());
+                    }
+
+                    auto it = groups.find(key);
+                    if (it == groups.end())
+                    {
+                        groups.insert(std::make_pair(key, rs.row_count++));
+                        rows.insert(rows.end(), row, row + part.row_size);
+                        continue;
+                    }
+                    uint8_t *merged = rows.data() + it->second * rs.row_size;
+                    if (count_at(row) == 0)
+                        continue;
+                    if (count_at(merged) == 0)
+                    {
+                        std::memcpy(merged, row, rs.row_size);
+                        continue;
+                    }
+                    for (const auto &acc : accs)
+                    {
+                        const Column &column = *acc.first;
+                        uint8_t *dst = merged + column.offset;
+                        const uint8_t *src = row + column.offset;
+                        if (acc.second == AggFunc::SUM)
+                        {
+                            int64_t sum, partial;
+                            std::memcpy(&sum, dst, sizeof(sum));
+                            std::memcpy(&partial, src, sizeof(partial));
+                            sum += partial;
+                            std::memcpy(dst, &sum, sizeof(sum));
+                            continue;
+                        }
+                        if (acc.second == AggFunc::COUNT)
+                        {
+                            *((int32_t *)dst) += *((const int32_t *)src);
+                            continue;
+                        }
+                        Value current(column.type, dst, column.size);
+                        Value candidate(column.type, (uint8_t *)src, column.size);
+                        if (acc.second == AggFunc::MIN ? candidate < current : candidate > current)
+                            std::memcpy(dst, src, column.width());
+                    }
+                }
+            }
+
+            rs.storage.reset(new uint8_t[rows.size()]);
+            std::copy(rows.begin(), rows.end(), rs.storage.get());
+            return finish_sums(rs, accs);
+        }
+
+        // Replaces the int64 partial sums with int32 columns, the range is checked on the final sums only
+        static ResultSet finish_sums(const ResultSet &from, const std::vector<std::pair<const Column *, AggFunc>> &accs)
+        {
+            ResultSet rs;
+            rs.stats = from.stats;
+            for (const auto &column : from.layout)
+            {
+                bool is_sum = std::any_of(accs.begin(), accs.end(), [&](const std::pair<const Column *, AggFunc> &acc)
+                                          { return acc.second == AggFunc::SUM && acc.first->name == column.name; });
+                rs.add_column(is_sum ? Column(Type::INT, column.name) : column);
+            }
+            rs.row_count = from.row_count;
+            rs.storage.reset(new uint8_t[rs.row_size * rs.row_count]);
+            for (size_t r = 0; r < rs.row_count; ++r)
+            {
+                const uint8_t *src = from.storage.get() + r * from.row_size;
+                uint8_t *dst = rs.storage.get() + r * rs.row_size;
+                for (size_t i = 0; i < from.layout.size(); ++i)
+                {
+                    const Column &column = from.layout[i];
+                    if (rs.layout[i].type != Type::INT || column.type == Type::INT)
+                    {
+                        std::memcpy(dst + rs.layout[i].offset, src + column.offset, column.width());
+                        continue;
+                    }
+                    int64_t sum;
+                    std::memcpy(&sum, src + column.offset, sizeof(sum));
+                    if (sum < INT32_MIN || sum > INT32_MAX)
+                        throw std::runtime_error("Integer overflow in " + column.name + ".");
+                    *((int32_t *)(dst + rs.layout[i].offset)) = (int32_t)sum;
+                }
+            }
+            return rs;
+        }
+
+        // Copies the given columns of the result
+        static ResultSet project(const ResultSet &from, const std::vector<std::string> &cols)
+        {
+            ResultSet rs;
+            for (const auto &name : cols)
+                rs.add_column(from.mapping.at(name));
+            rs.row_count = from.row_count;
+            rs.storage.reset(new uint8_t[rs.row_size * rs.row_count]);
+            for (size_t r = 0; r < rs.row_count; ++r)
+            {
+                const uint8_t *src = from.storage.get() + r * from.row_size;
+                uint8_t *dst = rs.storage.get() + r * rs.row_size;
+                for (size_t i = 0; i < cols.size(); ++i)
+                {
+                    const Column &column = from.mapping.at(cols[i]);
+                    std::memcpy(dst + rs.layout[i].offset, src + column.offset, column.width());
+                }
+            }
+            return rs;
+        }
+
+        static void finish(ResultSet &rs, std::chrono::steady_clock::time_point t1)
+        {
+            std::chrono::steady_clock::time_point t2 = std::chrono::steady_clock::now();
+            rs.time_ms = std::chrono::duration_cast<std::chrono::milliseconds>(t2 - t1).count();
+            rs.stats.total_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(t2 - t1).count();
+        }
+    };
+
+}
@@ -0,0 +1,198 @@
+#pragma once
+
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstring>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "base.h"
+#include "value.h"
+
+namespace memdb
+{
+
+    // Finds the first occurrence of the needle in the haystack, returns n if there is none.
+    // With SSE2 16 positions are checked at once by comparing the first and the last
+    // character of the needle, the whole needle is compared only where both match.
+    inline size_t find_substring(const char *hay, size_t n, const char *needle, size_t m)
+    {
+        if (m == 0)
+            return 0;
+        if (m > n)
+            return n;
+        size_t i = 0;
+#ifdef __SSE2__
+        const __m128i first = _mm_set1_epi8(needle[0]);
+        const __m128i last = _mm_set1_epi8(needle[m - 1]);
+        for (; i + m - 1 + 16 <= n; i += 16)
+        {
+            __m128i block_first = _mm_loadu_si128((const __m128i *)(hay + i));
+            __m128i block_last = _mm_loadu_si128((const __m128i *)(hay + i + m - 1));
+            unsigned mask = (unsigned)_mm_movemask_epi8(
+                _mm_and_si128(_mm_cmpeq_epi8(first, block_first), _mm_cmpeq_epi8(last, block_last)));
+            while (mask != 0)
+            {
+                size_t pos = i + __builtin_ctz(mask);
+                if (std::memcmp(hay + pos, needle, m) == 0)
+                    return pos;
+                mask &= mask - 1;
+            }
+        }
+#endif
+        for (; i + m <= n; ++i)
+        {
+            if (hay[i] == needle[0] && std::memcmp(hay + i, needle, m) == 0)
+                return i;
+        }
+        return n;
+    }
+
+    // Pattern of the like operator: % matches any sequence of characters, _ matches one character
+    // (one byte). The pattern is split by % into parts: the first one must match at the start,
+    // the last one at the end and the others are searched for from left to right.
+    class LikePattern
+    {
+        std::vector<std::string> parts;
+        bool wildcards = true; // false for starts_with, where _ is an ordinary character
+
+    public:
+        explicit LikePattern(std::string_view pattern)
+        {
+            size_t begin = 0;
+            for (size_t i = 0; i <= pattern.size(); ++i)
+            {
+                if (i == pattern.size() || pattern[i] == '%')
+                {
+                    parts.push_back(std::string(pattern.substr(begin, i - begin)));
+                    begin = i + 1;
+                }
+            }
+        }
+
+        // Pattern of starts_with: the prefix followed by %
+        static LikePattern prefix(std::string_view prefix)
+        {
+            LikePattern pattern("");
+            pattern.parts = { std::string(prefix), "" };
+            pattern.wildcards = false;
+            return pattern;
+        }
+
+        bool match(const char *s, size_t n) const
+        {
+            const std::string &first = parts.front();
+            if (parts.size() == 1)
+                return n == first.size() && match_at(s, first);
+            if (n < first.size() || !match_at(s, first))
+                return false;
+            const std::string &last = parts.back();
+            if (n - first.size() < last.size() || !match_at(s + n - last.size(), last))
+                return false;
+
+            size_t pos = first.size();
+            size_t end = n - last.size();
+            for (size_t i = 1; i + 1 < parts.size(); ++i)
+            {
+                size_t found = find(s + pos, end - pos, parts[i]);
+                if (found == end - pos)
+                    return false;
+                pos += found + parts[i].size();
+            }
+            return true;
+        }
+
+        // Matches the string value stored in a fixed-width slot (zero-terminated)
+        bool match(const Value &val) const
+        {
+            if (val.type != Type::STRING)
+                throw std::runtime_error("Operations like and starts_with are only allowed for strings.");
+            const char *s = (const char *)val.val_ptr;
+            return match(s, strnlen(s, val.size));
+        }
+
+        // Characters every matching string starts with
+        std::string get_prefix() const
+        {
+            const std::string &first = parts.front();
+            return wildcards ? first.substr(0, std::min(first.find('_'), first.size())) : first;
+        }
+
+        // Runs of ordinary characters every matching string contains
+        std::vector<std::string> get_literals() const
+        {
+            if (!wildcards)
+                return parts;
+            std::vector<std::string> literals;
+            for (const auto &part : parts)
+            {
+                size_t begin = 0;
+                for (size_t i = 0; i <= part.size(); ++i)
+                {
+                    if (i == part.size() || part[i] == '_')
+                    {
+                        if (i > begin)
+                            literals.push_back(part.substr(begin, i - begin));
+                        begin = i + 1;
+                    }
+                }
+            }
+            return literals;
+        }
+
+        // Whether the pattern only requires the prefix: "abc%"
+        bool is_prefix() const
+        {
+            return parts.size() == 2 && parts.back().empty() && (!wildcards || parts.front().find('_') == std::string::npos);
+        }
+
+        // Smallest string greater than all the strings starting with the prefix,
+        // empty if there is none (the prefix consists of '\xff')
+        static std::string prefix_successor(std::string prefix)
+        {
+            while (!prefix.empty() && (uint8_t)prefix.back() == 0xff)
+                prefix.pop_back();
+            if (!prefix.empty())
+                prefix.back() = (char)((uint8_t)prefix.back() + 1);
+            return prefix;
+        }
+
+    private:
+        bool match_at(const char *s, const std::string &part) const
+        {
+            for (size_t i = 0; i < part.size(); ++i)
+            {
+                if ((part[i] != '_' || !wildcards) && part[i] != s[i])
+                    return false;
+            }
+            return true;
+        }
+
+        // Position of the first match of the part, n if there is none
+        size_t find(const char *s, size_t n, const std::string &part) const
+        {
+            if (!wildcards || part.find('_') == std::string::npos)
+                return find_substring(s, n, part.data(), part.size());
+            for (size_t i = 0; i + part.size() <= n; ++i)
+            {
+                if (match_at(s + i, part))
+                    return i;
+            }
+            return n;
+        }
+    };
+
+    // Evaluates s like pattern or s starts_with prefix for string values
+    inline bool like(const Value &s, const Value &pattern, RelOp op)
+    {
+        if (pattern.type != Type::STRING)
+            throw std::runtime_error("Operations like and starts_with are only allowed for strings.");
+        std::string p = pattern.get<std::string>();
+        return (op == RelOp::STARTS_WITH ? LikePattern::prefix(p) : LikePattern(p)).match(s);
+    }
+
+}
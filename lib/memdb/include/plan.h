@@ -0,0 +1,323 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <utility>
+#include <unordered_map>
+#include <algorithm>
+
+#include "base.h"
+#include "bytes.h"
+#include "value.h"
+#include "condition.h"
+#include "ast.h"
+#include "index.h"
+#include "trigram.h"
+#include "utils.h"
+
+namespace memdb
+{
+
+    enum class AccessPath
+    {
+        NONE, // the condition is always false
+        FULL_SCAN,
+        INDEX_RANGE,
+        INDEX_INTERSECTION, // rows in the ranges of several indices
+        INDEX_UNION,        // rows of the conjunctions of a disjunction, each found by its own plan
+        TRIGRAM             // rows having all the trigrams of a pattern
+    };
+
+    // Range of an ordered index found by the conditions on its column
+    struct IndexScan
+    {
+        const OrderedIndex *index = nullptr;
+        std::vector<size_t> conditions; // positions in QueryPlan::conditions
+        double rows = 0;                // estimated rows in the range
+        double probes = 0;              // steps of binary search
+    };
+
+    // Estimated cost of checking a condition on a row and fraction of the rows passing it
+    struct CheckEstimate
+    {
+        double cost = 1;
+        double selectivity = 1;
+    };
+
+    // Plan of a select, chosen by the estimated cost
+    struct QueryPlan
+    {
+        // Cost of reading a row by a sequential scan, a row by its index
+        // (random access) and one step of binary search in an index
+        static constexpr double SCAN_ROW_COST = 1.0;
+        static constexpr double INDEX_ROW_COST = 4.0;
+        static constexpr double PROBE_COST = 4.0;
+        // Cost of adding a row of an index range to a row bitmap (sequential read of the index)
+        static constexpr double BITMAP_ROW_COST = 0.5;
+        // Largest disjunctive normal form of a condition planned as a union
+        static constexpr size_t MAX_DISJUNCTS = 8;
+        // Cost of checking a condition on a row: an int32 or bool value (or a dictionary code),
+        // a string or bytes value, a like or starts_with pattern
+        static constexpr double FIXED_CHECK_COST = 1.0;
+        static constexpr double STRING_CHECK_COST = 3.0;
+        static constexpr double PATTERN_CHECK_COST = 8.0;
+
+        AccessPath path = AccessPath::FULL_SCAN;
+        std::vector<std::pair<Condition, size_t>> conditions; // simple conditions joined by "and" (condition, column)
+        ASTNode *filter = nullptr;                            // condition which is not simple, evaluated for every row
+        const OrderedIndex *index = nullptr;
+        std::vector<size_t> index_conditions; // conditions used to find the index range
+        std::vector<IndexScan> scans;         // ranges intersected by row bitmaps
+        std::vector<QueryPlan> branches;      // plans of the conjunctions of a union
+        const TrigramIndex *trigram_index = nullptr;
+        std::vector<uint32_t> trigrams;       // trigrams of the pattern looked up in the trigram index
+        std::vector<CheckEstimate> checks;    // estimates of the conditions ordering the checks of the rows
+        double estimated_rows = 0;            // rows to be checked
+        double cost = 0;
+    };
+
+    // Order of checking the conditions of a row: the conditions rejecting the most rows per unit
+    // of cost go first, i.e. ascending cost / (1 - selectivity). The order starts from the estimates;
+    // during a long scan it is reranked every ADAPT_ROWS rows by the observed pass rates, which
+    // also take into account the correlation of the conditions (a condition is only checked
+    // on the rows passed by the previous ones).
+    class CheckOrder
+    {
+        std::vector<CheckEstimate> estimates;
+        std::vector<size_t> order;
+        std::vector<double> checked;
+        std::vector<double> passed;
+        size_t rows = 0;
+
+    public:
+        static constexpr size_t ADAPT_ROWS = 1024;
+        static constexpr double PRIOR_ROWS = 64; // weight of the estimate against the observed rows
+
+        explicit CheckOrder(const std::vector<CheckEstimate> &estimates)
+            : estimates(estimates), checked(estimates.size(), 0), passed(estimates.size(), 0)
+        {
+            for (size_t c = 0; c < estimates.size(); ++c)
+                order.push_back(c);
+            std::vector<double> selectivities;
+            for (const auto &e : estimates)
+                selectivities.push_back(e.selectivity);
+            rank(selectivities);
+        }
+
+        const std::vector<size_t> &get() const { return order; }
+
+        void record(size_t c, bool pass)
+        {
+            checked[c] += 1;
+            if (pass)
+                passed[c] += 1;
+        }
+
+        // Called after every row, reranks the conditions from time to time
+        void next_row()
+        {
+            if (++rows < ADAPT_ROWS || order.size() < 2)
+                return;
+            rows = 0;
+            std::vector<double> selectivities;
+            for (size_t c = 0; c < estimates.size(); ++c)
+            {
+                selectivities.push_back((passed[c] + estimates[c].selectivity * PRIOR_ROWS) / (checked[c] + PRIOR_ROWS));
+                // older rows weigh less, so the order follows the changes of the data
+                checked[c] /= 2;
+                passed[c] /= 2;
+            }
+            rank(selectivities);
+        }
+
+    private:
+        void rank(const std::vector<double> &selectivities)
+        {
+            auto score = [&](size_t c) { return estimates[c].cost / std::max(1.0 - selectivities[c], 1e-3); };
+            std::stable_sort(order.begin(), order.end(), [&](size_t x, size_t y) { return score(x) < score(y); });
+        }
+    };
+
+    // Converts the terms of the simple form x < 1 && y > 2 && z && ... (see is_expr_simple)
+    // to conditions on the columns. Returns false if the conjunction is always false.
+    // literals receives the literal leaf of every condition (nullptr for a boolean column alone).
+    inline bool to_conditions(const std::vector<ASTNode *> &terms, const std::unordered_map<std::string, size_t> &mapping,
+        std::vector<std::pair<Condition, size_t>> &conditions, std::vector<LeafNode *> *literals = nullptr)
+    {
+        bool select_nothing = false;
+        for (auto &term : terms)
+        {
+            InternalNode *internal_node = as_internal(term);
+            if (!internal_node)
+            {
+                LeafNode *leaf = as_leaf(term);
+                if (!leaf->id.empty())
+                {
+                    size_t col = mapping.at(leaf->id);
+                    Condition cond(Value(true), RelOp::EQ);
+                    conditions.push_back(std::make_pair(cond, col));
+                    if (literals)
+                        literals->push_back(nullptr);
+                }
+                else if (!leaf->value.get<bool>())
+                {
+                    select_nothing = true;
+                }
+            }
+            else
+            {
+                LeafNode *left = as_leaf(internal_node->left);
+                LeafNode *right = as_leaf(internal_node->right);
+                if (!left->id.empty())
+                {
+                    size_t col = mapping.at(left->id);
+                    Condition cond(right->value, op_to_relop(internal_node->op));
+                    conditions.push_back(std::make_pair(cond, col));
+                    if (literals)
+                        literals->push_back(right);
+                }
+                else
+                {
+                    size_t col = mapping.at(right->id);
+                    Condition cond(left->value, mirror(op_to_relop(internal_node->op)));
+                    conditions.push_back(std::make_pair(cond, col));
+                    if (literals)
+                        literals->push_back(left);
+                }
+            }
+        }
+        return !select_nothing;
+    }
+
+    inline bool to_conditions(ASTNode *ast, const std::unordered_map<std::string, size_t> &mapping,
+        std::vector<std::pair<Condition, size_t>> &conditions, std::vector<LeafNode *> *literals = nullptr)
+    {
+        return to_conditions(get_and_terms(ast), mapping, conditions, literals);
+    }
+
+    inline std::string to_string(AccessPath path)
+    {
+        switch (path)
+        {
+        case AccessPath::NONE:
+            return "none";
+        case AccessPath::FULL_SCAN:
+            return "full scan";
+        case AccessPath::INDEX_RANGE:
+            return "index range";
+        case AccessPath::INDEX_INTERSECTION:
+            return "index intersection";
+        case AccessPath::INDEX_UNION:
+            return "index union";
+        case AccessPath::TRIGRAM:
+            return "trigram index";
+        }
+        return "";
+    }
+
+    inline std::string to_string(Op op)
+    {
+        switch (op)
+        {
+        case Op::PLS:
+            return "+";
+        case Op::MNS:
+            return "-";
+        case Op::MUL:
+            return "*";
+        case Op::DIV:
+            return "/";
+        case Op::MOD:
+            return "%";
+        case Op::EQ:
+            return "=";
+        case Op::NE:
+            return "!=";
+        case Op::LT:
+            return "<";
+        case Op::GT:
+            return ">";
+        case Op::LE:
+            return "<=";
+        case Op::GE:
+            return ">=";
+        case Op::LIKE:
+            return "like";
+        case Op::STARTS_WITH:
+            return "starts_with";
+        case Op::AND:
+            return "&&";
+        case Op::OR:
+            return "||";
+        case Op::XOR:
+            return "^^";
+        case Op::NOT:
+            return "!";
+        }
+        return "";
+    }
+
+    inline std::string to_string(RelOp op)
+    {
+        switch (op)
+        {
+        case RelOp::EQ:
+            return "=";
+        case RelOp::NE:
+            return "!=";
+        case RelOp::LT:
+            return "<";
+        case RelOp::GT:
+            return ">";
+        case RelOp::LE:
+            return "<=";
+        case RelOp::GE:
+            return ">=";
+        case RelOp::LIKE:
+            return "like";
+        case RelOp::STARTS_WITH:
+            return "starts_with";
+        }
+        return "";
+    }
+
+    // Value as a literal of the query language
+    inline std::string to_string(const Value &val)
+    {
+        switch (val.type)
+        {
+        case Type::INT:
+            return std::to_string(val.get<int32_t>());
+        case Type::BOOL:
+            return val.get<bool>() ? "true" : "false";
+        case Type::STRING:
+            return "\"" + val.get<std::string>() + "\"";
+        case Type::BYTES:
+            return to_string(val.get<Bytes>());
+        default:
+            return "";
+        }
+    }
+
+    // Expression in the query language
+    inline std::string to_string(ASTNode *node)
+    {
+        switch (node->kind)
+        {
+        case NodeKind::INTERNAL:
+        {
+            InternalNode *internal_node = static_cast<InternalNode *>(node);
+            if (internal_node->op == Op::NOT)
+                return "!" + to_string(internal_node->left);
+            return "(" + to_string(internal_node->left) + " " + to_string(internal_node->op) + " " + to_string(internal_node->right) + ")";
+        }
+        case NodeKind::LEAF:
+        {
+            LeafNode *leaf = static_cast<LeafNode *>(node);
+            return leaf->id.empty() ? to_string(leaf->value) : leaf->id;
+        }
+        }
+        return "";
+    }
+
+}
@@ -0,0 +1,244 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <list>
+#include <unordered_map>
+#include <unordered_set>
+#include <memory>
+#include <mutex>
+
+#include "base.h"
+#include "column.h"
+#include "lexem.h"
+#include "ast.h"
+#include "visitor.h"
+#include "parser.h"
+#include "plan.h"
+#include "utils.h"
+
+namespace memdb
+{
+
+    // Select parsed and simplified once for all the queries differing only in literals.
+    // The literals of a query are put into the places of the literals of the first one.
+    struct PlanTemplate
+    {
+        SelectDef def;                   // the first query of the form
+        std::vector<int> literal_slots;  // lexem positions of the literal leaves of def.ast in pre-order, -1 for the others
+        bool reusable = false;           // every literal of the query is still a leaf after simplifying
+
+        // Conjunction of simple terms (see is_condition_simple) without aggregates
+        // is kept as conditions on the columns, which need no more checks
+        bool simple = false;
+        std::vector<std::pair<Condition, size_t>> conditions;
+        std::vector<int> condition_slots; // lexem positions of the literals of the conditions, -1 for the others
+
+        // Makes the template of the parsed query on a table with the columns
+        static std::shared_ptr<PlanTemplate> make(const SelectDef &def, const std::vector<Column> &columns)
+        {
+            auto t = std::make_shared<PlanTemplate>();
+            t->def = def;
+
+            // Folding constants (x < 2 + 3) replaces the literals by new leaves,
+            // the result depends on their values and is not reused
+            std::unordered_map<const LeafNode *, size_t> positions;
+            for (const auto &literal : def.literals)
+                positions.insert(std::make_pair(literal.first, literal.second));
+            std::vector<LeafNode *> leaves;
+            collect_literals(def.ast, leaves);
+            size_t found = 0;
+            for (LeafNode *leaf : leaves)
+            {
+                auto it = positions.find(leaf);
+                t->literal_slots.push_back(it == positions.end() ? -1 : (int)it->second);
+                if (it != positions.end())
+                    found++;
+            }
+            t->reusable = found == positions.size();
+            if (!t->reusable || !def.aggregates.empty() || !def.group_by.empty())
+                return t;
+
+            std::unordered_map<std::string, size_t> mapping;
+            for (size_t i = 0; i < columns.size(); ++i)
+                mapping.insert(std::make_pair(columns[i].name, i));
+            for (const auto &col : def.columns)
+            {
+                if (mapping.count(col) == 0)
+                    return t; // the select reports the error
+            }
+            SymbolVisitor visitor;
+            for (const auto &item : visitor.visit(def.ast))
+            {
+                if (mapping.count(item.first) == 0)
+                    return t;
+            }
+            if (!is_cond_index_friendly(def.ast) || !is_condition_simple(def.ast))
+                return t;
+            for (ASTNode *term : get_and_terms(def.ast))
+            {
+                // a literal alone (where x && false) decides the result by its value
+                LeafNode *leaf = as_leaf(term);
+                if (leaf && leaf->id.empty() && positions.count(leaf) > 0)
+                    return t;
+            }
+
+            std::vector<LeafNode *> literals;
+            if (!to_conditions(def.ast, mapping, t->conditions, &literals))
+            {
+                t->conditions.clear();
+                return t;
+            }
+            for (LeafNode *leaf : literals)
+            {
+                auto it = leaf ? positions.find(leaf) : positions.end();
+                t->condition_slots.push_back(it == positions.end() ? -1 : (int)it->second);
+            }
+            t->simple = true;
+            return t;
+        }
+
+        // Copy of the parsed select with its own tree, taken before the select is run:
+        // running it puts the values of the rows into the leaves of the columns
+        static SelectDef copy(const SelectDef &def)
+        {
+            SelectDef copied = def;
+            copied.arena = std::make_shared<ASTArena>();
+            copied.ast = clone(def.ast, *copied.arena);
+            for (auto &root : copied.removed)
+                root = clone(root, *copied.arena);
+            std::vector<LeafNode *> from, to;
+            collect_literals(def.ast, from);
+            collect_literals(copied.ast, to);
+            std::unordered_map<const LeafNode *, LeafNode *> leaves;
+            for (size_t i = 0; i < from.size(); ++i)
+                leaves.insert(std::make_pair(from[i], to[i]));
+            for (auto &literal : copied.literals)
+            {
+                auto it = leaves.find(literal.first);
+                literal.first = it == leaves.end() ? nullptr : it->second;
+            }
+            return copied;
+        }
+
+        // Conditions with the literals of the query
+        std::vector<std::pair<Condition, size_t>> bind_conditions(const std::vector<Lexem> &lexems) const
+        {
+            std::vector<std::pair<Condition, size_t>> bound = conditions;
+            for (size_t i = 0; i < bound.size(); ++i)
+            {
+                if (condition_slots[i] >= 0)
+                    bound[i].first = Condition(lex_to_value(lexems[condition_slots[i]]), bound[i].first.op);
+            }
+            return bound;
+        }
+
+        // Copy of the select with the literals of the query
+        SelectDef bind(const std::vector<Lexem> &lexems) const
+        {
+            SelectDef bound = def;
+            bound.arena = std::make_shared<ASTArena>();
+            bound.ast = clone(def.ast, *bound.arena);
+            for (auto &root : bound.removed)
+                root = clone(root, *bound.arena);
+            bound.literals.clear();
+            std::vector<LeafNode *> leaves;
+            collect_literals(bound.ast, leaves);
+            for (size_t i = 0; i < leaves.size(); ++i)
+            {
+                if (literal_slots[i] >= 0)
+                    leaves[i]->value = lex_to_value(lexems[literal_slots[i]]);
+            }
+            return bound;
+        }
+
+    private:
+        static void collect_literals(ASTNode *root, std::vector<LeafNode *> &leaves)
+        {
+            if (LeafNode *leaf = as_leaf(root))
+            {
+                if (leaf->id.empty())
+                    leaves.push_back(leaf);
+            }
+            else if (InternalNode *node = as_internal(root))
+            {
+                collect_literals(node->left, leaves);
+                collect_literals(node->right, leaves);
+            }
+        }
+    };
+
+    // Metrics of the plan cache
+    struct PlanCacheStats
+    {
+        size_t hits = 0;
+        size_t misses = 0;
+        size_t entries = 0;
+    };
+
+    // Templates of the selects by the query text without literals,
+    // least recently used templates are evicted when there are too many
+    class PlanCache
+    {
+        struct Entry
+        {
+            std::string key;
+            std::shared_ptr<const PlanTemplate> plan;
+        };
+
+        size_t capacity;
+        std::list<Entry> entries; // the most recently used first
+        std::unordered_map<std::string, std::list<Entry>::iterator> index;
+        std::mutex mutex; // selects look up the cache in parallel
+        PlanCacheStats stats;
+
+    public:
+        static constexpr size_t DEFAULT_CAPACITY = 1024;
+
+        PlanCache(size_t capacity) : capacity(capacity) {}
+
+        std::shared_ptr<const PlanTemplate> find(const std::string &key)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto it = index.find(key);
+            if (it == index.end())
+            {
+                stats.misses++;
+                return nullptr;
+            }
+            entries.splice(entries.begin(), entries, it->second);
+            stats.hits++;
+            return it->second->plan;
+        }
+
+        void add(const std::string &key, std::shared_ptr<const PlanTemplate> plan)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (index.count(key) > 0)
+                return; // made by a parallel select
+            if (entries.size() == capacity)
+            {
+                index.erase(entries.back().key);
+                entries.pop_back();
+            }
+            entries.push_front(Entry{ key, plan });
+            index.insert(std::make_pair(key, entries.begin()));
+        }
+
+        void clear()
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            entries.clear();
+            index.clear();
+        }
+
+        PlanCacheStats get_stats()
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            PlanCacheStats result = stats;
+            result.entries = entries.size();
+            return result;
+        }
+    };
+
+}
@@ -0,0 +1,240 @@
+#pragma once
+
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstring>
+#include <cerrno>
+
+#include <unistd.h>
+#include <sys/uio.h>
+
+#include "base.h"
+#include "column.h"
+#include "querystats.h"
+#include "resultset.h"
+
+namespace memdb
+{
+
+    // Binary protocol of memdb_server (Unix domain sockets, so the byte order is the one of the host).
+    //
+    // Request:  u32 query length | u32 request id | query text
+    // Response: u32 header length | u64 block length | header | row block
+    //
+    // The header is the request id, the status, the error message, the query statistics and the
+    // schema of the result (columns with their types, sizes and offsets, row size and row count).
+    // The row block is the storage of the ResultSet sent as is. A client may send many requests
+    // without waiting for the responses, they are answered in the order of the requests.
+    class Protocol
+    {
+    public:
+        static constexpr size_t MAX_QUERY_SIZE = 16 * 1024 * 1024;
+
+        // Reads exactly size bytes, returns false on the end of the stream before the first byte
+        static bool read_full(int fd, void *buf, size_t size)
+        {
+            uint8_t *ptr = (uint8_t *)buf;
+            size_t done = 0;
+            while (done < size)
+            {
+                ssize_t n = ::read(fd, ptr + done, size - done);
+                if (n < 0 && errno == EINTR)
+                    continue;
+                if (n < 0)
+                    throw std::runtime_error("Read error: " + std::string(std::strerror(errno)));
+                if (n == 0)
+                {
+                    if (done == 0)
+                        return false;
+                    throw std::runtime_error("Connection closed in the middle of a message.");
+                }
+                done += (size_t)n;
+            }
+            return true;
+        }
+
+        // Writes all the buffers, continuing after partial writes
+        static void write_full(int fd, struct iovec *iov, int count)
+        {
+            while (count > 0)
+            {
+                ssize_t n = ::writev(fd, iov, count);
+                if (n < 0 && errno == EINTR)
+                    continue;
+                if (n < 0)
+                    throw std::runtime_error("Write error: " + std::string(std::strerror(errno)));
+                size_t written = (size_t)n;
+                while (count > 0 && written >= iov->iov_len)
+                {
+                    written -= iov->iov_len;
+                    ++iov;
+                    --count;
+                }
+                if (count > 0)
+                {
+                    iov->iov_base = (uint8_t *)iov->iov_base + written;
+                    iov->iov_len -= written;
+                }
+            }
+        }
+
+        static void write_request(int fd, uint32_t id, std::string_view query)
+        {
+            uint32_t head[2] = { (uint32_t)query.size(), id };
+            struct iovec iov[2] = { { head, sizeof(head) }, { (void *)query.data(), query.size() } };
+            write_full(fd, iov, 2);
+        }
+
+        // Returns false if the peer has closed the connection
+        static bool read_request(int fd, uint32_t &id, std::string &query)
+        {
+            uint32_t head[2];
+            if (!read_full(fd, head, sizeof(head)))
+                return false;
+            if (head[0] > MAX_QUERY_SIZE)
+                throw std::runtime_error("Query too large.");
+            id = head[1];
+            query.resize(head[0]);
+            if (head[0] > 0 && !read_full(fd, &query[0], head[0]))
+                throw std::runtime_error("Connection closed in the middle of a message.");
+            return true;
+        }
+
+        // Sends the header and the storage of the result with one writev
+        static void write_response(int fd, uint32_t id, const ResultSet &rs)
+        {
+            std::string header = encode_header(id, rs);
+            uint32_t header_size = (uint32_t)header.size();
+            uint64_t block_size = (uint64_t)rs.row_size * rs.row_count;
+            struct iovec iov[4] = {
+                { &header_size, sizeof(header_size) },
+                { &block_size, sizeof(block_size) },
+                { &header[0], header.size() },
+                { rs.storage.get(), (size_t)block_size } };
+            write_full(fd, iov, block_size > 0 ? 4 : 3);
+        }
+
+        // The row block is read straight into the storage of the result
+        static bool read_response(int fd, uint32_t &id, ResultSet &rs)
+        {
+            uint32_t header_size;
+            uint64_t block_size;
+            if (!read_full(fd, &header_size, sizeof(header_size)))
+                return false;
+            if (!read_full(fd, &block_size, sizeof(block_size)))
+                throw std::runtime_error("Connection closed in the middle of a message.");
+            std::vector<uint8_t> header(header_size);
+            if (header_size > 0 && !read_full(fd, header.data(), header_size))
+                throw std::runtime_error("Connection closed in the middle of a message.");
+
+            rs = ResultSet();
+            id = decode_header(header, rs);
+            if (block_size != (uint64_t)rs.row_size * rs.row_count)
+                throw std::runtime_error("Malformed response.");
+            if (block_size > 0)
+            {
+                rs.storage.reset(new uint8_t[block_size]);
+                if (!read_full(fd, rs.storage.get(), block_size))
+                    throw std::runtime_error("Connection closed in the middle of a message.");
+            }
+            return true;
+        }
+
+    private:
+        template <typename T>
+        static void put(std::string &out, const T &val)
+        {
+            out.append((const char *)&val, sizeof(val));
+        }
+
+        static void put_string(std::string &out, const std::string &val)
+        {
+            put(out, (uint32_t)val.size());
+            out.append(val);
+        }
+
+        struct Reader
+        {
+            const std::vector<uint8_t> &in;
+            size_t pos = 0;
+
+            Reader(const std::vector<uint8_t> &in) : in(in) {}
+
+            template <typename T>
+            T get()
+            {
+                T val;
+                check(sizeof(val));
+                std::memcpy(&val, in.data() + pos, sizeof(val));
+                pos += sizeof(val);
+                return val;
+            }
+
+            std::string get_string()
+            {
+                uint32_t size = get<uint32_t>();
+                check(size);
+                std::string val((const char *)in.data() + pos, size);
+                pos += size;
+                return val;
+            }
+
+            void check(size_t size)
+            {
+                if (pos + size > in.size())
+                    throw std::runtime_error("Malformed response.");
+            }
+        };
+
+        static std::string encode_header(uint32_t id, const ResultSet &rs)
+        {
+            std::string out;
+            put(out, id);
+            put(out, (uint8_t)rs.ok);
+            put_string(out, rs.ok ? std::string() : rs.error);
+            put(out, rs.stats);
+            put(out, rs.time_ms);
+            put(out, (uint16_t)rs.layout.size());
+            for (const auto &column : rs.layout)
+            {
+                put(out, (uint8_t)column.type);
+                put(out, column.size);
+                put(out, column.offset);
+                put_string(out, column.name);
+            }
+            put(out, rs.row_size);
+            put(out, (uint64_t)rs.row_count);
+            return out;
+        }
+
+        static uint32_t decode_header(const std::vector<uint8_t> &in, ResultSet &rs)
+        {
+            Reader reader(in);
+            uint32_t id = reader.get<uint32_t>();
+            rs.ok = reader.get<uint8_t>() != 0;
+            std::string error = reader.get_string();
+            if (!rs.ok)
+                rs.error = error;
+            rs.stats = reader.get<QueryStats>();
+            rs.time_ms = reader.get<int64_t>();
+            uint16_t column_count = reader.get<uint16_t>();
+            for (uint16_t i = 0; i < column_count; ++i)
+            {
+                Type type = (Type)reader.get<uint8_t>();
+                uint16_t size = reader.get<uint16_t>();
+                uint16_t offset = reader.get<uint16_t>();
+                Column column(type, reader.get_string(), size);
+                rs.add_column(column);
+                if (rs.layout.back().offset != offset)
+                    throw std::runtime_error("Malformed response.");
+            }
+            if (reader.get<uint16_t>() != rs.row_size)
+                throw std::runtime_error("Malformed response.");
+            rs.row_count = (size_t)reader.get<uint64_t>();
+            return id;
+        }
+    };
+
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstdint>
+#include <chrono>
+
+namespace memdb
+{
+
+    // Figures collected while executing a query
+    struct QueryStats
+    {
+        int64_t total_ns = 0;       // the whole query
+        int64_t parse_ns = 0;       // lexing and parsing
+        int64_t plan_ns = 0;        // choosing the access path
+        int64_t scan_ns = 0;        // finding the matching rows (index probes and row checks)
+        int64_t materialize_ns = 0; // making the result
+        size_t rows_examined = 0;   // rows checked against the condition
+        size_t rows_matched = 0;
+        size_t index_probes = 0;    // binary searches in ordered indices
+        size_t comparisons = 0;     // values compared by the binary searches and the row checks
+        size_t bytes_copied = 0;    // bytes written into the result
+        size_t allocations = 0;     // buffers allocated for the found rows and the result
+
+        // Adds the figures of a part of the query (e.g. of one partition), except the total time
+        QueryStats &operator+=(const QueryStats &other)
+        {
+            parse_ns += other.parse_ns;
+            plan_ns += other.plan_ns;
+            scan_ns += other.scan_ns;
+            materialize_ns += other.materialize_ns;
+            rows_examined += other.rows_examined;
+            rows_matched += other.rows_matched;
+            index_probes += other.index_probes;
+            comparisons += other.comparisons;
+            bytes_copied += other.bytes_copied;
+            allocations += other.allocations;
+            return *this;
+        }
+    };
+
+    inline int64_t elapsed_ns(std::chrono::steady_clock::time_point since)
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - since).count();
+    }
+
+}
@@ -0,0 +1,127 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <list>
+#include <unordered_map>
+#include <mutex>
+
+#include "base.h"
+#include "resultset.h"
+
+namespace memdb
+{
+
+    // Metrics of the result cache
+    struct ResultCacheStats
+    {
+        size_t hits = 0;
+        size_t misses = 0;      // including the entries found stale
+        size_t evictions = 0;   // entries removed to stay within the budget
+        size_t entries = 0;
+        size_t bytes = 0;       // estimated memory of the entries
+    };
+
+    // Results of the selects by the query text, least recently used entries are evicted when
+    // the total size exceeds the budget. An entry is valid while the version of its table
+    // (incremented by every change of the table) is the one the result was made with.
+    // The result rows are shared with the returned results, not copied.
+    class ResultCache
+    {
+        struct Entry
+        {
+            std::string key;
+            std::string table;
+            uint64_t version = 0;
+            ResultSet result;
+            size_t bytes = 0;
+        };
+
+        size_t budget;
+        std::list<Entry> entries; // the most recently used first
+        std::unordered_map<std::string, std::list<Entry>::iterator> index;
+        std::mutex mutex; // selects look up the cache in parallel
+        ResultCacheStats stats;
+
+    public:
+        ResultCache(size_t budget) : budget(budget) {}
+
+        // Finds the result of the query, table_version gives the current version of a table
+        template <typename VersionFunc>
+        bool find(const std::string &key, VersionFunc table_version, ResultSet &result)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto it = index.find(key);
+            if (it == index.end())
+            {
+                stats.misses++;
+                return false;
+            }
+            Entry &entry = *it->second;
+            if (table_version(entry.table) != entry.version)
+            {
+                remove(it->second);
+                stats.misses++;
+                return false;
+            }
+            entries.splice(entries.begin(), entries, it->second);
+            stats.hits++;
+            result = entry.result;
+            return true;
+        }
+
+        void add(const std::string &key, const std::string &table, uint64_t version, const ResultSet &result)
+        {
+            size_t bytes = size_of(key, result);
+            std::lock_guard<std::mutex> lock(mutex);
+            auto it = index.find(key);
+            if (it != index.end())
+                remove(it->second); // made by a parallel select or stale
+            if (bytes > budget)
+                return;
+            while (stats.bytes + bytes > budget)
+            {
+                remove(std::prev(entries.end()));
+                stats.evictions++;
+            }
+            entries.push_front(Entry{ key, table, version, result, bytes });
+            index.insert(std::make_pair(key, entries.begin()));
+            stats.entries++;
+            stats.bytes += bytes;
+        }
+
+        void clear()
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            entries.clear();
+            index.clear();
+            stats.entries = 0;
+            stats.bytes = 0;
+        }
+
+        ResultCacheStats get_stats()
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            return stats;
+        }
+
+    private:
+        void remove(std::list<Entry>::iterator it)
+        {
+            stats.entries--;
+            stats.bytes -= it->bytes;
+            index.erase(it->key);
+            entries.erase(it);
+        }
+
+        // Estimated memory of an entry: the rows, the column descriptions and the key
+        static size_t size_of(const std::string &key, const ResultSet &result)
+        {
+            size_t bytes = sizeof(Entry) + 2 * key.size() + (size_t)result.row_size * result.row_count;
+            for (const auto &col : result.layout)
+                bytes += 3 * (sizeof(Column) + col.name.size());
+            return bytes;
+        }
+    };
+
+}
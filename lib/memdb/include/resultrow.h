@@ -2,8 +2,10 @@
 
 #include <stdexcept>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <unordered_map>
+#include <algorithm>
 
 #include "base.h"
 #include "value.h"
@@ -11,12 +13,18 @@
 namespace memdb
 {
 
+    // Row of a result set.
+    // Values can be accessed by the column name or, faster, by the position of the column
+    // in the select list (see ResultSet::get_column_index). Views point into the result set
+    // and are valid while the result set is alive.
     class ResultRow
     {
         friend class ResultSetIterator;
         uint8_t *row_ptr;
         const std::unordered_map<std::string, Column> *columns = nullptr;
-        ResultRow(uint8_t *row_ptr, const std::unordered_map<std::string, Column> *columns) : row_ptr(row_ptr), columns(columns) {}
+        const std::vector<Column> *layout = nullptr; // columns in the select order
+        ResultRow(uint8_t *row_ptr, const std::unordered_map<std::string, Column> *columns, const std::vector<Column> *layout)
+            : row_ptr(row_ptr), columns(columns), layout(layout) {}
 
     public:
         template <typename T>
@@ -26,62 +34,132 @@ namespace memdb
         }
 
         template <typename T>
-        const T get(size_t i) const
+        T get(size_t i) const
         {
-            throw std::runtime_error("Not implemented");
+            throw std::runtime_error("Invalid type");
+        }
+
+        // Non-owning access to string (std::string_view) and bytes (BytesView) values
+        template <typename T>
+        T get_view(const std::string &name) const
+        {
+            throw std::runtime_error("Invalid type");
+        }
+
+        template <typename T>
+        T get_view(size_t i) const
+        {
+            throw std::runtime_error("Invalid type");
+        }
+
+    private:
+        const Column &column(const std::string &name, Type type) const
+        {
+            const Column &column = columns->at(name);
+            if (column.type != type)
+            {
+                throw std::runtime_error("Invalid type");
+            }
+            return column;
+        }
+
+        const Column &column(size_t i, Type type) const
+        {
+            if (i >= layout->size())
+            {
+                throw std::runtime_error("Column index out of range");
+            }
+            const Column &column = (*layout)[i];
+            if (column.type != type)
+            {
+                throw std::runtime_error("Invalid type");
+            }
+            return column;
+        }
+
+        std::string_view string_view_of(const Column &column) const
+        {
+            const char *val_ptr = (const char *)row_ptr + column.offset;
+            return std::string_view(val_ptr, std::find(val_ptr, val_ptr + column.size, '\0') - val_ptr);
         }
     };
 
     template <>
     int32_t ResultRow::get<int32_t>(const std::string &name) const
     {
-        const Column &column = columns->at(name);
-        if (column.type != Type::INT)
-        {
-            throw std::runtime_error("Invalid type");
-        }
-        size_t offset = column.offset;
-        uint8_t *val_ptr = row_ptr + offset;
-        return *((int32_t *)val_ptr);
+        return *((int32_t *)(row_ptr + column(name, Type::INT).offset));
     }
 
     template <>
     bool ResultRow::get<bool>(const std::string &name) const
     {
-        const Column &column = columns->at(name);
-        if (column.type != Type::BOOL)
-        {
-            throw std::runtime_error("Invalid type");
-        }
-        size_t offset = column.offset;
-        uint8_t *val_ptr = row_ptr + offset;
-        return *((bool *)val_ptr);
+        return *((bool *)(row_ptr + column(name, Type::BOOL).offset));
     }
 
     template <>
     std::string ResultRow::get<std::string>(const std::string &name) const
     {
-        const Column &column = columns->at(name);
-        if (column.type != Type::STRING)
-        {
-            throw std::runtime_error("Invalid type");
-        }
-        size_t offset = column.offset;
-        uint8_t *val_ptr = row_ptr + offset;
-        return std::string((const char *)val_ptr);
+        return std::string(string_view_of(column(name, Type::STRING)));
     }
 
     template <>
     Bytes ResultRow::get<Bytes>(const std::string &name) const
     {
-        const Column &column = columns->at(name);
-        if (column.type != Type::BYTES)
-        {
-            throw std::runtime_error("Invalid type");
-        }
-        size_t offset = column.offset;
-        uint8_t *val_ptr = row_ptr + offset;
-        return Bytes(val_ptr, val_ptr + column.size);
+        const Column &col = column(name, Type::BYTES);
+        uint8_t *val_ptr = row_ptr + col.offset;
+        return Bytes(val_ptr, val_ptr + col.size);
+    }
+
+    template <>
+    int32_t ResultRow::get<int32_t>(size_t i) const
+    {
+        return *((int32_t *)(row_ptr + column(i, Type::INT).offset));
+    }
+
+    template <>
+    bool ResultRow::get<bool>(size_t i) const
+    {
+        return *((bool *)(row_ptr + column(i, Type::BOOL).offset));
+    }
+
+    template <>
+    std::string ResultRow::get<std::string>(size_t i) const
+    {
+        return std::string(string_view_of(column(i, Type::STRING)));
+    }
+
+    template <>
+    Bytes ResultRow::get<Bytes>(size_t i) const
+    {
+        const Column &col = column(i, Type::BYTES);
+        uint8_t *val_ptr = row_ptr + col.offset;
+        return Bytes(val_ptr, val_ptr + col.size);
+    }
+
+    template <>
+    std::string_view ResultRow::get_view<std::string_view>(const std::string &name) const
+    {
+        return string_view_of(column(name, Type::STRING));
+    }
+
+    template <>
+    BytesView ResultRow::get_view<BytesView>(const std::string &name) const
+    {
+        const Column &col = column(name, Type::BYTES);
+        return BytesView(row_ptr + col.offset, col.size);
+    }
+
+    template <>
+    std::string_view ResultRow::get_view<std::string_view>(size_t i) const
+    {
+        return string_view_of(column(i, Type::STRING));
+    }
+
+    template <>
+    BytesView ResultRow::get_view<BytesView>(size_t i) const
+    {
+        const Column &col = column(i, Type::BYTES);
+        return BytesView(row_ptr + col.offset, col.size);
     }
 
 }
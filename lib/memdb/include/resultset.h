@@ -9,6 +9,7 @@
 
 #include "base.h"
 #include "resultrow.h"
+#include "querystats.h"
 
 namespace memdb
 {
@@ -27,13 +28,15 @@ namespace memdb
         size_t curr_row;
         uint8_t *storage = nullptr;
         const std::unordered_map<std::string, Column> *columns;
+        const std::vector<Column> *layout;
 
     public:
         ResultSetIterator(const ResultSetIterator &other) : row_size(other.row_size),
                                                             row_count(other.row_count),
                                                             curr_row(other.curr_row),
                                                             storage(other.storage),
-                                                            columns(other.columns)
+                                                            columns(other.columns),
+                                                            layout(other.layout)
         {
         }
 
@@ -50,11 +53,12 @@ namespace memdb
         }
         bool operator==(const ResultSetIterator &rhs) const { return curr_row == rhs.curr_row; }
         bool operator!=(const ResultSetIterator &rhs) const { return curr_row != rhs.curr_row; }
-        ResultRow operator*() { return ResultRow(storage + curr_row * row_size, columns); }
+        ResultRow operator*() { return ResultRow(storage + curr_row * row_size, columns, layout); }
 
     private:
-        ResultSetIterator(uint16_t row_size, size_t row_count, size_t curr_row, uint8_t *storage, const std::unordered_map<std::string, Column> *columns)
-            : row_size(row_size), row_count(row_count), curr_row(curr_row), storage(storage), columns(columns)
+        ResultSetIterator(uint16_t row_size, size_t row_count, size_t curr_row, uint8_t *storage,
+                          const std::unordered_map<std::string, Column> *columns, const std::vector<Column> *layout)
+            : row_size(row_size), row_count(row_count), curr_row(curr_row), storage(storage), columns(columns), layout(layout)
         {
         }
     };
@@ -63,6 +67,11 @@ namespace memdb
     {
         friend class Table;
         friend class Database;
+        friend class RowWriter;
+        friend class PartitionedTable;
+        friend class Protocol;
+        friend class Server;
+        friend class ResultCache;
 
         // config
         uint16_t row_size = 0;
@@ -72,11 +81,13 @@ namespace memdb
         // columns
         std::vector<std::string> columns;
         std::unordered_map<std::string, Column> mapping;
+        std::vector<Column> layout; // columns in the select order with their offsets in a row
 
         // result
         bool ok = true;
         std::string error = "OK";
         int64_t time_ms = 0;
+        QueryStats stats;
 
     public:
         ResultSet() {}
@@ -85,19 +96,43 @@ namespace memdb
         {            
         }
 
-        ResultSetIterator begin() const { return ResultSetIterator(row_size, row_count, 0, storage.get(), &mapping); }
-        ResultSetIterator end() const { return ResultSetIterator(row_size, row_count, row_count, storage.get(), &mapping); }
+        ResultSetIterator begin() const { return ResultSetIterator(row_size, row_count, 0, storage.get(), &mapping, &layout); }
+        ResultSetIterator end() const { return ResultSetIterator(row_size, row_count, row_count, storage.get(), &mapping, &layout); }
 
         size_t get_column_count() const { return columns.size(); }
         size_t get_row_count() const { return row_count; }
 
         std::vector<std::string> get_columns() const { return columns; }
 
+        // Position of the column for the positional accessors of ResultRow
+        size_t get_column_index(const std::string &name) const
+        {
+            for (size_t i = 0; i < columns.size(); ++i)
+            {
+                if (columns[i] == name)
+                    return i;
+            }
+            throw std::runtime_error("Column not found");
+        }
+
         bool is_ok() const { return ok; }
 
         std::string get_error() const { return error; }
 
         int64_t get_time() const { return time_ms; }
+
+        const QueryStats &get_stats() const { return stats; }
+
+    private:
+        // Appends the column to the end of the row
+        void add_column(Column column)
+        {
+            column.offset = row_size;
+            row_size += column.size;
+            columns.push_back(column.name);
+            mapping.insert(std::make_pair(column.name, column));
+            layout.push_back(column);
+        }
     };
 
 }
@@ -0,0 +1,175 @@
+#pragma once
+
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <list>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <algorithm>
+#include <cstring>
+#include <cerrno>
+
+#include <unistd.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "database.h"
+#include "protocol.h"
+
+namespace memdb
+{
+
+    // Serves the database over a Unix domain socket, see Protocol.
+    // Every connection is served by its own thread; the requests of a connection
+    // are executed one after another, so the responses keep the order of the requests.
+    // The threads of the closed connections are joined by the accepting thread.
+    // The process should ignore SIGPIPE, otherwise a client closing the connection early kills it.
+    class Server
+    {
+        static constexpr int POLL_TIMEOUT_MS = 100;
+
+        Database &db;
+        std::string path;
+        int listen_fd = -1;
+        std::atomic<bool> stopping{ false };
+
+        struct Connection
+        {
+            int fd;
+            std::thread thread;
+            bool done = false; // the thread has finished serving
+        };
+
+        std::mutex mutex;
+        std::list<Connection> connections;
+
+    public:
+        Server(Database &db, const std::string &path) : db(db), path(path)
+        {
+            sockaddr_un addr;
+            if (path.size() >= sizeof(addr.sun_path))
+                throw std::runtime_error("Socket path too long.");
+            std::memset(&addr, 0, sizeof(addr));
+            addr.sun_family = AF_UNIX;
+            std::memcpy(addr.sun_path, path.c_str(), path.size());
+
+            listen_fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+            if (listen_fd < 0)
+                throw std::runtime_error("Cannot create socket: " + std::string(std::strerror(errno)));
+            ::unlink(path.c_str());
+            if (::bind(listen_fd, (sockaddr *)&addr, sizeof(addr)) < 0 || ::listen(listen_fd, SOMAXCONN) < 0)
+            {
+                std::string error = std::strerror(errno);
+                ::close(listen_fd);
+                throw std::runtime_error("Cannot listen on " + path + ": " + error);
+            }
+        }
+
+        Server(const Server &) = delete;
+        Server &operator=(const Server &) = delete;
+
+        ~Server()
+        {
+            stop();
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                for (auto &connection : connections)
+                {
+                    if (!connection.done)
+                        ::shutdown(connection.fd, SHUT_RDWR);
+                }
+            }
+            for (auto &connection : connections)
+                connection.thread.join();
+            ::close(listen_fd);
+            ::unlink(path.c_str());
+        }
+
+        // Accepts connections until stop() is called
+        void run()
+        {
+            while (!stopping)
+            {
+                reap();
+                pollfd pfd = { listen_fd, POLLIN, 0 };
+                int n = ::poll(&pfd, 1, POLL_TIMEOUT_MS);
+                if (n <= 0)
+                    continue;
+                int fd = ::accept(listen_fd, nullptr, nullptr);
+                if (fd < 0)
+                    continue;
+                std::lock_guard<std::mutex> lock(mutex);
+                connections.push_back(Connection{ fd, std::thread(), false });
+                Connection *connection = &connections.back();
+                connection->thread = std::thread([this, connection]() { serve(*connection); });
+            }
+        }
+
+        // Number of the connections whose threads are not joined yet
+        size_t connection_count()
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            return connections.size();
+        }
+
+        void stop()
+        {
+            stopping = true;
+        }
+
+    private:
+        void serve(Connection &connection)
+        {
+            int fd = connection.fd;
+            try
+            {
+                uint32_t id;
+                std::string query;
+                while (!stopping && Protocol::read_request(fd, id, query))
+                {
+                    ResultSet rs;
+                    try
+                    {
+                        rs = db.execute(query);
+                    }
+                    catch (std::exception &e)
+                    {
+                        // a bad query is answered, the connection and the server go on
+                        rs.ok = false;
+                        rs.error = e.what();
+                    }
+                    Protocol::write_response(fd, id, rs);
+                }
+            }
+            catch (std::exception &)
+            {
+                // the connection is broken, nothing to answer
+            }
+            std::lock_guard<std::mutex> lock(mutex);
+            ::close(fd);
+            connection.done = true;
+        }
+
+        // Joins the threads of the closed connections
+        void reap()
+        {
+            std::list<Connection> finished;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                for (auto it = connections.begin(); it != connections.end();)
+                {
+                    auto next = std::next(it);
+                    if (it->done)
+                        finished.splice(finished.end(), connections, it);
+                    it = next;
+                }
+            }
+            for (auto &connection : finished)
+                connection.thread.join();
+        }
+    };
+
+}
@@ -0,0 +1,147 @@
+#pragma once
+
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+
+#include "base.h"
+#include "value.h"
+#include "condition.h"
+
+namespace memdb
+{
+
+    // Column statistics used to estimate the selectivity of conditions:
+    // number of rows, estimated number of distinct values and
+    // an equi-depth histogram built from a sample of rows.
+    struct ColumnStats
+    {
+        static constexpr size_t NUM_BUCKETS = 64;
+        static constexpr size_t SAMPLE_SIZE = 16384;
+
+        bool valid = false;
+        size_t row_count = 0;       // number of rows when the statistics were built
+        double distinct = 0;        // estimated number of distinct values
+        std::vector<Value> bounds;  // upper bounds of the buckets, every bucket holds the same number of rows
+
+        // Checks if the statistics should be rebuilt for the table of the given size
+        bool is_stale(size_t rows) const
+        {
+            if (!valid)
+                return true;
+            size_t diff = rows > row_count ? rows - row_count : row_count - rows;
+            return diff * 10 > row_count; // more than 10% of rows changed
+        }
+
+        // Builds the statistics from the sorted sample of the column values
+        void build(std::vector<Value> &sample, size_t rows)
+        {
+            valid = true;
+            row_count = rows;
+            bounds.clear();
+            distinct = 0;
+            if (sample.empty())
+                return;
+
+            std::sort(sample.begin(), sample.end());
+
+            // Distinct values: exact for the full table, otherwise
+            // the GEE estimator sqrt(N/n) * f1 + sum(fj), j >= 2,
+            // where fj is the number of values seen exactly j times.
+            size_t f1 = 0;
+            size_t fn = 0;
+            for (size_t i = 0; i < sample.size();)
+            {
+                size_t j = i + 1;
+                while (j < sample.size() && sample[j] == sample[i])
+                    ++j;
+                if (j - i == 1)
+                    ++f1;
+                else
+                    ++fn;
+                i = j;
+            }
+            if (sample.size() == rows)
+                distinct = (double)(f1 + fn);
+            else
+                distinct = std::sqrt((double)rows / sample.size()) * f1 + fn;
+
+            size_t buckets = std::min(NUM_BUCKETS, sample.size());
+            for (size_t b = 1; b <= buckets; ++b)
+            {
+                bounds.push_back(sample[b * sample.size() / buckets - 1]);
+            }
+        }
+
+        // Estimated fraction of rows matching the condition
+        double selectivity(const Condition &cond) const
+        {
+            if (!valid || bounds.empty() || cond.that.type != bounds[0].type)
+                return 1.0;
+
+            const Value &v = cond.that;
+            double n = (double)bounds.size();
+            // fractions of rows with values less than and less than or equal to v
+            double lt = (std::lower_bound(bounds.begin(), bounds.end(), v) - bounds.begin()) / n;
+            double le = (std::upper_bound(bounds.begin(), bounds.end(), v) - bounds.begin()) / n;
+            // value equal to several bounds is a frequent value
+            double eq = std::max(le - lt, distinct > 0 ? 1.0 / distinct : 1.0);
+            if (bounds.back() < v)
+                eq = 0; // greater than the maximum
+
+            switch (cond.op)
+            {
+            case RelOp::EQ:
+                return eq;
+            case RelOp::NE:
+                return 1.0 - eq;
+            case RelOp::LT:
+                return lt;
+            case RelOp::LE:
+                return std::min(1.0, lt + eq);
+            case RelOp::GT:
+                return std::max(0.0, 1.0 - lt - eq);
+            case RelOp::GE:
+                return 1.0 - lt;
+            case RelOp::LIKE:
+            case RelOp::STARTS_WITH:
+                break; // the prefix is estimated as a range
+            }
+            return 1.0;
+        }
+
+        // Estimated fraction of rows matching all the conditions on the column
+        double selectivity(const std::vector<const Condition *> &conds) const
+        {
+            // For a lower and an upper bound the fraction of the interval
+            // is P(x >= a) + P(x < b) - 1
+            double sum = 0;
+            for (const auto &cond : conds)
+                sum += selectivity(*cond);
+            double sel = sum - (double)(conds.size() - 1);
+            double min_sel = row_count > 0 ? 1.0 / row_count : 0.0;
+            return std::min(1.0, std::max(min_sel, sel));
+        }
+    };
+
+    // Makes an owning copy of the value
+    inline Value make_owned(const Value &val)
+    {
+        switch (val.type)
+        {
+        case Type::INT:
+            return Value(val.get<int32_t>());
+        case Type::BOOL:
+            return Value(val.get<bool>());
+        case Type::STRING:
+            return Value(val.get<std::string>());
+        case Type::BYTES:
+            return Value(val.get<Bytes>());
+        default:
+            return Value();
+        }
+    }
+
+}
@@ -8,6 +8,10 @@
 #include <unordered_set>
 #include <algorithm>
 #include <chrono>
+#include <memory>
+#include <mutex>
+#include <cmath>
+#include <cstring>
 
 #include "base.h"
 #include "bytes.h"
@@ -19,6 +23,16 @@
 #include "ast.h"
 #include "visitor.h"
 #include "index.h"
+#include "aggregate.h"
+#include "zonemap.h"
+#include "bloom.h"
+#include "trigram.h"
+#include "bitmap.h"
+#include "dictionary.h"
+#include "gather.h"
+#include "stats.h"
+#include "plan.h"
+#include "querystats.h"
 
 namespace memdb
 {
@@ -26,6 +40,8 @@ namespace memdb
     class Table
     {
         friend class Database;
+        friend class RowWriter;
+        friend class PartitionedTable;
 
         static constexpr size_t INITIAL_CAPACITY = 32;
 
@@ -36,10 +52,27 @@ namespace memdb
         std::unordered_map<std::string, size_t> mapping; // column name to column index mapping
 
         uint8_t *storage = nullptr; // data
+        uint64_t version = 0;       // incremented by every change of the rows
 
         // Indices
         std::vector<OrderedIndex> ordered_indices;
 
+        // Per-block min/max summaries
+        std::vector<ZoneMap> zone_maps;
+
+        // Per-block Bloom filters of the columns with the "bloom" attribute
+        std::vector<BloomFilter> bloom_filters;
+
+        // Trigram indices of string columns for the like and starts_with conditions
+        std::vector<TrigramIndex> trigram_indices;
+
+        // Dictionaries of the dictionary-encoded columns (nullptr for other columns)
+        std::vector<std::unique_ptr<Dictionary>> dictionaries;
+
+        // Column statistics for the planner, built on demand
+        std::vector<ColumnStats> stats;
+        std::mutex stats_mutex;
+
         // Конструктор для создания новой таблицы
         Table(const std::vector<Column> &cols) : columns(cols)
         {
@@ -53,14 +86,27 @@ namespace memdb
                 {
                     throw std::runtime_error("The default value type does not match the column type.");
                 }
+                if (columns[i].is_dict && columns[i].type != Type::STRING)
+                {
+                    throw std::runtime_error("Dictionary encoding is only allowed for string columns.");
+                }
                 columns[i].offset = row_size;
-                row_size += columns[i].size;
+                row_size += columns[i].width();
                 mapping.insert(std::make_pair(columns[i].name, i));
+                dictionaries.emplace_back(columns[i].is_dict ? new Dictionary() : nullptr);
                 
                 if (columns[i].is_key)
                 {
                     create_ordered_index(i);
                 }
+                if (ZoneMap::is_supported(columns[i].type) && !columns[i].is_dict)
+                {
+                    zone_maps.push_back(ZoneMap(i, columns[i]));
+                }
+                if (columns[i].has_bloom)
+                {
+                    bloom_filters.push_back(BloomFilter(i, columns[i]));
+                }
             }
 
             storage = new uint8_t[row_size * capacity];
@@ -73,8 +119,9 @@ namespace memdb
             for (size_t i = 0; i < columns.size(); ++i)
             {
                 columns[i].offset = row_size;
-                row_size += columns[i].size;
+                row_size += columns[i].width();
                 mapping.insert(std::make_pair(columns[i].name, i));
+                dictionaries.emplace_back(nullptr);
             }
         }
 
@@ -94,31 +141,22 @@ namespace memdb
                 std::vector<Value> checked = check_inserted_values(values);
                 size_t idx = row_count;
                 add_row();
+                version++;
 
                 uint8_t *row_ptr = storage + idx * row_size;
                 for (size_t i = 0; i < columns.size(); ++i)
                 {
                     size_t offset = columns[i].offset;
                     uint8_t *val_ptr = row_ptr + offset;
-                    std::copy(checked[i].val_ptr, checked[i].val_ptr + checked[i].size, val_ptr);
-                }
-
-                // update ordered indices
-                for (size_t i = 0; i < ordered_indices.size(); ++i)
-                {
-                    OrderedIndex& ordered_index = ordered_indices[i];
-                    if (columns[ordered_index.col].is_auto)
-                    {
-                        // just add to the end for autoicrement column
-                        ordered_index.index.push_back(idx);
-                    }
+                    if (columns[i].is_dict)
+                        *((uint32_t *)val_ptr) = dictionaries[i]->encode(checked[i].get<std::string>());
                     else
-                    {
-                        // find a position to insert using binary search
-                        size_t first = upper_bound(checked[ordered_index.col], ordered_index);
-                        ordered_index.index.insert(ordered_index.index.begin() + first, idx);
-                    }                                       
+                        std::copy(checked[i].val_ptr, checked[i].val_ptr + checked[i].size, val_ptr);
                 }
+
+                update_block_summaries(idx);
+                update_ordered_indices(idx);
+                update_trigram_indices(idx);
             }
             catch (std::runtime_error &e)
             {
@@ -128,6 +166,7 @@ namespace memdb
 
             std::chrono::steady_clock::time_point t2 = std::chrono::steady_clock::now();
             rs.time_ms = std::chrono::duration_cast<std::chrono::milliseconds>(t2 - t1).count();
+            rs.stats.total_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(t2 - t1).count();
             return rs;
         }
 
@@ -146,252 +185,747 @@ namespace memdb
             std::chrono::steady_clock::time_point t1 = std::chrono::steady_clock::now();
 
             ResultSet rs = init_result_set(cols);
-            std::vector<size_t> included_rows;
-            std::unordered_set<size_t> cond_set;            
+            std::vector<size_t> included_rows = find_rows(conditions, rs.stats);
+            make_resultset(included_rows, rs);
+
+            std::chrono::steady_clock::time_point t2 = std::chrono::steady_clock::now();
+            rs.time_ms = std::chrono::duration_cast<std::chrono::milliseconds>(t2 - t1).count();
+            rs.stats.total_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(t2 - t1).count();
+            return rs;
+        }
+
+        // Select specific columns based on conditions 
+        // given as Abstract Syntax Tree.
+        ResultSet select(const std::vector<std::string>& cols, ASTNode* ast)
+        {            
+            std::chrono::steady_clock::time_point t1 = std::chrono::steady_clock::now();
+            ResultSet rs;
+
+            try
+            {
+                // Check the column list
+                for (const auto& col_name : cols)
+                {
+                    if (mapping.count(col_name) == 0)
+                        throw std::runtime_error("Unknown column \"" + col_name + "\" in the column list.");
+                }
+                rs = init_result_set(cols);
+                std::vector<size_t> included_rows = find_rows(ast, rs.stats);
+                make_resultset(included_rows, rs);
+            }
+            catch (std::runtime_error& e)
+            {
+                rs.ok = false;
+                rs.error = e.what();
+            }
+
+            std::chrono::steady_clock::time_point t2 = std::chrono::steady_clock::now();
+            rs.time_ms = std::chrono::duration_cast<std::chrono::milliseconds>(t2 - t1).count();
+            rs.stats.total_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(t2 - t1).count();
+            return rs;
+        }
+
+        // Selects groups of rows matching the condition.
+        // Every column in the column list must be either a group by column
+        // or an aggregate function. Partial sums (of a partition) are int64 values
+        // in bytes[8] columns, they are merged and checked by PartitionedTable.
+        ResultSet select(const std::vector<std::string>& cols, const std::vector<Aggregate>& aggregates,
+            const std::vector<std::string>& group_by, ASTNode* ast, bool partial_sums = false)
+        {
+            std::chrono::steady_clock::time_point t1 = std::chrono::steady_clock::now();
+            ResultSet rs;
 
-            // Check if ordered indices can be used.
-            // To do this, a list of ranges found by applying 
-            // binary search to the corresponding indices is created.
-            std::vector<IndexRange> ranges;
-            bool more = true;
-            while (more)
+            try
             {
-                more = false;
-                for (size_t i = 0; i < ordered_indices.size(); ++i)
+                // Check the group by list
+                std::vector<const Column*> keys;
+                for (const auto& col_name : group_by)
+                {
+                    if (mapping.count(col_name) == 0)
+                        throw std::runtime_error("Unknown column \"" + col_name + "\" in the group by list.");
+                    keys.push_back(&columns[mapping.at(col_name)]);
+                }
+                // Check the aggregates
+                std::vector<HashAggregator::Spec> specs;
+                for (const auto& agg : aggregates)
                 {
-                    const OrderedIndex &index = ordered_indices[i];
-                    for (size_t j = 0; j < conditions.size(); ++j)
+                    const Column* column = nullptr;
+                    if (agg.column != "*")
                     {
-                        if (cond_set.count(j) > 0)
-                            continue;
+                        if (mapping.count(agg.column) == 0)
+                            throw std::runtime_error("Unknown column \"" + agg.column + "\" in the aggregate function.");
+                        column = &columns[mapping.at(agg.column)];
+                    }
+                    else if (agg.func != AggFunc::COUNT)
+                    {
+                        throw std::runtime_error("Only count(*) is allowed.");
+                    }
+                    if (agg.func == AggFunc::SUM && column->type != Type::INT)
+                        throw std::runtime_error("Function sum is only allowed for numeric columns.");
+                    const std::vector<uint32_t>* ranks = column && column->is_dict ? &dictionaries[mapping.at(agg.column)]->ranks() : nullptr;
+                    specs.push_back({ agg.func, column, ranks });
+                }
+                // Make the result columns
+                rs.row_size = 0;
+                std::vector<std::pair<bool, size_t>> sources; // (is aggregate, key or aggregate index)
+                for (const auto& name : cols)
+                {
+                    Column rs_column;
+                    auto key_it = std::find(group_by.begin(), group_by.end(), name);
+                    auto agg_it = std::find_if(aggregates.begin(), aggregates.end(), [&name](const Aggregate& a) { return a.name() == name; });
+                    if (key_it != group_by.end())
+                    {
+                        size_t k = key_it - group_by.begin();
+                        rs_column = *keys[k];
+                        rs_column.is_dict = false;
+                        sources.push_back(std::make_pair(false, k));
+                    }
+                    else if (agg_it != aggregates.end())
+                    {
+                        size_t a = agg_it - aggregates.begin();
+                        if (agg_it->func == AggFunc::SUM && partial_sums)
+                            rs_column = Column(Type::BYTES, name, sizeof(int64_t));
+                        else if (agg_it->func == AggFunc::COUNT || agg_it->func == AggFunc::SUM)
+                            rs_column = Column(Type::INT, name);
+                        else
+                            rs_column = *specs[a].column;
+                        rs_column.is_dict = false;
+                        sources.push_back(std::make_pair(true, a));
+                    }
+                    else
+                    {
+                        throw std::runtime_error("Column \"" + name + "\" must appear in the group by list or be used in an aggregate function.");
+                    }
+                    rs_column.name = name;
+                    rs.add_column(rs_column);
+                }
 
-                        const Condition &cond = conditions[j].first;
-                        if (cond.op == RelOp::NE) // TODO: "NOT EQUAL" required special processing
-                            continue;
+                std::vector<size_t> included_rows = find_rows(ast, rs.stats);
+                std::chrono::steady_clock::time_point t3 = std::chrono::steady_clock::now();
+                HashAggregator aggregator(storage, row_size, keys, specs);
+                Groups groups = aggregator.run(included_rows);
+
+                // Aggregates without group by always produce one row
+                if (keys.empty() && groups.size() == 0)
+                {
+                    groups.first_row.push_back(SIZE_MAX);
+                    for (const auto& spec : specs)
+                        groups.acc.push_back(spec.func == AggFunc::COUNT || spec.func == AggFunc::SUM ? 0 : -1);
+                }
 
-                        size_t col = conditions[j].second;
-                        if (index.col == col)
+                rs.row_count = groups.size();
+                rs.storage.reset(new uint8_t[rs.row_size * rs.row_count]());
+                rs.stats.allocations++;
+                rs.stats.bytes_copied += (size_t)rs.row_size * rs.row_count;
+                for (size_t g = 0; g < groups.size(); ++g)
+                {
+                    uint8_t* rs_row_ptr = rs.storage.get() + g * rs.row_size;
+                    for (size_t i = 0; i < cols.size(); ++i)
+                    {
+                        uint8_t* rs_val_ptr = rs_row_ptr + rs.layout[i].offset;
+                        if (!sources[i].first)
+                        {
+                            copy_value(groups.first_row[g], mapping.at(group_by[sources[i].second]), rs_val_ptr);
+                            continue;
+                        }
+                        size_t a = sources[i].second;
+                        int64_t acc = groups.acc[g * specs.size() + a];
+                        if (specs[a].func == AggFunc::SUM && partial_sums)
+                        {
+                            std::memcpy(rs_val_ptr, &acc, sizeof(acc));
+                        }
+                        else if (specs[a].func == AggFunc::COUNT || specs[a].func == AggFunc::SUM)
+                        {
+                            // sums are accumulated in 64 bits, the result column is int32
+                            if (acc < INT32_MIN || acc > INT32_MAX)
+                                throw std::runtime_error("Integer overflow in " + aggregates[a].name() + ".");
+                            *((int32_t*)rs_val_ptr) = (int32_t)acc;
+                        }
+                        else if (acc >= 0)
                         {
-                            const auto& r = select_by_index(index, cond);
-                            ranges.insert(ranges.end(), r.begin(), r.end());
-                            cond_set.insert(j);
-                            more = true;
-                            break;
+                            copy_value((size_t)acc, mapping.at(aggregates[a].column), rs_val_ptr);
                         }
                     }
                 }
+                rs.stats.materialize_ns += elapsed_ns(t3);
+            }
+            catch (std::runtime_error& e)
+            {
+                rs.ok = false;
+                rs.error = e.what();
+            }
+
+            std::chrono::steady_clock::time_point t2 = std::chrono::steady_clock::now();
+            rs.time_ms = std::chrono::duration_cast<std::chrono::milliseconds>(t2 - t1).count();
+            rs.stats.total_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(t2 - t1).count();
+            return rs;
+        }
+
+        // Finds rows matching all the given conditions
+        std::vector<size_t> find_rows(const std::vector<std::pair<Condition, size_t>>& conditions, QueryStats& stats)
+        {
+            std::chrono::steady_clock::time_point t1 = std::chrono::steady_clock::now();
+            QueryPlan plan = plan_select(conditions);
+            stats.plan_ns += elapsed_ns(t1);
+
+            std::chrono::steady_clock::time_point t2 = std::chrono::steady_clock::now();
+            std::vector<size_t> included_rows = find_rows(plan, stats);
+            stats.scan_ns += elapsed_ns(t2);
+            return included_rows;
+        }
+
+        // Chooses the access path for the conditions by the estimated cost:
+        // a full scan or a range of one of the ordered indices.
+        // Only the column statistics are used here, no index is searched.
+        QueryPlan plan_select(const std::vector<std::pair<Condition, size_t>>& input)
+        {
+            QueryPlan plan;
+            plan.conditions = bound_prefixes(input);
+            const auto& conditions = plan.conditions;
+            plan.estimated_rows = (double)row_count;
+            plan.cost = row_count * QueryPlan::SCAN_ROW_COST;
+
+            std::vector<IndexScan> scans;
+            for (const auto& index : ordered_indices)
+            {
+                IndexScan scan;
+                scan.index = &index;
+                std::vector<const Condition*> conds;
+                for (size_t j = 0; j < conditions.size(); ++j)
+                {
+                    if (conditions[j].second != index.col)
+                        continue;
+                    if (conditions[j].first.pattern)
+                        continue;
+                    scan.conditions.push_back(j);
+                    conds.push_back(&conditions[j].first);
+                }
+                if (conds.empty())
+                    continue;
+
+                scan.rows = get_stats(index.col).selectivity(conds) * row_count;
+                scan.probes = 2 * conds.size() * std::log2((double)row_count + 1);
+                double cost = scan.probes * QueryPlan::PROBE_COST + scan.rows * QueryPlan::INDEX_ROW_COST;
+                if (cost < plan.cost)
+                {
+                    plan.path = AccessPath::INDEX_RANGE;
+                    plan.index = &index;
+                    plan.index_conditions = scan.conditions;
+                    plan.estimated_rows = scan.rows;
+                    plan.cost = cost;
+                }
+                scans.push_back(scan);
             }
 
-            // This list is then reduced so that only one range 
-            // remains for each index.
-            if (!ranges.empty())
+            // Ranges of several indices are intersected as row bitmaps: putting the rows of a range
+            // into a bitmap is cheap, and only the rows in all the ranges are fetched and checked.
+            // The most selective ranges are taken first, columns are assumed to be independent.
+            std::sort(scans.begin(), scans.end(), [](const IndexScan& x, const IndexScan& y) { return x.rows < y.rows; });
+            double fraction = 1;
+            double scans_cost = 0;
+            for (size_t k = 0; k < scans.size() && row_count > 0; ++k)
             {
-                std::sort(ranges.begin(), ranges.end());
-                std::vector<IndexRange> combined;
-                IndexRange r = ranges[0];
+                fraction *= scans[k].rows / row_count;
+                scans_cost += scans[k].probes * QueryPlan::PROBE_COST + scans[k].rows * QueryPlan::BITMAP_ROW_COST;
+                double rows = fraction * row_count;
+                double cost = scans_cost + rows * QueryPlan::INDEX_ROW_COST;
+                if (k > 0 && cost < plan.cost)
+                {
+                    plan.path = AccessPath::INDEX_INTERSECTION;
+                    plan.index = nullptr;
+                    plan.scans.assign(scans.begin(), scans.begin() + k + 1);
+                    plan.index_conditions.clear();
+                    for (const auto& scan : plan.scans)
+                        plan.index_conditions.insert(plan.index_conditions.end(), scan.conditions.begin(), scan.conditions.end());
+                    plan.estimated_rows = rows;
+                    plan.cost = cost;
+                }
+            }
 
-                for (size_t i = 1; i < ranges.size(); ++i)
+            // A pattern containing three or more ordinary characters in a row
+            // is looked for only in the rows having all its trigrams
+            for (const auto& index : trigram_indices)
+            {
+                for (size_t j = 0; j < conditions.size(); ++j)
                 {
-                    if (ranges[i].index->col != r.index->col)
+                    if (conditions[j].second != index.col || !conditions[j].first.pattern)
+                        continue;
+                    std::vector<uint32_t> trigrams = TrigramIndex::trigrams(conditions[j].first.pattern->get_literals());
+                    if (trigrams.empty())
+                        continue;
+
+                    double rows = (double)index.estimate(trigrams);
+                    double cost = trigrams.size() * QueryPlan::PROBE_COST + rows * QueryPlan::INDEX_ROW_COST;
+                    if (cost < plan.cost)
                     {
-                        combined.push_back(r);
-                        r = ranges[i];
-                    }
-                    else
-                    {
-                        if (r.begin < ranges[i].begin)
-                            r.begin = ranges[i].begin;
-                        if (r.end > ranges[i].end)
-                            r.end = ranges[i].end;
+                        plan.path = AccessPath::TRIGRAM;
+                        plan.index = nullptr;
+                        plan.scans.clear();
+                        plan.trigram_index = &index;
+                        plan.trigrams = trigrams;
+                        plan.index_conditions = { j };
+                        plan.estimated_rows = rows;
+                        plan.cost = cost;
                     }
                 }
-                combined.push_back(r);
-                ranges.swap(combined);
-                // The ranges are then sorted in order of increasing range width - 
-                // the narrowest (and therefore most preferred) range is first.
-                std::sort(ranges.begin(), ranges.end(), [](const IndexRange &x, const IndexRange &y)
-                          { return IndexRange::compare_by_size(x, y); });
             }
 
-            if (!ranges.empty())
+            plan.checks = estimate_checks(plan);
+            return plan;
+        }
+
+        // Estimates of the conditions checked for every row: equality on a fixed-size column
+        // is checked before a range on a string column. The conditions used to find an index
+        // range are always true for the rows of the range.
+        std::vector<CheckEstimate> estimate_checks(const QueryPlan& plan)
+        {
+            std::vector<CheckEstimate> checks(plan.conditions.size());
+            if (checks.size() < 2)
+                return checks;
+            bool index_path = plan.path == AccessPath::INDEX_RANGE || plan.path == AccessPath::INDEX_INTERSECTION;
+            for (size_t c = 0; c < checks.size(); ++c)
             {
-                // select using a range obtained by ordered index -
-                // this can significantly narrow the range of rows that are checked.
-                IndexRange range = ranges[0];
-                for (size_t range_idx = range.begin; range_idx < range.end; ++range_idx)
+                const auto& cond = plan.conditions[c];
+                const Column& column = columns[cond.second];
+                if (cond.first.pattern)
+                    checks[c].cost = QueryPlan::PATTERN_CHECK_COST;
+                else if ((column.type == Type::STRING || column.type == Type::BYTES) && !column.is_dict)
+                    checks[c].cost = QueryPlan::STRING_CHECK_COST;
+                else
+                    checks[c].cost = QueryPlan::FIXED_CHECK_COST;
+                bool in_index = std::find(plan.index_conditions.begin(), plan.index_conditions.end(), c) != plan.index_conditions.end();
+                if (!(index_path && in_index))
+                    checks[c].selectivity = get_stats(cond.second).selectivity(cond.first);
+            }
+            return checks;
+        }
+
+        // A prefix pattern on a string column is also a range: login like "ab%" is login >= "ab" && login < "ac".
+        // The range replaces the pattern if it only requires the prefix, otherwise the pattern is still checked.
+        std::vector<std::pair<Condition, size_t>> bound_prefixes(const std::vector<std::pair<Condition, size_t>>& conditions) const
+        {
+            std::vector<std::pair<Condition, size_t>> bounded;
+            for (const auto& c : conditions)
+            {
+                const auto& pattern = c.first.pattern;
+                std::string prefix = pattern && columns[c.second].type == Type::STRING ? pattern->get_prefix() : "";
+                if (prefix.empty())
+                {
+                    bounded.push_back(c);
+                    continue;
+                }
+                bounded.push_back(std::make_pair(Condition(Value(prefix), RelOp::GE), c.second));
+                std::string upper = LikePattern::prefix_successor(prefix);
+                if (!upper.empty())
+                    bounded.push_back(std::make_pair(Condition(Value(upper), RelOp::LT), c.second));
+                if (!pattern->is_prefix())
+                    bounded.push_back(c);
+            }
+            return bounded;
+        }
+
+        // Finds rows matching the condition using the plan
+        std::vector<size_t> find_rows(const QueryPlan& plan, QueryStats& stats)
+        {
+            std::vector<size_t> included_rows;
+            if (plan.path == AccessPath::NONE)
+                return included_rows;
+            if (plan.path == AccessPath::INDEX_UNION)
+            {
+                // every conjunction finds its rows by its own plan, the sorted lists are merged
+                QueryStats branch_stats;
+                for (const auto& branch : plan.branches)
                 {
-                    size_t row_idx = range.index->index[range_idx];
+                    std::vector<size_t> rows = find_rows(branch, branch_stats);
+                    std::vector<size_t> merged;
+                    merged.reserve(included_rows.size() + rows.size());
+                    std::set_union(included_rows.begin(), included_rows.end(), rows.begin(), rows.end(), std::back_inserter(merged));
+                    included_rows.swap(merged);
+                }
+                branch_stats.rows_matched = included_rows.size(); // rows matching several conjunctions are counted once
+                stats += branch_stats;
+                return included_rows;
+            }
+            if (plan.filter)
+            {
+                included_rows = filter_rows(plan.filter, stats);
+                stats.rows_examined += row_count;
+                stats.rows_matched += included_rows.size();
+                return included_rows;
+            }
 
-                    bool match = true;
-                    for (size_t c = 0; c < conditions.size() && match; ++c)
-                    {
-                        size_t col_idx = conditions[c].second;
-                        //if (col_idx == range.index->col)
-                        //    continue;
+            const auto& conditions = plan.conditions;
 
-                        const Condition &cond = conditions[c].first;
-                        match = cond.match(value_at(row_idx, columns[col_idx]));
+            // Conditions on dictionary-encoded columns are checked on codes
+            std::vector<CodeRange> code_ranges(conditions.size());
+            for (size_t c = 0; c < conditions.size(); ++c)
+            {
+                size_t col_idx = conditions[c].second;
+                if (columns[col_idx].is_dict)
+                    code_ranges[c] = CodeRange(dictionaries[col_idx].get(), conditions[c].first);
+            }
+            size_t comparisons = 0;
+            CheckOrder order(plan.checks.size() == conditions.size() ? plan.checks : std::vector<CheckEstimate>(conditions.size()));
+            auto match_row = [&](size_t row_idx)
+            {
+                const uint8_t* row_ptr = storage + row_idx * row_size;
+                bool result = true;
+                for (size_t c : order.get())
+                {
+                    size_t col_idx = conditions[c].second;
+                    ++comparisons;
+                    bool match = code_ranges[c].dict
+                        ? code_ranges[c].match(*((const uint32_t*)(row_ptr + columns[col_idx].offset)))
+                        : conditions[c].first.match(value_at(row_idx, col_idx));
+                    order.record(c, match);
+                    if (!match)
+                    {
+                        result = false;
+                        break;
                     }
+                }
+                order.next_row();
+                return result;
+            };
 
-                    if (match)
+            if (plan.path == AccessPath::INDEX_RANGE)
+            {
+                // select using a range obtained by ordered index -
+                // this can significantly narrow the range of rows that are checked
+                // (a condition x != 1 gives two ranges)
+                for (const auto& range : find_ranges(*plan.index, plan.index_conditions, conditions, stats))
+                {
+                    stats.rows_examined += range.size();
+                    for (size_t range_idx = range.begin; range_idx < range.end; ++range_idx)
                     {
-                        included_rows.push_back(row_idx);
+                        size_t row_idx = range.index->index[range_idx];
+                        if (match_row(row_idx))
+                        {
+                            add_row_id(included_rows, row_idx, stats);
+                        }
                     }
                 }
                 std::sort(included_rows.begin(), included_rows.end());
             }
+            else if (plan.path == AccessPath::INDEX_INTERSECTION)
+            {
+                // select using the ranges of several indices - the rows of every range
+                // are put into a bitmap, and only the rows in all of them are checked,
+                // already in ascending order
+                RowBitmap rows;
+                for (size_t s = 0; s < plan.scans.size(); ++s)
+                {
+                    const IndexScan& scan = plan.scans[s];
+                    RowBitmap bitmap = RowBitmap::from_ranges(find_ranges(*scan.index, scan.conditions, conditions, stats));
+                    rows = s == 0 ? std::move(bitmap) : rows.intersect(bitmap);
+                }
+                stats.rows_examined += rows.size();
+                rows.for_each([&](size_t row_idx)
+                {
+                    if (match_row(row_idx))
+                    {
+                        add_row_id(included_rows, row_idx, stats);
+                    }
+                });
+            }
+            else if (plan.path == AccessPath::TRIGRAM)
+            {
+                // select using a trigram index - only the rows containing all the trigrams
+                // of the pattern are checked, in ascending order
+                std::vector<size_t> candidates = plan.trigram_index->candidates(plan.trigrams);
+                stats.index_probes += plan.trigrams.size();
+                stats.rows_examined += candidates.size();
+                for (size_t row_idx : candidates)
+                {
+                    if (match_row(row_idx))
+                    {
+                        add_row_id(included_rows, row_idx, stats);
+                    }
+                }
+            }
             else
             {
-                // select without using indices - check from the first to the last row.
-                for (size_t row_idx = 0; row_idx < row_count; ++row_idx)
+                // select without using indices - check from the first to the last row,
+                // skipping the blocks which cannot match according to the zone maps
+                // and Bloom filters.
+                std::vector<std::pair<const ZoneMap*, const Condition*>> zone_conds;
+                std::vector<std::pair<const BloomFilter*, const Condition*>> bloom_conds;
+                for (const auto& c : conditions)
                 {
+                    const ZoneMap* zone_map = get_zone_map(c.second);
+                    if (zone_map)
+                        zone_conds.push_back(std::make_pair(zone_map, &c.first));
+                    const BloomFilter* filter = get_bloom_filter(c.second);
+                    if (filter && c.first.op == RelOp::EQ)
+                        bloom_conds.push_back(std::make_pair(filter, &c.first));
+                }
 
-                    bool match = true;
-                    for (size_t c = 0; c < conditions.size() && match; ++c)
+                for (size_t block_begin = 0; block_begin < row_count; block_begin += ZoneMap::BLOCK_SIZE)
+                {
+                    size_t block = block_begin / ZoneMap::BLOCK_SIZE;
+                    bool skip = false;
+                    for (size_t z = 0; z < zone_conds.size() && !skip; ++z)
                     {
-                        const Condition &cond = conditions[c].first;
-                        size_t col_idx = conditions[c].second;
-                        match = cond.match(value_at(row_idx, columns[col_idx]));
+                        skip = !zone_conds[z].first->may_match(block, *zone_conds[z].second);
                     }
+                    for (size_t b = 0; b < bloom_conds.size() && !skip; ++b)
+                    {
+                        skip = !bloom_conds[b].first->may_contain(block, bloom_conds[b].second->that);
+                    }
+                    if (skip)
+                        continue;
 
-                    if (match)
+                    size_t block_end = std::min(row_count, block_begin + ZoneMap::BLOCK_SIZE);
+                    stats.rows_examined += block_end - block_begin;
+                    for (size_t row_idx = block_begin; row_idx < block_end; ++row_idx)
                     {
-                        included_rows.push_back(row_idx);
+                        if (match_row(row_idx))
+                        {
+                            add_row_id(included_rows, row_idx, stats);
+                        }
                     }
                 }
             }
 
-            make_resultset(included_rows, rs);
-            std::chrono::steady_clock::time_point t2 = std::chrono::steady_clock::now();
-            rs.time_ms = std::chrono::duration_cast<std::chrono::milliseconds>(t2 - t1).count();
-            return rs;
+            stats.comparisons += comparisons;
+            stats.rows_matched += included_rows.size();
+            return included_rows;
         }
 
-        // Select specific columns based on conditions 
-        // given as Abstract Syntax Tree.
-        ResultSet select(const std::vector<std::string>& cols, ASTNode* ast)
-        {            
+        // Disjoint ranges of the index matching the conditions on its column in ascending order:
+        // binary search is applied to the index for every condition and the results are intersected
+        std::vector<IndexRange> find_ranges(const OrderedIndex& index, const std::vector<size_t>& index_conditions,
+            const std::vector<std::pair<Condition, size_t>>& conditions, QueryStats& stats)
+        {
+            std::vector<IndexRange> ranges = { IndexRange(&index, 0, index.index.size()) };
+            for (size_t j : index_conditions)
+            {
+                std::vector<IndexRange> next;
+                for (const auto& r : select_by_index(index, conditions[j].first, &stats))
+                {
+                    for (const auto& range : ranges)
+                    {
+                        size_t begin = std::max(range.begin, r.begin);
+                        size_t end = std::min(range.end, r.end);
+                        if (begin < end)
+                            next.push_back(IndexRange(&index, begin, end));
+                    }
+                }
+                ranges.swap(next);
+            }
+            return ranges;
+        }
+
+        // Appends the row to the list of found rows, counting the reallocations of the list
+        static void add_row_id(std::vector<size_t>& rows, size_t row_idx, QueryStats& stats)
+        {
+            if (rows.size() == rows.capacity())
+                stats.allocations++;
+            rows.push_back(row_idx);
+        }
+
+        // Finds rows matching the condition given as Abstract Syntax Tree
+        std::vector<size_t> find_rows(ASTNode* ast, QueryStats& stats)
+        {
             std::chrono::steady_clock::time_point t1 = std::chrono::steady_clock::now();
-            ResultSet rs = init_result_set(cols);
-            std::vector<size_t> included_rows;
+            QueryPlan plan = plan_select(ast);
+            stats.plan_ns += elapsed_ns(t1);
 
-            try
+            std::chrono::steady_clock::time_point t2 = std::chrono::steady_clock::now();
+            std::vector<size_t> included_rows = find_rows(plan, stats);
+            stats.scan_ns += elapsed_ns(t2);
+            return included_rows;
+        }
+
+        // Makes the plan for the condition given as Abstract Syntax Tree.
+        // The tree is not changed, the plan may refer to it.
+        QueryPlan plan_select(ASTNode* ast)
+        {
+            // Check the condition
+            SymbolVisitor visitor;
+            const auto& symbols = visitor.visit(ast);
+            for (const auto& item : symbols)
             {
-                // Check the column list
-                for (const auto& col_name : cols)
+                if (mapping.count(item.first) == 0)
+                    throw std::runtime_error("Unknown symbol \"" + item.first + "\" in the condition.");
+            }
+
+            // Try to convert the condition to the simple form like
+            // x < 1 && y > 2 && z = 3 && ...
+            if (is_cond_index_friendly(ast) && is_condition_simple(ast))
+            {
+                std::vector<std::pair<Condition, size_t>> conditions;
+                if (!to_conditions(ast, mapping, conditions))
                 {
-                    if (mapping.count(col_name) == 0)
-                        throw std::runtime_error("Unknown column \"" + col_name + "\" in the column list.");
+                    QueryPlan plan;
+                    plan.path = AccessPath::NONE;
+                    return plan;
                 }
-                // Check the condition
-                SymbolVisitor visitor;
-                const auto& symbols = visitor.visit(ast);
-                for (const auto& item : symbols)
+                return plan_select(conditions);
+            }
+
+            // Condition is not simple
+            QueryPlan plan;
+            plan.filter = ast;
+            plan.estimated_rows = (double)row_count;
+            plan.cost = row_count * QueryPlan::SCAN_ROW_COST;
+            plan_union(ast, plan);
+            return plan;
+        }
+
+        // A disjunction of simple conjunctions (x < 10 || x > 990 && y) may be found as the union
+        // of the rows of the conjunctions, each planned separately. "and" is distributed over "or"
+        // while the normal form is small. The union is not used if a conjunction needs a full scan.
+        void plan_union(ASTNode* ast, QueryPlan& plan)
+        {
+            auto disjuncts = to_dnf(ast, QueryPlan::MAX_DISJUNCTS);
+            if (disjuncts.size() < 2)
+                return;
+
+            std::vector<QueryPlan> branches;
+            double rows = 0;
+            double cost = 0;
+            for (const auto& terms : disjuncts)
+            {
+                for (ASTNode* term : terms)
                 {
-                    if (mapping.count(item.first) == 0)
-                        throw std::runtime_error("Unknown symbol \"" + item.first + "\" in the condition.");
+                    if (!is_expr_simple(term))
+                        return;
                 }
-                
-                // Try to convert the condition to the simple form like
-                // x < 1 && y > 2 && z = 3 && ...
-                if (is_cond_index_friendly(ast) && is_condition_simple(ast))
-                {
-                    bool select_nothing = false;
-                    std::vector<ASTNode*> terms = split_cond_by_and(ast);
-                    // make simple cond
-                    std::vector<std::pair<Condition, size_t>> conditions;
-                    for (auto& term : terms)
-                    {
-                        InternalNode* internal_node = dynamic_cast<InternalNode*>(term);
-                        if (!internal_node)
-                        {
-                            LeafNode* leaf = dynamic_cast<LeafNode*>(term);
-                            if (!leaf->id.empty())
-                            {
-                                size_t col = mapping.at(leaf->id);
-                                Condition cond(Value(true), RelOp::EQ);
-                                conditions.push_back(std::make_pair(cond, col));
-                            }
-                            else 
-                            {
-                                bool value = leaf->value.get<bool>();
-                                if (value)
-                                {
-                                    // select all
-                                }
-                                else
-                                {
-                                    // select nothing
-                                    select_nothing = true;
-                                }
-                            }
-                            
-                        }
-                        else
-                        {
-                            LeafNode* left = dynamic_cast<LeafNode*>(internal_node->left);
-                            LeafNode* right = dynamic_cast<LeafNode*>(internal_node->right);
-                            if (!left->id.empty())
-                            {
-                                size_t col = mapping.at(left->id);                                
-                                Condition cond(right->value, op_to_relop(internal_node->op));
-                                conditions.push_back(std::make_pair(cond, col));
-                            } 
-                            else
-                            {
-                                size_t col = mapping.at(right->id);
-                                Condition cond(left->value, op_to_relop(internal_node->op));
-                                conditions.push_back(std::make_pair(cond, col));
-                            }
-                        }
-                        delete term;
-                    }
+                std::vector<std::pair<Condition, size_t>> conditions;
+                if (!to_conditions(terms, mapping, conditions))
+                    continue; // always false
+                QueryPlan branch = plan_select(conditions);
+                if (branch.path == AccessPath::FULL_SCAN)
+                    return;
+                rows += branch.estimated_rows;
+                cost += branch.cost;
+                branches.push_back(std::move(branch));
+            }
+            if (cost < plan.cost)
+            {
+                plan.path = AccessPath::INDEX_UNION;
+                plan.filter = nullptr;
+                plan.branches = std::move(branches);
+                plan.estimated_rows = rows;
+                plan.cost = cost;
+            }
+        }
 
-                    if (!select_nothing)
-                    {
-                        return select(cols, conditions);
-                    }
-                    else
+        // Finds rows matching the condition which is not simple - evaluates it for every row
+        std::vector<size_t> filter_rows(ASTNode* ast, QueryStats& stats)
+        {
+            std::vector<size_t> included_rows;
+            SymbolVisitor visitor;
+            const auto& symbols = visitor.visit(ast);
+            for (size_t row_idx = 0; row_idx < row_count; ++row_idx)
+            {
+                // Replace symbols in the symbol table by the real values                    
+                for (auto& item : symbols)
+                {
+                    size_t col = mapping.at(item.first);
+                    for (auto& x : item.second)
                     {
-                        make_resultset(included_rows, rs);
+                        x->value = value_at(row_idx, col);
                     }
                 }
-                else
+
+                // Evaluate condition
+                EvalVisitor evaluator;
+                Value match = evaluator.visit(ast);
+
+                // Check result
+                if (match.get<bool>())
                 {
-                    // Condition is not simple
-                    for (size_t row_idx = 0; row_idx < row_count; ++row_idx)
-                    {
-                        // Replace symbols in the symbol table by the real values                    
-                        for (auto& item : symbols)
-                        {
-                            size_t col = mapping.at(item.first);
-                            for (auto& x : item.second)
-                            {
-                                x->value = value_at(row_idx, columns[col]);
-                            }
-                        }
+                    add_row_id(included_rows, row_idx, stats);
+                }
+            }
+            return included_rows;
+        }
 
-                        // Evaluate condition
-                        EvalVisitor evaluator;
-                        Value match = evaluator.visit(ast);
+        // Describes the plan as (property, value) pairs
+        std::vector<std::pair<std::string, std::string>> describe(const QueryPlan& plan) const
+        {
+            auto describe_conditions = [this, &plan](bool index_conditions)
+            {
+                std::string text;
+                for (size_t j = 0; j < plan.conditions.size(); ++j)
+                {
+                    bool is_index_condition = std::find(plan.index_conditions.begin(), plan.index_conditions.end(), j) != plan.index_conditions.end();
+                    if (is_index_condition != index_conditions)
+                        continue;
+                    const auto& cond = plan.conditions[j];
+                    if (!text.empty())
+                        text += " && ";
+                    text += columns[cond.second].name + " " + to_string(cond.first.op) + " " + to_string(cond.first.that);
+                }
+                return text;
+            };
 
-                        // Check result
-                        if (match.get<bool>())
-                        {
-                            included_rows.push_back(row_idx);
-                        }
-                    }
+            std::vector<std::pair<std::string, std::string>> items;
+            items.push_back(std::make_pair("access path", to_string(plan.path)));
+            if (plan.path == AccessPath::INDEX_RANGE)
+            {
+                items.push_back(std::make_pair("index", columns[plan.index->col].name));
+                items.push_back(std::make_pair("range", describe_conditions(true)));
+            }
+            if (plan.path == AccessPath::INDEX_INTERSECTION)
+            {
+                std::string names;
+                for (const auto& scan : plan.scans)
+                    names += (names.empty() ? "" : ", ") + columns[scan.index->col].name;
+                items.push_back(std::make_pair("index", names));
+                items.push_back(std::make_pair("range", describe_conditions(true)));
+            }
+            if (plan.path == AccessPath::INDEX_UNION)
+            {
+                for (size_t i = 0; i < plan.branches.size(); ++i)
+                {
+                    const QueryPlan& branch = plan.branches[i];
+                    std::string text;
+                    for (const auto& cond : branch.conditions)
+                        text += (text.empty() ? "" : " && ") + columns[cond.second].name + " " + to_string(cond.first.op) + " " + to_string(cond.first.that);
+                    items.push_back(std::make_pair("disjunct " + std::to_string(i + 1), to_string(branch.path) + ": " + text));
                 }
-                make_resultset(included_rows, rs);
             }
-            catch (std::runtime_error& e)
+            if (plan.path == AccessPath::TRIGRAM)
             {
-                rs.ok = false;
-                rs.error = e.what();
+                items.push_back(std::make_pair("index", columns[plan.trigram_index->col].name));
+                items.push_back(std::make_pair("pattern", describe_conditions(true)));
             }
+            if (plan.path != AccessPath::NONE)
+            {
+                items.push_back(std::make_pair("estimated rows", std::to_string((size_t)std::round(plan.estimated_rows))));
+                items.push_back(std::make_pair("cost", std::to_string((size_t)std::round(plan.cost))));
+                std::string predicates = plan.filter ? to_string(plan.filter) : describe_conditions(false);
+                items.push_back(std::make_pair("predicates", predicates.empty() ? "none" : predicates));
+            }
+            return items;
+        }
 
-            std::chrono::steady_clock::time_point t2 = std::chrono::steady_clock::now();
-            rs.time_ms = std::chrono::duration_cast<std::chrono::milliseconds>(t2 - t1).count();
+        // Makes a result of string columns with the given rows
+        static ResultSet make_text_result(const std::vector<std::string>& cols, const std::vector<std::vector<std::string>>& rows)
+        {
+            ResultSet rs;
+            for (size_t i = 0; i < cols.size(); ++i)
+            {
+                size_t width = 1;
+                for (const auto& row : rows)
+                    width = std::max(width, row[i].size() + 1);
+                rs.add_column(Column(Type::STRING, cols[i], (uint16_t)std::min(width, (size_t)UINT16_MAX)));
+            }
+            rs.row_count = rows.size();
+            rs.storage.reset(new uint8_t[rs.row_size * rs.row_count]());
+            for (size_t r = 0; r < rows.size(); ++r)
+            {
+                uint8_t* rs_row_ptr = rs.storage.get() + r * rs.row_size;
+                for (size_t i = 0; i < cols.size(); ++i)
+                {
+                    const Column& rs_col = rs.layout[i];
+                    size_t n = std::min(rows[r][i].size(), (size_t)rs_col.size - 1);
+                    std::copy(rows[r][i].begin(), rows[r][i].begin() + n, rs_row_ptr + rs_col.offset);
+                }
+            }
             return rs;
         }
 
@@ -405,94 +939,69 @@ namespace memdb
                 size_t col_idx = mapping.at(name);
                 const auto& this_column = columns[col_idx];
                 Column rs_column = this_column;
-                rs_column.offset = rs.row_size;
-                rs.row_size += rs_column.size;
-                rs.columns.push_back(name);
-                rs.mapping.insert(std::make_pair(name, rs_column));
+                rs_column.is_dict = false; // values are decoded into the result
+                rs.add_column(rs_column);
             }
             return rs;
         }
 
-        bool is_same_order(const std::vector<std::string>& cols)
+        // Plan of copying the result columns from the table rows
+        GatherPlan make_gather_plan(const ResultSet& rs) const
         {
-            if (cols.size() != columns.size())
-                return false;
-            for (size_t i = 0; i < cols.size(); ++i)
+            GatherPlan plan;
+            for (size_t i = 0; i < rs.layout.size(); ++i)
             {
-                if (cols[i] != columns[i].name)
-                    return false;
+                size_t col_idx = mapping.at(rs.columns[i]);
+                plan.add(columns[col_idx], rs.layout[i].offset, dictionaries[col_idx].get());
             }
-            return true;
+            return plan;
         }
 
         void make_resultset(const std::vector<size_t>& included_rows, ResultSet& rs)
         {            
+            std::chrono::steady_clock::time_point t1 = std::chrono::steady_clock::now();
             rs.row_count = included_rows.size();
             rs.storage.reset(new uint8_t[rs.row_size * rs.row_count]);
+            rs.stats.allocations++;
+            rs.stats.bytes_copied += (size_t)rs.row_size * rs.row_count;
 
-            if (is_same_order(rs.columns))
-            {
-                // include entire row
-                for (size_t rs_row_idx = 0; rs_row_idx < rs.row_count; ++rs_row_idx)
-                {
-                    size_t row_idx = included_rows[rs_row_idx];
-                    uint8_t* row_ptr = storage + row_idx * row_size;
-                    uint8_t* rs_row_ptr = rs.storage.get() + rs_row_idx * rs.row_size;                    
-                    std::copy(row_ptr, row_ptr + row_size, rs_row_ptr);
-                }
-            }
-            else
-            {
-                for (size_t rs_row_idx = 0; rs_row_idx < rs.row_count; ++rs_row_idx)
-                {
-                    size_t row_idx = included_rows[rs_row_idx];
-                    uint8_t* row_ptr = storage + row_idx * row_size;
-                    uint8_t* rs_row_ptr = rs.storage.get() + rs_row_idx * rs.row_size;
-                    for (const auto& col_name : rs.columns)
-                    {
-                        const auto& col = columns[mapping.at(col_name)];
-                        const auto& rs_col = rs.mapping.at(col_name);
-                        uint8_t* val_ptr = row_ptr + col.offset;
-                        uint8_t* rs_val_ptr = rs_row_ptr + rs_col.offset;
-                        std::copy(val_ptr, val_ptr + col.size, rs_val_ptr);
-                    }                    
-                }
-            }            
+            GatherPlan plan = make_gather_plan(rs);
+            plan.run(storage, row_size, included_rows, rs.storage.get(), rs.row_size);
+            rs.stats.materialize_ns += elapsed_ns(t1);
         }
         
-        std::vector<IndexRange> select_by_index(const OrderedIndex &index, const Condition &cond)
+        std::vector<IndexRange> select_by_index(const OrderedIndex &index, const Condition &cond, QueryStats* stats = nullptr)
         {
             if (cond.op == RelOp::EQ)
             {
-                size_t first = lower_bound(cond.that, index);
-                size_t second = upper_bound(cond.that, index);
+                size_t first = lower_bound(cond.that, index, stats);
+                size_t second = upper_bound(cond.that, index, stats);
                 return { IndexRange(&index, first, second) };                
             }
             if (cond.op == RelOp::NE)
             {
-                // TODO
-                size_t first = lower_bound(cond.that, index);
-                size_t second = upper_bound(cond.that, index);
+                size_t first = lower_bound(cond.that, index, stats);
+                size_t second = upper_bound(cond.that, index, stats);
                 return { IndexRange(&index, 0, first) , IndexRange(&index, second, row_count) };
             }            
             if (cond.op == RelOp::LT)
             {
-                size_t first = lower_bound(cond.that, index);
+                size_t first = lower_bound(cond.that, index, stats);
                 return { IndexRange(&index, 0, first) };
             }
             if (cond.op == RelOp::GT)
             {                
-                size_t first = upper_bound(cond.that, index);
+                size_t first = upper_bound(cond.that, index, stats);
                 return { IndexRange(&index, first, row_count) };
             }
             if (cond.op == RelOp::LE)
             {                
-                size_t first = upper_bound(cond.that, index);
+                size_t first = upper_bound(cond.that, index, stats);
                 return { IndexRange(&index, 0, first) };
             }  
             if (cond.op == RelOp::GE)
             {
-                size_t first = lower_bound(cond.that, index);
+                size_t first = lower_bound(cond.that, index, stats);
                 return { IndexRange(&index, first, row_count) };
             }
             return { IndexRange(&index, row_count, row_count) };
@@ -532,6 +1041,48 @@ namespace memdb
 
             std::chrono::steady_clock::time_point t2 = std::chrono::steady_clock::now();
             rs.time_ms = std::chrono::duration_cast<std::chrono::milliseconds>(t2 - t1).count();
+            rs.stats.total_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(t2 - t1).count();
+            return rs;
+        }
+
+        ResultSet create_trigram_index(const std::vector<std::string> &cols)
+        {
+            ResultSet rs;
+            std::chrono::steady_clock::time_point t1 = std::chrono::steady_clock::now();
+
+            try
+            {
+                for (const auto &col : cols)
+                {
+                    if (mapping.count(col) == 0)
+                    {
+                        throw std::runtime_error("No column named \"" + col + "\" was found.");
+                    }
+                    size_t col_idx = mapping.at(col);
+                    if (columns[col_idx].type != Type::STRING)
+                    {
+                        throw std::runtime_error("Trigram index is only allowed for string columns.");
+                    }
+                    if (get_trigram_index(col_idx))
+                    {
+                        throw std::runtime_error("Trigram index by \"" + col + "\" already exists.");
+                    }
+                }
+
+                for (const auto &col : cols)
+                {
+                    create_trigram_index(mapping.at(col));
+                }
+            }
+            catch (std::runtime_error &e)
+            {
+                rs.ok = false;
+                rs.error = e.what();
+            }
+
+            std::chrono::steady_clock::time_point t2 = std::chrono::steady_clock::now();
+            rs.time_ms = std::chrono::duration_cast<std::chrono::milliseconds>(t2 - t1).count();
+            rs.stats.total_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(t2 - t1).count();
             return rs;
         }
 
@@ -548,6 +1099,13 @@ namespace memdb
             write_int(out, row_count);
             out.write((const char *)storage, row_size * row_count);
 
+            // Write dictionaries
+            for (const auto &dict : dictionaries)
+            {
+                if (dict)
+                    dict->save_to_file(out);
+            }
+
             // Write ordered indices
             write_int(out, ordered_indices.size());
             for (const auto &idx : ordered_indices)
@@ -555,6 +1113,27 @@ namespace memdb
                 write_int(out, idx.col);
                 out.write((const char *)idx.index.data(), row_count * sizeof(size_t));
             }
+
+            // Write zone maps
+            write_int(out, zone_maps.size());
+            for (const auto &zone_map : zone_maps)
+            {
+                zone_map.save_to_file(out);
+            }
+
+            // Write Bloom filters
+            write_int(out, bloom_filters.size());
+            for (const auto &filter : bloom_filters)
+            {
+                filter.save_to_file(out);
+            }
+
+            // Write trigram indices
+            write_int(out, trigram_indices.size());
+            for (const auto &index : trigram_indices)
+            {
+                index.save_to_file(out);
+            }
         }
 
         static Table *load_from_file(std::istream &in)
@@ -575,6 +1154,13 @@ namespace memdb
             table->storage = new uint8_t[table->row_size * table->capacity];
             in.read((char *)table->storage, table->row_size * table->row_count);
 
+            // Read dictionaries
+            for (size_t i = 0; i < num_cols; ++i)
+            {
+                if (table->columns[i].is_dict)
+                    table->dictionaries[i] = Dictionary::load_from_file(in);
+            }
+
             // Read ordered indices
             size_t num_idx = read_int<size_t>(in);
             table->ordered_indices.reserve(num_idx);
@@ -589,25 +1175,150 @@ namespace memdb
                 table->ordered_indices.push_back(idx);
             }
 
+            // Read zone maps
+            size_t num_zone_maps = read_int<size_t>(in);
+            table->zone_maps.reserve(num_zone_maps);
+            for (size_t i = 0; i < num_zone_maps; ++i)
+            {
+                table->zone_maps.push_back(ZoneMap::load_from_file(in, table->columns));
+            }
+
+            // Read Bloom filters
+            size_t num_filters = read_int<size_t>(in);
+            table->bloom_filters.reserve(num_filters);
+            for (size_t i = 0; i < num_filters; ++i)
+            {
+                table->bloom_filters.push_back(BloomFilter::load_from_file(in, table->columns));
+            }
+
+            // Read trigram indices
+            size_t num_trigram = read_int<size_t>(in);
+            table->trigram_indices.reserve(num_trigram);
+            for (size_t i = 0; i < num_trigram; ++i)
+            {
+                table->trigram_indices.push_back(TrigramIndex::load_from_file(in));
+            }
+
             return table;
         }
 
-        Value value_at(size_t row, const Column &column) const
+        Value value_at(size_t row, size_t col) const
         {
+            const Column& column = columns[col];
             uint8_t* val_ptr = storage + row * row_size + column.offset;
+            if (column.is_dict)
+            {
+                const std::string& val = dictionaries[col]->decode(*((uint32_t*)val_ptr));
+                return Value(Type::STRING, (uint8_t*)val.c_str(), (uint16_t)(val.size() + 1));
+            }
             return Value(column.type, val_ptr, column.size);
         }
 
-        void add_row()
+        // Returns the statistics of the column, rebuilding them if they are stale.
+        // Concurrent selects may rebuild the statistics, so it is done under a lock.
+        const ColumnStats& get_stats(size_t col)
+        {
+            std::lock_guard<std::mutex> lock(stats_mutex);
+            if (stats.size() != columns.size())
+                stats.resize(columns.size());
+            ColumnStats& column_stats = stats[col];
+            if (column_stats.is_stale(row_count))
+            {
+                // evenly spaced sample of rows
+                size_t n = std::min(row_count, ColumnStats::SAMPLE_SIZE);
+                std::vector<Value> sample;
+                sample.reserve(n);
+                for (size_t i = 0; i < n; ++i)
+                {
+                    sample.push_back(make_owned(value_at(i * row_count / n, col)));
+                }
+                column_stats.build(sample, row_count);
+            }
+            return column_stats;
+        }
+
+        // Copies the value in the table format (decoded, if necessary) to the given location
+        void copy_value(size_t row, size_t col, uint8_t* out) const
+        {
+            Value val = value_at(row, col);
+            std::copy(val.val_ptr, val.val_ptr + val.size, out);
+        }
+
+        // Updates zone maps and Bloom filters with the values of the new row
+        void update_block_summaries(size_t row)
+        {
+            for (auto& zone_map : zone_maps)
+            {
+                zone_map.update(row, value_at(row, zone_map.col).val_ptr);
+            }
+            for (auto& filter : bloom_filters)
+            {
+                Value val = value_at(row, filter.col);
+                filter.add(row, val.val_ptr);
+            }
+        }
+
+        // Adds the new row to the ordered indices
+        void update_ordered_indices(size_t row)
+        {
+            for (size_t i = 0; i < ordered_indices.size(); ++i)
+            {
+                OrderedIndex& ordered_index = ordered_indices[i];
+                if (columns[ordered_index.col].is_auto)
+                {
+                    // just add to the end for autoicrement column
+                    ordered_index.index.push_back(row);
+                }
+                else
+                {
+                    // find a position to insert using binary search
+                    size_t first = upper_bound(value_at(row, ordered_index.col), ordered_index);
+                    ordered_index.index.insert(ordered_index.index.begin() + first, row);
+                }
+            }
+        }
+
+        // Adds the strings of the new row to the trigram indices
+        void update_trigram_indices(size_t row)
+        {
+            for (auto& index : trigram_indices)
+            {
+                Value val = value_at(row, index.col);
+                const char* s = (const char*)val.val_ptr;
+                index.add(row, std::string_view(s, strnlen(s, val.size)));
+            }
+        }
+
+        // Makes room for one more row in the storage
+        void reserve_row()
         {
             if (row_count == capacity)
             {
-                capacity *= 2;
+                capacity = std::max(capacity * 2, INITIAL_CAPACITY); // loaded tables may be empty
                 uint8_t *new_storage = new uint8_t[row_size * capacity];
-                std::copy(storage, storage + row_size * (capacity / 2), new_storage);
+                std::copy(storage, storage + row_size * row_count, new_storage);
                 delete[] storage;
                 storage = new_storage;
             }
+        }
+
+        // Shrinks the storage and the indices to the rows, the next insert grows them again
+        void compact()
+        {
+            if (capacity == row_count)
+                return;
+            capacity = row_count;
+            uint8_t *new_storage = new uint8_t[row_size * capacity];
+            std::copy(storage, storage + row_size * row_count, new_storage);
+            delete[] storage;
+            storage = new_storage;
+            for (auto &idx : ordered_indices)
+                idx.index.shrink_to_fit();
+        }
+
+        void add_row()
+        {
+            reserve_row();
             row_count++;
         }
 
@@ -673,8 +1384,43 @@ namespace memdb
             return nullptr;
         }
 
+        const ZoneMap* get_zone_map(size_t col_idx) const
+        {
+            for (const auto& zone_map : zone_maps)
+            {
+                if (zone_map.col == col_idx)
+                    return &zone_map;
+            }
+            return nullptr;
+        }
+
+        const TrigramIndex* get_trigram_index(size_t col_idx) const
+        {
+            for (const auto& index : trigram_indices)
+            {
+                if (index.col == col_idx)
+                    return &index;
+            }
+            return nullptr;
+        }
+
+        const BloomFilter* get_bloom_filter(size_t col_idx) const
+        {
+            for (const auto& filter : bloom_filters)
+            {
+                if (filter.col == col_idx)
+                    return &filter;
+            }
+            return nullptr;
+        }
+
         bool check_unique_value(const Value& val, size_t col_idx)
         {            
+            if (columns[col_idx].is_dict && !dictionaries[col_idx]->contains(val.get<std::string>()))
+            {
+                // every stored value is in the dictionary
+                return true;
+            }
             OrderedIndex* index_ptr = get_ordered_index(col_idx);
             if (index_ptr)
             {
@@ -682,12 +1428,27 @@ namespace memdb
                 size_t first = binary_search(val, *index_ptr);
                 return first == row_count;
             }
+            const BloomFilter* filter = get_bloom_filter(col_idx);
+            if (filter)
+            {
+                // check only the blocks where the value may be present
+                for (size_t block : filter->find_blocks(val))
+                {
+                    size_t block_end = std::min(row_count, (block + 1) * BloomFilter::BLOCK_SIZE);
+                    for (size_t row_idx = block * BloomFilter::BLOCK_SIZE; row_idx < block_end; ++row_idx)
+                    {
+                        if (value_at(row_idx, col_idx) == val)
+                            return false;
+                    }
+                }
+                return true;
+            }
             else
             {
                 // no index
                 for (size_t row_idx = 0; row_idx < row_count; ++row_idx)
                 {
-                    if (value_at(row_idx, columns[col_idx]) == val)
+                    if (value_at(row_idx, col_idx) == val)
                         return false;
                 }
                 return true;
@@ -708,30 +1469,38 @@ namespace memdb
             update_ordered_index(ordered_indices.back());
         } 
 
+        void create_trigram_index(size_t col)
+        {
+            trigram_indices.push_back(TrigramIndex(col));
+            for (size_t i = 0; i < row_count; ++i)
+            {
+                Value val = value_at(i, col);
+                const char* s = (const char*)val.val_ptr;
+                trigram_indices.back().add(i, std::string_view(s, strnlen(s, val.size)));
+            }
+        }
+
         void update_ordered_index(OrderedIndex& ordered_index)
         {            
             std::vector<size_t>& index = ordered_index.index;
-            const Column& c = columns[ordered_index.col];
-            uint8_t* st = storage;
-            uint16_t rsz = row_size;
-            std::sort(index.begin(), index.end(), [&c, st, rsz](size_t a, size_t b) {
-                Value val1 = Value(c.type, st + a * rsz + c.offset, c.size);
-                Value val2 = Value(c.type, st + b * rsz + c.offset, c.size);
-                return val1 < val2;
+            size_t col = ordered_index.col;
+            std::sort(index.begin(), index.end(), [this, col](size_t a, size_t b) {
+                return value_at(a, col) < value_at(b, col);
             });
         }
 
-        size_t lower_bound(const Value &val, const OrderedIndex &index) const
+        size_t lower_bound(const Value &val, const OrderedIndex &index, QueryStats* stats = nullptr) const
         {
-            const Column &column = columns[index.col];
             size_t first = 0;
             size_t last = index.index.size();
             int64_t count = (int64_t)last - first;
+            size_t comparisons = 0;
             while (count > 0)
             {
                 int64_t step = count / 2;
                 size_t mid = first + step;
-                Value it = value_at(index.index[mid], column);
+                Value it = value_at(index.index[mid], index.col);
+                ++comparisons;
                 if (it < val)
                 {
                     first = mid + 1;
@@ -742,20 +1511,26 @@ namespace memdb
                     count = step;
                 }
             }
+            if (stats)
+            {
+                stats->index_probes++;
+                stats->comparisons += comparisons;
+            }
             return first;
         }
 
-        size_t upper_bound(const Value &val, const OrderedIndex &index) const
+        size_t upper_bound(const Value &val, const OrderedIndex &index, QueryStats* stats = nullptr) const
         {
-            const Column &column = columns[index.col];
             size_t first = 0;
             size_t last = index.index.size();
             int64_t count = (int64_t)last - first;
+            size_t comparisons = 0;
             while (count > 0)
             {
                 int64_t step = count / 2;
                 size_t mid = first + step;
-                Value it = value_at(index.index[mid], column);
+                Value it = value_at(index.index[mid], index.col);
+                ++comparisons;
                 if (!(val < it))
                 {
                     first = mid + 1;
@@ -766,16 +1541,20 @@ namespace memdb
                     count = step;
                 }
             }
+            if (stats)
+            {
+                stats->index_probes++;
+                stats->comparisons += comparisons;
+            }
             return first;
         }
 
         size_t binary_search(const Value &val, const OrderedIndex &index) const
         {
-            const Column &column = columns[index.col];
             size_t first = lower_bound(val, index);
             if (first != index.index.size())
             {
-                if (!(val < value_at(index.index[first], column)))
+                if (!(val < value_at(index.index[first], index.col)))
                     return first;
             }
             return index.index.size();
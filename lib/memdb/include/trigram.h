@@ -0,0 +1,169 @@
+#pragma once
+
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <iostream>
+
+#include "base.h"
+#include "column.h"
+#include "utils.h"
+
+namespace memdb
+{
+
+    // Sorted row numbers compressed as varint deltas. Rows are appended in ascending order.
+    struct PostingList
+    {
+        std::vector<uint8_t> data;
+        size_t count = 0;
+        size_t last = 0;
+
+        void add(size_t row)
+        {
+            if (count > 0 && row == last)
+                return; // the trigram occurs several times in the row
+            size_t delta = count == 0 ? row : row - last;
+            while (delta >= 0x80)
+            {
+                data.push_back((uint8_t)(delta | 0x80));
+                delta >>= 7;
+            }
+            data.push_back((uint8_t)delta);
+            last = row;
+            ++count;
+        }
+
+        std::vector<size_t> decode() const
+        {
+            std::vector<size_t> rows;
+            rows.reserve(count);
+            size_t row = 0;
+            size_t pos = 0;
+            while (pos < data.size())
+            {
+                size_t delta = 0;
+                for (int shift = 0;; shift += 7)
+                {
+                    uint8_t byte = data[pos++];
+                    delta |= (size_t)(byte & 0x7f) << shift;
+                    if (byte < 0x80)
+                        break;
+                }
+                row += delta;
+                rows.push_back(row);
+            }
+            return rows;
+        }
+    };
+
+    // Inverted index of a string column: every trigram (three consecutive bytes)
+    // maps to the rows containing it. A substring of three or more characters can
+    // only be in the rows present in the lists of all its trigrams, so the lists
+    // are intersected to get the candidates, which are then checked.
+    struct TrigramIndex
+    {
+        size_t col;
+        std::unordered_map<uint32_t, PostingList> postings;
+
+        TrigramIndex(size_t col) : col(col) {}
+
+        static uint32_t trigram(const char *s)
+        {
+            return ((uint32_t)(uint8_t)s[0] << 16) | ((uint32_t)(uint8_t)s[1] << 8) | (uint8_t)s[2];
+        }
+
+        void add(size_t row, std::string_view val)
+        {
+            for (size_t i = 0; i + 3 <= val.size(); ++i)
+                postings[trigram(val.data() + i)].add(row);
+        }
+
+        // Distinct trigrams of the strings
+        static std::vector<uint32_t> trigrams(const std::vector<std::string> &literals)
+        {
+            std::vector<uint32_t> result;
+            for (const auto &s : literals)
+            {
+                for (size_t i = 0; i + 3 <= s.size(); ++i)
+                    result.push_back(trigram(s.data() + i));
+            }
+            std::sort(result.begin(), result.end());
+            result.erase(std::unique(result.begin(), result.end()), result.end());
+            return result;
+        }
+
+        // Upper bound of the number of rows containing all the trigrams (the shortest list)
+        size_t estimate(const std::vector<uint32_t> &grams) const
+        {
+            size_t n = SIZE_MAX;
+            for (uint32_t g : grams)
+            {
+                auto it = postings.find(g);
+                n = std::min(n, it == postings.end() ? 0 : it->second.count);
+            }
+            return n;
+        }
+
+        // Rows containing all the trigrams (and maybe some rows containing only a part of them).
+        // Lists are intersected from the shortest one; intersecting stops when the candidates
+        // are much fewer than the next list, checking them is cheaper than decoding it.
+        std::vector<size_t> candidates(const std::vector<uint32_t> &grams) const
+        {
+            std::vector<const PostingList *> lists;
+            for (uint32_t g : grams)
+            {
+                auto it = postings.find(g);
+                if (it == postings.end())
+                    return {};
+                lists.push_back(&it->second);
+            }
+            std::sort(lists.begin(), lists.end(), [](const PostingList *x, const PostingList *y) { return x->count < y->count; });
+
+            std::vector<size_t> rows = lists.front()->decode();
+            for (size_t i = 1; i < lists.size() && rows.size() * 16 >= lists[i]->count; ++i)
+            {
+                std::vector<size_t> other = lists[i]->decode();
+                std::vector<size_t> both;
+                std::set_intersection(rows.begin(), rows.end(), other.begin(), other.end(), std::back_inserter(both));
+                rows.swap(both);
+            }
+            return rows;
+        }
+
+        void save_to_file(std::ostream &out) const
+        {
+            write_int(out, col);
+            write_int(out, postings.size());
+            for (const auto &p : postings)
+            {
+                write_int(out, p.first);
+                write_int(out, p.second.count);
+                write_int(out, p.second.last);
+                write_int(out, p.second.data.size());
+                out.write((const char *)p.second.data.data(), p.second.data.size());
+            }
+        }
+
+        static TrigramIndex load_from_file(std::istream &in)
+        {
+            TrigramIndex index(read_int<size_t>(in));
+            size_t n = read_int<size_t>(in);
+            index.postings.reserve(n);
+            for (size_t i = 0; i < n; ++i)
+            {
+                uint32_t gram = read_int<uint32_t>(in);
+                PostingList &list = index.postings[gram];
+                list.count = read_int<size_t>(in);
+                list.last = read_int<size_t>(in);
+                list.data.resize(read_int<size_t>(in));
+                in.read((char *)list.data.data(), list.data.size());
+            }
+            return index;
+        }
+    };
+
+}
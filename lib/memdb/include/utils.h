@@ -2,6 +2,8 @@
 
 #include <stdexcept>
 #include <string>
+#include <string_view>
+#include <charconv>
 #include <iostream>
 
 #include "base.h"
@@ -11,7 +13,7 @@
 
 namespace memdb
 {
-	inline bool strcmpi(const std::string &a, const std::string &b)
+	inline bool strcmpi(std::string_view a, std::string_view b)
 	{
 		if (a.length() != b.length())
 			return false;
@@ -73,11 +75,20 @@ namespace memdb
 		return b;
 	}
 
+	inline int32_t lex_to_int(std::string_view text)
+	{
+		int32_t val = 0;
+		auto result = std::from_chars(text.data(), text.data() + text.size(), val);
+		if (result.ec != std::errc() || result.ptr != text.data() + text.size())
+			throw std::runtime_error("Invalid integer literal " + std::string(text) + ".");
+		return val;
+	}
+
 	inline Value lex_to_value(const Lexem& lexem)
 	{
 		if (lexem.type == LexemType::INT_LIT)
 		{
-			return Value((int32_t)std::stoi(lexem.value));
+			return Value(lex_to_int(lexem.value));
 		}
 		if (lexem.type == LexemType::BOOL_LIT)
 		{
@@ -85,7 +96,7 @@ namespace memdb
 		}
 		if (lexem.type == LexemType::STR_LIT)
 		{
-			return Value(lexem.value);
+			return Value(std::string(lexem.value));
 		}
 		if (lexem.type == LexemType::BT_LIT)
 		{
@@ -120,6 +131,10 @@ namespace memdb
 			return Op::LE;
 		case LexemType::GE:
 			return Op::GE;
+		case LexemType::LIKE:
+			return Op::LIKE;
+		case LexemType::STARTS_WITH:
+			return Op::STARTS_WITH;
 		case LexemType::AND:
 			return Op::AND;
 		case LexemType::OR:
@@ -149,7 +164,9 @@ namespace memdb
 			type == LexemType::GE ||
 			type == LexemType::LE ||
 			type == LexemType::GT ||
-			type == LexemType::LT;
+			type == LexemType::LT ||
+			type == LexemType::LIKE ||
+			type == LexemType::STARTS_WITH;
 	}
 
 	inline bool is_math_op(const Lexem& lex)
@@ -179,7 +196,9 @@ namespace memdb
 			op == Op::GE ||
 			op == Op::LE ||
 			op == Op::GT ||
-			op == Op::LT;
+			op == Op::LT ||
+			op == Op::LIKE ||
+			op == Op::STARTS_WITH;
 	}
 
 	inline bool is_math_op(Op op)
@@ -223,7 +242,29 @@ namespace memdb
 			return RelOp::LE;
 		case memdb::Op::GE:
 			return RelOp::GE;
+		case memdb::Op::LIKE:
+			return RelOp::LIKE;
+		case memdb::Op::STARTS_WITH:
+			return RelOp::STARTS_WITH;
 		}
 		throw std::runtime_error("No conversion");
 	}
+
+	// Relation with the operands swapped: 5 < x is x > 5
+	inline RelOp mirror(RelOp op)
+	{
+		switch (op)
+		{
+		case RelOp::LT:
+			return RelOp::GT;
+		case RelOp::GT:
+			return RelOp::LT;
+		case RelOp::LE:
+			return RelOp::GE;
+		case RelOp::GE:
+			return RelOp::LE;
+		default:
+			return op;
+		}
+	}
 }
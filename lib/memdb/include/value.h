@@ -174,6 +174,33 @@ namespace memdb
         return Bytes(val_ptr, val_ptr + size);
     }
 
+    // Compares two values stored in the raw (table) format without
+    // creating Value objects. Returns negative, zero or positive number.
+    inline int compare_raw(Type type, const uint8_t *lhs, const uint8_t *rhs, uint16_t size)
+    {
+        if (type == Type::INT)
+        {
+            int32_t x = *((const int32_t *)lhs);
+            int32_t y = *((const int32_t *)rhs);
+            return (x > y) - (x < y);
+        }
+        if (type == Type::BOOL)
+        {
+            bool x = *((const bool *)lhs);
+            bool y = *((const bool *)rhs);
+            return (int)x - (int)y;
+        }
+        if (type == Type::STRING)
+        {
+            return strncmp((const char *)lhs, (const char *)rhs, size);
+        }
+        if (type == Type::BYTES)
+        {
+            return memcmp(lhs, rhs, size);
+        }
+        throw std::runtime_error("Not implemented yet");
+    }
+
     bool operator==(const Value &lhs, const Value &rhs)
     {
         if (lhs.type == Type::INT)
@@ -5,200 +5,414 @@
 #include <set>
 #include <map>
 #include <vector>
+#include <algorithm>
+#include <cstdint>
 
 #include "lexem.h"
 #include "ast.h"
 #include "value.h"
 #include "utils.h"
+#include "pattern.h"
 
 namespace memdb
 {
+	// Folds constant subexpressions, new nodes are allocated in the arena of the query
 	class CondSimplifyVisitor
 	{
+		ASTArena& arena;
+
 	public:
-		CondSimplifyVisitor() {}
+		// Subtrees dropped by the simplification (x > 5 && x < 3 is false). The planner does not
+		// see them, they are checked against the table as the condition is (Database::check_removed).
+		std::vector<ASTNode*> removed;
+
+		CondSimplifyVisitor(ASTArena& arena) : arena(arena) {}
 
 		ASTNode* visit(ASTNode* root)
 		{
-			InternalNode* op_node;
-			if (op_node = dynamic_cast<InternalNode*>(root))
+			if (root == nullptr || root->kind == NodeKind::LEAF)
+				return root;
+
+			InternalNode* op_node = static_cast<InternalNode*>(root);
+			op_node->left = visit(op_node->left);
+			op_node->right = visit(op_node->right);
+			LeafNode* leaf1, * leaf2;
+			if ((leaf1 = as_leaf(op_node->left)) && (leaf2 = as_leaf(op_node->right)))
 			{
-				op_node->left = visit(op_node->left);
-				op_node->right = visit(op_node->right);
-				LeafNode* leaf1, * leaf2;
-				if ((leaf1 = dynamic_cast<LeafNode*>(op_node->left)) && (leaf2 = dynamic_cast<LeafNode*>(op_node->right)))
+				if (!leaf1->value.is_empty() && !leaf2->value.is_empty())
 				{
-					if (!leaf1->value.is_empty() && !leaf2->value.is_empty())
-					{
-						const Value& val1 = leaf1->value;
-						const Value& val2 = leaf2->value;
-						if (val1.type != val2.type)
-							throw std::runtime_error("Mismatch of operand types in expression");
+					const Value& val1 = leaf1->value;
+					const Value& val2 = leaf2->value;
+					if (val1.type != val2.type)
+						throw std::runtime_error("Mismatch of operand types in expression");
 
-						Type value_type = val1.type;
-						Op op_type = op_node->op;
+					Type value_type = val1.type;
+					Op op_type = op_node->op;
 
-						if (is_math_op(op_type))
+					if (is_math_op(op_type))
+					{
+						if (value_type == Type::INT)
 						{
-							if (value_type == Type::INT)
-							{
-								int32_t result = 0;
-								int32_t v1 = val1.get<int32_t>();
-								int32_t v2 = val2.get<int32_t>();
+							int32_t result = 0;
+							int32_t v1 = val1.get<int32_t>();
+							int32_t v2 = val2.get<int32_t>();
 
-								if (op_type == Op::PLS)
-								{
-									result = v1 + v2;
-								}
-								if (op_type == Op::MNS)
-								{
-									result = v1 - v2;
-								}
-								if (op_type == Op::MUL)
-								{
-									result = v1 * v2;
-								}
-								if (op_type == Op::DIV)
-								{
-									result = v1 / v2;
-								}
-								if (op_type == Op::MOD)
-								{
-									result = v1 % v2;
-								}
-								//Lexem lexem;
-								//lexem.type = LexemType::INT_LIT;
-								//lexem.value = std::to_string(result);
-								delete root;
-								return new LeafNode(Value(result));
-							}
-							else if (value_type == Type::STRING && op_type == Op::PLS)
+							if (op_type == Op::PLS)
 							{
-								std::string v1 = val1.get<std::string>();
-								std::string v2 = val2.get<std::string>();
-								std::string result = v1 + v2;
-								//Lexem lexem;
-								//lexem.type = LexemType::STR_LIT;
-								//lexem.value = result;
-								delete root;
-								return new LeafNode(Value(result));
+								result = v1 + v2;
 							}
-							else
+							if (op_type == Op::MNS)
 							{
-								throw std::runtime_error("Mismatch between operation and operands in expression");
+								result = v1 - v2;
 							}
-						}
-						else if (is_rel_op(op_type))
-						{
-							bool result = false;
-
-							if (op_type == Op::EQ)
+							if (op_type == Op::MUL)
 							{
-								result = val1 == val2;
+								result = v1 * v2;
 							}
-							if (op_type == Op::NE)
+							if (op_type == Op::DIV)
 							{
-								result = val1 != val2;
+								result = v1 / v2;
 							}
-							if (op_type == Op::LT)
+							if (op_type == Op::MOD)
 							{
-								result = val1 < val2;
+								result = v1 % v2;
 							}
-							if (op_type == Op::GT)
+							//Lexem lexem;
+							//lexem.type = LexemType::INT_LIT;
+							//lexem.value = std::to_string(result);
+							return arena.leaf(Value(result));
+						}
+						else if (value_type == Type::STRING && op_type == Op::PLS)
+						{
+							std::string v1 = val1.get<std::string>();
+							std::string v2 = val2.get<std::string>();
+							std::string result = v1 + v2;
+							//Lexem lexem;
+							//lexem.type = LexemType::STR_LIT;
+							//lexem.value = result;
+							return arena.leaf(Value(result));
+						}
+						else
+						{
+							throw std::runtime_error("Mismatch between operation and operands in expression");
+						}
+					}
+					else if (is_rel_op(op_type))
+					{
+						//Lexem lexem;
+						//lexem.type = LexemType::BOOL_LIT;
+						//lexem.value = result ? "true" : "false";
+						return arena.leaf(Value(compare(val1, op_type, val2)));
+					}
+					else if (is_logic_op(op_type))
+					{
+						if (value_type == Type::BOOL)
+						{
+							bool result = 0;
+							bool v1 = val1.get<bool>();
+							bool v2 = val2.get<bool>();
+
+							if (op_type == Op::AND)
 							{
-								result = val1 > val2;
+								result = v1 && v2;
 							}
-							if (op_type == Op::LE)
+							if (op_type == Op::OR)
 							{
-								result = val1 <= val2;
+								result = v1 || v2;
 							}
-							if (op_type == Op::GE)
+							if (op_type == Op::XOR)
 							{
-								result = val1 >= val2;
+								result = v1 != v2;
 							}
-
 							//Lexem lexem;
 							//lexem.type = LexemType::BOOL_LIT;
 							//lexem.value = result ? "true" : "false";
-							delete root;
-							return new LeafNode(Value(result));
+							return arena.leaf(Value(result));
 						}
-						else if (is_logic_op(op_type))
+						else
 						{
-							if (value_type == Type::BOOL)
-							{
-								bool result = 0;
-								bool v1 = val1.get<bool>();
-								bool v2 = val2.get<bool>();
-
-								if (op_type == Op::AND)
-								{
-									result = v1 && v2;
-								}
-								if (op_type == Op::OR)
-								{
-									result = v1 || v2;
-								}
-								if (op_type == Op::XOR)
-								{
-									result = v1 != v2;
-								}
-								//Lexem lexem;
-								//lexem.type = LexemType::BOOL_LIT;
-								//lexem.value = result ? "true" : "false";
-								delete root;
-								return new LeafNode(Value(result));
-							}
-							else
-							{
-								throw std::runtime_error("Logical operations are only allowed on logical values");
-							}
+							throw std::runtime_error("Logical operations are only allowed on logical values");
 						}
 					}
 				}
-				if ((leaf1 = dynamic_cast<LeafNode*>(op_node->left)) && op_node->right == nullptr)
+			}
+			if ((leaf1 = as_leaf(op_node->left)) && op_node->right == nullptr)
+			{
+				// Unary op
+				if (!leaf1->value.is_empty())
 				{
-					// Unary op
-					if (!leaf1->value.is_empty())
+					const Value& val1 = leaf1->value;
+					Type value_type = val1.type;
+					Op op_type = op_node->op;
+					if (value_type == Type::INT && (op_type == Op::PLS || op_type == Op::MNS))
 					{
-						const Value& val1 = leaf1->value;
-						Type value_type = val1.type;
-						Op op_type = op_node->op;
-						if (value_type == Type::INT && (op_type == Op::PLS || op_type == Op::MNS))
+						int32_t result = val1.get<int32_t>();
+						if (op_type == Op::MNS)
 						{
-							int32_t result = val1.get<int32_t>();
-							if (op_type == Op::MNS)
-							{
-								result = -result;
-							}
-							//Lexem lexem;
-							//lexem.type = LexemType::INT_LIT;
-							//lexem.value = std::to_string(result);
-							delete root;
-							return new LeafNode(Value(result));
-						}
-						else if (value_type == Type::BOOL && op_type == Op::NOT)
-						{
-							bool result = !val1.get<bool>();
-							//Lexem lexem;
-							//lexem.type = LexemType::BOOL_LIT;
-							//lexem.value = result ? "true" : "false";
-							delete root;
-							return new LeafNode(Value(result));
-						}
-						else
-						{
-							throw std::runtime_error("Mismatch between unary operation and operand in expression");
+							result = -result;
 						}
+						//Lexem lexem;
+						//lexem.type = LexemType::INT_LIT;
+						//lexem.value = std::to_string(result);
+						return arena.leaf(Value(result));
+					}
+					else if (value_type == Type::BOOL && op_type == Op::NOT)
+					{
+						bool result = !val1.get<bool>();
+						//Lexem lexem;
+						//lexem.type = LexemType::BOOL_LIT;
+						//lexem.value = result ? "true" : "false";
+						return arena.leaf(Value(result));
+					}
+					else
+					{
+						throw std::runtime_error("Mismatch between unary operation and operand in expression");
 					}
 				}
-				return op_node;
 			}
-			else if (dynamic_cast<LeafNode*>(root))
+			return normalize(op_node);
+		}
+
+	private:
+		// Rewrites the node with folded children to the form the planner can use for indices:
+		// the column on the left of a comparison, constants moved to the literal side of an int32
+		// comparison (x + 1 > 5 is x > 4), negations pushed down to the comparisons, redundant
+		// bounds of a conjunction dropped (x > 3 && x > 5 is x > 5), boolean literals removed.
+		ASTNode* normalize(InternalNode* node)
+		{
+			if (node->op == Op::NOT && node->right == nullptr)
+				return negate(node->left);
+			if (is_rel_op(node->op))
+				return normalize_relation(node);
+			if (node->op == Op::AND || node->op == Op::OR)
+				return normalize_logic(node);
+			return node;
+		}
+
+		ASTNode* normalize_relation(InternalNode* node)
+		{
+			if (node->op == Op::LIKE || node->op == Op::STARTS_WITH)
+				return node;
+			if (is_literal(node->left) && !is_literal(node->right))
+			{
+				std::swap(node->left, node->right);
+				node->op = mirror(node->op);
+			}
+			// e + c op k is e op k - c, e - c op k is e op k + c, c - e op k is e mirror(op) c - k
+			LeafNode* k = as_leaf(node->right);
+			InternalNode* expr;
+			while (is_int_literal(k) && (expr = as_internal(node->left)) && expr->right != nullptr &&
+				(expr->op == Op::PLS || expr->op == Op::MNS))
 			{
-				// do nothing
+				int64_t value = k->value.get<int32_t>();
+				ASTNode* rest;
+				if (is_int_literal(expr->right))
+				{
+					int64_t c = as_leaf(expr->right)->value.get<int32_t>();
+					value = expr->op == Op::PLS ? value - c : value + c;
+					rest = expr->left;
+				}
+				else if (is_int_literal(expr->left))
+				{
+					int64_t c = as_leaf(expr->left)->value.get<int32_t>();
+					value = expr->op == Op::PLS ? value - c : c - value;
+					rest = expr->right;
+				}
+				else
+					break;
+				if (value < INT32_MIN || value > INT32_MAX)
+					break;
+				if (expr->op == Op::MNS && is_int_literal(expr->left))
+					node->op = mirror(node->op);
+				node->left = rest;
+				node->right = k = arena.leaf(Value((int32_t)value));
+			}
+			return node;
+		}
+
+		// e && true is e, e && false is false, e || true is true, e || false is e
+		ASTNode* normalize_logic(InternalNode* node)
+		{
+			for (ASTNode* side : { node->left, node->right })
+			{
+				LeafNode* leaf = as_leaf(side);
+				if (leaf && leaf->id.empty() && leaf->value.type == Type::BOOL)
+				{
+					bool value = leaf->value.get<bool>();
+					if (value == (node->op == Op::OR))
+					{
+						removed.push_back(side == node->left ? node->right : node->left);
+						return leaf;
+					}
+					return side == node->left ? node->right : node->left;
+				}
+			}
+			return node->op == Op::AND ? merge_ranges(node) : node;
+		}
+
+		// Pushes the negation of the expression down: !(x < 1 || y) is x >= 1 && !y
+		ASTNode* negate(ASTNode* root)
+		{
+			InternalNode* node = as_internal(root);
+			if (!node)
+				return arena.internal(Op::NOT, root, nullptr);
+			if (node->op == Op::NOT && node->right == nullptr)
+				return node->left;
+			if (node->op == Op::AND || node->op == Op::OR)
+			{
+				node->op = node->op == Op::AND ? Op::OR : Op::AND;
+				node->left = negate(node->left);
+				node->right = negate(node->right);
+				return normalize_logic(node);
+			}
+			switch (node->op)
+			{
+			case Op::EQ: node->op = Op::NE; return node;
+			case Op::NE: node->op = Op::EQ; return node;
+			case Op::LT: node->op = Op::GE; return node;
+			case Op::GE: node->op = Op::LT; return node;
+			case Op::GT: node->op = Op::LE; return node;
+			case Op::LE: node->op = Op::GT; return node;
+			default:
+				return arena.internal(Op::NOT, root, nullptr);
+			}
+		}
+
+		// Drops the bounds of a conjunction implied by the others: x > 3 && x > 5 is x > 5,
+		// x = 2 && x < 9 is x = 2. The conjunction is false if the bounds exclude each other.
+		ASTNode* merge_ranges(InternalNode* node)
+		{
+			std::vector<ASTNode*> terms = get_and_terms(node);
+			std::reverse(terms.begin(), terms.end());
+			std::vector<bool> dropped(terms.size(), false);
+			bool changed = false;
+			for (size_t i = 0; i < terms.size(); ++i)
+			{
+				for (size_t j = i + 1; j < terms.size() && !dropped[i]; ++j)
+				{
+					if (dropped[j] || !is_same_column_bound(terms[i], terms[j]))
+						continue;
+					InternalNode* x = as_internal(terms[i]);
+					InternalNode* y = as_internal(terms[j]);
+					const Value& a = as_leaf(x->right)->value;
+					const Value& b = as_leaf(y->right)->value;
+					int kx = bound_kind(x->op);
+					int ky = bound_kind(y->op);
+					bool drop_x = false, drop_y = false;
+					if (kx == 0 && ky == 0)
+					{
+						if (a != b)
+							return contradiction(node);
+						drop_y = true;
+					}
+					else if (kx == 0 || ky == 0)
+					{
+						// the equality implies the bound or contradicts it
+						bool x_is_eq = kx == 0;
+						const Value& v = x_is_eq ? a : b;
+						InternalNode* bound = x_is_eq ? y : x;
+						if (!compare(v, bound->op, as_leaf(bound->right)->value))
+							return contradiction(node);
+						(x_is_eq ? drop_y : drop_x) = true;
+					}
+					else if (kx == ky)
+					{
+						// the tighter of two lower (upper) bounds
+						bool y_tighter = kx > 0 ? (b > a || (b == a && y->op == Op::GT)) : (b < a || (b == a && y->op == Op::LT));
+						(y_tighter ? drop_x : drop_y) = true;
+					}
+					else
+					{
+						const Value& low = kx > 0 ? a : b;
+						const Value& high = kx > 0 ? b : a;
+						bool strict = x->op == Op::GT || x->op == Op::LT || y->op == Op::GT || y->op == Op::LT;
+						if (high < low || (high == low && strict))
+							return contradiction(node);
+					}
+					dropped[i] = dropped[i] || drop_x;
+					dropped[j] = dropped[j] || drop_y;
+					changed = changed || drop_x || drop_y;
+				}
+			}
+			if (!changed)
+				return node;
+			ASTNode* result = nullptr;
+			for (size_t i = 0; i < terms.size(); ++i)
+			{
+				if (!dropped[i])
+					result = result ? arena.internal(Op::AND, result, terms[i]) : terms[i];
+			}
+			return result;
+		}
+
+		// The conjunction is always false, its terms are still checked
+		ASTNode* contradiction(ASTNode* node)
+		{
+			removed.push_back(node);
+			return arena.leaf(Value(false));
+		}
+
+		// 1 for a lower bound of a column, -1 for an upper one, 0 for an equality
+		static int bound_kind(Op op)
+		{
+			return op == Op::GT || op == Op::GE ? 1 : (op == Op::LT || op == Op::LE ? -1 : 0);
+		}
+
+		// Both terms compare the same column to literals of the same type by =, <, >, <= or >=
+		static bool is_same_column_bound(ASTNode* x, ASTNode* y)
+		{
+			auto is_bound = [](InternalNode* node)
+			{
+				if (!node || !is_rel_op(node->op) || node->op == Op::NE || node->op == Op::LIKE || node->op == Op::STARTS_WITH)
+					return false;
+				LeafNode* left = as_leaf(node->left);
+				return left && !left->id.empty() && is_literal(node->right);
+			};
+			InternalNode* a = as_internal(x);
+			InternalNode* b = as_internal(y);
+			return is_bound(a) && is_bound(b) && as_leaf(a->left)->id == as_leaf(b->left)->id &&
+				as_leaf(a->right)->value.type == as_leaf(b->right)->value.type;
+		}
+
+		static bool is_literal(ASTNode* root)
+		{
+			LeafNode* leaf = as_leaf(root);
+			return leaf && leaf->id.empty() && !leaf->value.is_empty();
+		}
+
+		static bool is_int_literal(ASTNode* root)
+		{
+			return is_literal(root) && as_leaf(root)->value.type == Type::INT;
+		}
+
+		static Op mirror(Op op)
+		{
+			switch (op)
+			{
+			case Op::LT: return Op::GT;
+			case Op::GT: return Op::LT;
+			case Op::LE: return Op::GE;
+			case Op::GE: return Op::LE;
+			default: return op;
+			}
+		}
+
+		static bool compare(const Value& val1, Op op_type, const Value& val2)
+		{
+			switch (op_type)
+			{
+			case Op::EQ: return val1 == val2;
+			case Op::NE: return val1 != val2;
+			case Op::LT: return val1 < val2;
+			case Op::GT: return val1 > val2;
+			case Op::LE: return val1 <= val2;
+			case Op::GE: return val1 >= val2;
+			case Op::LIKE:
+			case Op::STARTS_WITH:
+				return like(val1, val2, op_to_relop(op_type));
+			default:
+				return false;
 			}
-			return root;
 		}
 	};
 
@@ -218,24 +432,27 @@ namespace memdb
 	private:
 		void visit(ASTNode* root, SymbolTable& symbols)
 		{
-			InternalNode* node;
-			LeafNode* leaf;
-			if (node = dynamic_cast<InternalNode*>(root))
+			if (root == nullptr)
+				return;
+			switch (root->kind)
+			{
+			case NodeKind::INTERNAL:
 			{
+				InternalNode* node = static_cast<InternalNode*>(root);
 				visit(node->left, symbols);
 				visit(node->right, symbols);
+				break;
 			}
-			else if (leaf = dynamic_cast<LeafNode*>(root))
+			case NodeKind::LEAF:
 			{
+				LeafNode* leaf = static_cast<LeafNode*>(root);
 				if (!leaf->id.empty())
 				{
-					if (symbols.count(leaf->id) == 0)
-					{
-						symbols.insert(std::make_pair(leaf->id, std::vector<LeafNode* >()));
-					}
-					symbols.at(leaf->id).push_back(leaf);
-				}				
-			}			
+					symbols[leaf->id].push_back(leaf);
+				}
+				break;
+			}
+			}
 		}
 	};
 
@@ -246,10 +463,15 @@ namespace memdb
 
 		Value visit(ASTNode* root)
 		{
-			InternalNode* op_node;
-			LeafNode* leaf_node;
-			if (op_node = dynamic_cast<InternalNode*>(root))
+			if (root == nullptr)
+				return Value(); // NULL value
+			switch (root->kind)
 			{
+			case NodeKind::LEAF:
+				return static_cast<LeafNode*>(root)->value;
+			case NodeKind::INTERNAL:
+			{
+				InternalNode* op_node = static_cast<InternalNode*>(root);
 				Op op_type = op_node->op;
 				Value val1 = visit(op_node->left);
 				Value val2 = visit(op_node->right);
@@ -279,6 +501,9 @@ namespace memdb
 						return val1 <= val2;
 					case Op::GE:
 						return val1 >= val2;
+					case Op::LIKE:
+					case Op::STARTS_WITH:
+						return Value(like(val1, val2, op_to_relop(op_type)));
 					case Op::AND:
 						return val1 & val2;
 					case Op::OR:
@@ -303,9 +528,6 @@ namespace memdb
 					throw std::runtime_error("Unreachable");
 				}				
 			}
-			else if (leaf_node = dynamic_cast<LeafNode*>(root))
-			{
-				return leaf_node->value;				
 			}
 			return Value(); // NULL value
 		}
@@ -0,0 +1,246 @@
+#pragma once
+
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <algorithm>
+#include <cstring>
+#include <mutex>
+#include <shared_mutex>
+
+#include "base.h"
+#include "bytes.h"
+#include "value.h"
+#include "column.h"
+#include "resultset.h"
+#include "table.h"
+
+namespace memdb
+{
+
+    // Typed row builder for inserting from C++ without building a query or a vector of values:
+    //
+    //     RowWriter w = db.writer("users");
+    //     size_t login = w.column("login"), score = w.column("score");
+    //     w.set_string(login, "vasya").set_int(score, 10).commit();
+    //
+    // Values are written into a row buffer of the writer, commit copies it into the next
+    // slot of the table storage and the row becomes visible.
+    // Errors of the setters are remembered and reported by commit.
+    // The writer of a database takes its lock exclusively once, in commit.
+    class RowWriter
+    {
+        Table *table;
+        std::shared_mutex *mutex;          // lock of the database, nullptr for a table alone
+        std::string error;
+        std::vector<bool> is_set;          // columns set in the current row
+        std::vector<uint8_t> row;          // the current row in the layout of the table storage
+        std::vector<uint8_t> dict_values;  // strings of dictionary-encoded columns waiting for encoding
+        std::vector<uint16_t> dict_offsets; // offsets of the columns in dict_values
+
+    public:
+        RowWriter(Table *table, std::shared_mutex *mutex = nullptr) : table(table), mutex(mutex)
+        {
+            if (!table)
+            {
+                error = "Table not found";
+                return;
+            }
+            is_set.resize(table->columns.size());
+            row.resize(table->row_size);
+            dict_offsets.resize(table->columns.size());
+            size_t dict_size = 0;
+            for (size_t i = 0; i < table->columns.size(); ++i)
+            {
+                if (table->columns[i].is_dict)
+                {
+                    dict_offsets[i] = (uint16_t)dict_size;
+                    dict_size += table->columns[i].size;
+                }
+            }
+            dict_values.resize(dict_size);
+        }
+
+        // Writer reporting the error by every commit
+        static RowWriter unsupported(const std::string &error)
+        {
+            RowWriter writer(nullptr);
+            writer.error = error;
+            return writer;
+        }
+
+        // Index of the column to use with the setters
+        size_t column(const std::string &name) const
+        {
+            if (!table)
+                throw std::runtime_error(error);
+            auto it = table->mapping.find(name);
+            if (it == table->mapping.end())
+                throw std::runtime_error("Column not found");
+            return it->second;
+        }
+
+        RowWriter &set_int(size_t col, int32_t val)
+        {
+            uint8_t *ptr = slot(col, Type::INT);
+            if (ptr)
+                std::memcpy(ptr, &val, sizeof(val));
+            return *this;
+        }
+
+        RowWriter &set_bool(size_t col, bool val)
+        {
+            uint8_t *ptr = slot(col, Type::BOOL);
+            if (ptr)
+                std::memcpy(ptr, &val, sizeof(val));
+            return *this;
+        }
+
+        RowWriter &set_string(size_t col, std::string_view val)
+        {
+            uint8_t *ptr = slot(col, Type::STRING);
+            if (!ptr)
+                return *this;
+            uint16_t size = table->columns[col].size;
+            if (val.size() + 1 > size)
+                return fail("Size too large");
+            // zero terminated and padded with zeros to the column size
+            std::memcpy(ptr, val.data(), val.size());
+            std::memset(ptr + val.size(), 0, size - val.size());
+            return *this;
+        }
+
+        RowWriter &set_bytes(size_t col, const uint8_t *data, size_t size)
+        {
+            uint8_t *ptr = slot(col, Type::BYTES);
+            if (!ptr)
+                return *this;
+            if (size != table->columns[col].size)
+                return fail("Size too large");
+            std::memcpy(ptr, data, size);
+            return *this;
+        }
+
+        RowWriter &set_bytes(size_t col, const Bytes &val)
+        {
+            return set_bytes(col, val.data(), val.size());
+        }
+
+        // Checks the row and adds it to the table.
+        // The unset columns get their default or autoincrement values.
+        ResultSet commit()
+        {
+            ResultSet rs;
+            try
+            {
+                if (!error.empty())
+                    throw std::runtime_error(error);
+                auto guard = lock();
+                commit_row();
+            }
+            catch (std::runtime_error &e)
+            {
+                rs.ok = false;
+                rs.error = e.what();
+            }
+            if (table)
+            {
+                error.clear();
+                std::fill(is_set.begin(), is_set.end(), false);
+            }
+            return rs;
+        }
+
+    private:
+        // The row is copied into the table storage, which a select may be reading
+        std::unique_lock<std::shared_mutex> lock()
+        {
+            return mutex ? std::unique_lock<std::shared_mutex>(*mutex) : std::unique_lock<std::shared_mutex>();
+        }
+
+        RowWriter &fail(const char *msg)
+        {
+            if (error.empty())
+                error = msg;
+            return *this;
+        }
+
+        // Location of the column value in the current row, nullptr on error
+        uint8_t *slot(size_t col, Type type)
+        {
+            if (!table)
+                return nullptr;
+            if (col >= table->columns.size())
+            {
+                fail("Column not found");
+                return nullptr;
+            }
+            const Column &column = table->columns[col];
+            if (column.type != type)
+            {
+                fail("Type mismatch");
+                return nullptr;
+            }
+            is_set[col] = true;
+            if (column.is_dict)
+                return dict_values.data() + dict_offsets[col];
+            return row.data() + column.offset;
+        }
+
+        void commit_row()
+        {
+            const std::vector<Column> &columns = table->columns;
+
+            // defaults and checks go first, nothing is changed until the row is valid
+            for (size_t i = 0; i < columns.size(); ++i)
+            {
+                const Column &column = columns[i];
+                if (column.is_auto)
+                    continue;
+                uint8_t *val_ptr = column.is_dict ? dict_values.data() + dict_offsets[i] : row.data() + column.offset;
+                if (!is_set[i])
+                {
+                    if (!column.has_default)
+                        throw std::runtime_error("Missing value");
+                    const Value &def = column.def_value;
+                    std::memcpy(val_ptr, def.val_ptr, def.size);
+                    std::memset(val_ptr + def.size, 0, column.size - def.size);
+                }
+                if (column.is_unique || column.is_key)
+                {
+                    if (!table->check_unique_value(Value(column.type, val_ptr, column.size), i))
+                        throw std::runtime_error("Value is not unique");
+                }
+            }
+
+            table->reserve_row();
+            size_t idx = table->row_count;
+            uint8_t *row_ptr = table->storage + idx * table->row_size;
+            std::memcpy(row_ptr, row.data(), row.size());
+            for (size_t i = 0; i < columns.size(); ++i)
+            {
+                Column &column = table->columns[i];
+                uint8_t *val_ptr = row_ptr + column.offset;
+                if (column.is_auto)
+                {
+                    int32_t val = column.autoincrement_value++;
+                    std::memcpy(val_ptr, &val, sizeof(val));
+                }
+                else if (column.is_dict)
+                {
+                    const char *str = (const char *)dict_values.data() + dict_offsets[i];
+                    uint32_t code = table->dictionaries[i]->encode(std::string(str, std::find(str, str + column.size, '\0')));
+                    std::memcpy(val_ptr, &code, sizeof(code));
+                }
+            }
+
+            table->row_count++;
+            table->version++;
+            table->update_block_summaries(idx);
+            table->update_ordered_indices(idx);
+            table->update_trigram_indices(idx);
+        }
+    };
+
+}
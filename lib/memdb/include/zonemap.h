@@ -0,0 +1,109 @@
+#pragma once
+
+#include <stdexcept>
+#include <vector>
+#include <iostream>
+#include <algorithm>
+
+#include "base.h"
+#include "column.h"
+#include "condition.h"
+#include "utils.h"
+
+namespace memdb
+{
+
+    // Zone map - minimum and maximum values of a column for every block of rows.
+    // A block can be skipped by a scan if the condition cannot be true
+    // for any value in the [min, max] interval.
+    struct ZoneMap
+    {
+        static constexpr size_t BLOCK_SIZE = 4096; // rows per block
+
+        size_t col;
+        Type type;
+        uint16_t size;
+        std::vector<uint8_t> min; // size bytes per block
+        std::vector<uint8_t> max; // size bytes per block
+
+        ZoneMap(size_t col, const Column &column) : col(col), type(column.type), size(column.size) {}
+
+        static bool is_supported(Type type)
+        {
+            return type == Type::INT || type == Type::STRING || type == Type::BYTES;
+        }
+
+        size_t num_blocks() const { return size ? min.size() / size : 0; }
+
+        // Includes the value of the new row into the zone map
+        void update(size_t row, const uint8_t *val_ptr)
+        {
+            size_t block = row / BLOCK_SIZE;
+            if (block == num_blocks())
+            {
+                min.insert(min.end(), val_ptr, val_ptr + size);
+                max.insert(max.end(), val_ptr, val_ptr + size);
+                return;
+            }
+            uint8_t *min_ptr = min.data() + block * size;
+            uint8_t *max_ptr = max.data() + block * size;
+            if (compare_raw(type, val_ptr, min_ptr, size) < 0)
+                std::copy(val_ptr, val_ptr + size, min_ptr);
+            if (compare_raw(type, val_ptr, max_ptr, size) > 0)
+                std::copy(val_ptr, val_ptr + size, max_ptr);
+        }
+
+        // Checks if the block may contain rows matching the condition
+        bool may_match(size_t block, const Condition &cond) const
+        {
+            const Value &that = cond.that;
+            if (that.type != type || (type == Type::BYTES && that.size != size))
+                return true; // let the row check report the error
+
+            // strings are null-terminated, so the longest length is safe here
+            uint16_t n = std::max(size, that.size);
+            int cmp_min = compare_raw(type, min.data() + block * size, that.val_ptr, n);
+            int cmp_max = compare_raw(type, max.data() + block * size, that.val_ptr, n);
+            switch (cond.op)
+            {
+            case RelOp::EQ:
+                return cmp_min <= 0 && cmp_max >= 0;
+            case RelOp::NE:
+                return !(cmp_min == 0 && cmp_max == 0);
+            case RelOp::LT:
+                return cmp_min < 0;
+            case RelOp::LE:
+                return cmp_min <= 0;
+            case RelOp::GT:
+                return cmp_max > 0;
+            case RelOp::GE:
+                return cmp_max >= 0;
+            case RelOp::LIKE:
+            case RelOp::STARTS_WITH:
+                break; // the prefix is checked as a range
+            }
+            return true;
+        }
+
+        void save_to_file(std::ostream &out) const
+        {
+            write_int(out, col);
+            write_int(out, num_blocks());
+            out.write((const char *)min.data(), min.size());
+            out.write((const char *)max.data(), max.size());
+        }
+
+        static ZoneMap load_from_file(std::istream &in, const std::vector<Column> &columns)
+        {
+            size_t col = read_int<size_t>(in);
+            ZoneMap zone_map(col, columns.at(col));
+            size_t n = read_int<size_t>(in) * zone_map.size;
+            zone_map.min.resize(n);
+            zone_map.max.resize(n);
+            in.read((char *)zone_map.min.data(), n);
+            in.read((char *)zone_map.max.data(), n);
+            return zone_map;
+        }
+    };
+
+}
@@ -626,4 +626,28 @@ TEST(LexerTest, TestAll)
 
 	EXPECT_EQ(lexems[52].type, LexemType::BT_LIT);
 	EXPECT_EQ(lexems[52].value, "0x123456");
-}
\ No newline at end of file
+}
+TEST(LexerTest, TestKeywords)
+{
+	for (const auto &keyword : KEYWORDS)
+	{
+		std::string s(keyword.text);
+		std::string upper = s;
+		for (auto &c : upper)
+			c = (char)toupper(c);
+		std::string query = s + " " + upper + " " + s + "_x";
+		Lexer lexer(query);
+		const auto &lexems = lexer.tokenize();
+
+		EXPECT_EQ(lexems[0].type, keyword.type);
+		EXPECT_EQ(lexems[1].type, keyword.type);
+		EXPECT_EQ(lexems[1].value, upper);
+		EXPECT_EQ(lexems[2].type, LexemType::ID);
+	}
+
+	std::string s = "tables selec x1 _";
+	Lexer lexer(s);
+	const auto &lexems = lexer.tokenize();
+	for (size_t i = 0; i < 4; ++i)
+		EXPECT_EQ(lexems[i].type, LexemType::ID);
+}
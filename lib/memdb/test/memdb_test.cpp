@@ -1,6 +1,1318 @@
 #include <gtest/gtest.h>
-
+#include <map>
+#include <sstream>
+#include <set>
+#include <cstring>
+#include <thread>
+#include "memdb.h"
+#include "server.h"
+#include "client.h"
+using namespace memdb;
 
 TEST(MemdbTest, Base) {
   
-}
\ No newline at end of file
+}
+
+static void make_users(Database &db, int n)
+{
+	ASSERT_TRUE(db.execute("create table users ({key, autoincrement} id: int32, login: string[16], "
+		"is_admin: bool = false, score: int32 = 0)").is_ok());
+	for (int i = 0; i < n; ++i)
+	{
+		std::string query = "insert (login = \"user" + std::to_string(i % 10) + "\", is_admin = " +
+			(i % 3 == 0 ? "true" : "false") + ", score = " + std::to_string(i) + ") to users";
+		ASSERT_TRUE(db.execute(query).is_ok());
+	}
+}
+
+TEST(MemdbTest, GroupBy)
+{
+	Database db;
+	make_users(db, 100);
+
+	auto rs = db.execute("select login, count(*), sum(score), min(score), max(score) from users group by login");
+	ASSERT_TRUE(rs.is_ok()) << rs.get_error();
+	EXPECT_EQ(rs.get_row_count(), 10);
+	for (const auto &row : rs)
+	{
+		std::string login = row.get<std::string>("login");
+		int k = login.back() - '0';
+		EXPECT_EQ(row.get<int32_t>("count(*)"), 10);
+		EXPECT_EQ(row.get<int32_t>("min(score)"), k);
+		EXPECT_EQ(row.get<int32_t>("max(score)"), 90 + k);
+		EXPECT_EQ(row.get<int32_t>("sum(score)"), 450 + 10 * k);
+	}
+
+	// bool key uses the direct-indexed path
+	rs = db.execute("select is_admin, count(id) from users where id > 10 group by is_admin");
+	ASSERT_TRUE(rs.is_ok()) << rs.get_error();
+	EXPECT_EQ(rs.get_row_count(), 2);
+	int total = 0;
+	for (const auto &row : rs)
+		total += row.get<int32_t>("count(id)");
+	EXPECT_EQ(total, 90);
+
+	// aggregates without group by
+	rs = db.execute("select count(*), max(login) from users where score >= 95");
+	ASSERT_TRUE(rs.is_ok()) << rs.get_error();
+	EXPECT_EQ(rs.get_row_count(), 1);
+	EXPECT_EQ((*rs.begin()).get<int32_t>("count(*)"), 5);
+	EXPECT_EQ((*rs.begin()).get<std::string>("max(login)"), "user9");
+
+	rs = db.execute("select login, score from users group by login");
+	EXPECT_FALSE(rs.is_ok());
+
+	// Final sums out of the int32 range are errors, in a table and when merging partitions,
+	// the partial sums are not checked
+	ASSERT_TRUE(db.execute("create table big (ts: int32, g: int32, v: int32)").is_ok());
+	ASSERT_TRUE(db.execute("create table bigp (ts: int32, g: int32, v: int32) partition by range(ts) every 10").is_ok());
+	ASSERT_TRUE(db.execute("create table bigh (ts: int32, g: int32, v: int32) partition by hash(ts) into 4").is_ok());
+	for (int i = 0; i < 4; ++i)
+	{
+		std::vector<Value> values = { Value(i * 10), Value(i % 2), Value(i < 2 ? 2000000000 : -2000000000) };
+		ASSERT_TRUE(db.insert("big", values).is_ok());
+		ASSERT_TRUE(db.insert("bigp", values).is_ok());
+		ASSERT_TRUE(db.insert("bigh", values).is_ok());
+	}
+	rs = db.execute("select g, sum(v) from big group by g");
+	ASSERT_TRUE(rs.is_ok()) << rs.get_error();
+	for (auto row : rs)
+		EXPECT_EQ(row.get<int32_t>("sum(v)"), 0);
+	rs = db.execute("select sum(v) from big where ts < 20");
+	EXPECT_FALSE(rs.is_ok());
+	EXPECT_EQ(rs.get_error(), "Integer overflow in sum(v).");
+	EXPECT_FALSE(db.execute("select sum(v) from big where ts > 10").is_ok());
+	EXPECT_FALSE(db.execute("select sum(v) from bigp where ts < 20").is_ok());
+	for (const char *table : { "big", "bigp", "bigh" })
+	{
+		rs = db.execute(std::string("select sum(v) from ") + table);
+		ASSERT_TRUE(rs.is_ok()) << table << ": " << rs.get_error();
+		EXPECT_EQ((*rs.begin()).get<int32_t>("sum(v)"), 0) << table;
+	}
+	rs = db.execute("select sum(v) from bigh where ts < 20");
+	EXPECT_FALSE(rs.is_ok());
+	EXPECT_EQ(rs.get_error(), "Integer overflow in sum(v).");
+	rs = db.execute("select g, sum(v) from bigh group by g");
+	ASSERT_TRUE(rs.is_ok()) << rs.get_error();
+	EXPECT_EQ(rs.get_row_count(), 2);
+	for (auto row : rs)
+		EXPECT_EQ(row.get<int32_t>("sum(v)"), 0);
+	rs = db.execute("select g, sum(v) from bigp where ts < 10 || ts >= 30 group by g");
+	ASSERT_TRUE(rs.is_ok()) << rs.get_error();
+	EXPECT_EQ(rs.get_row_count(), 2);
+}
+
+TEST(MemdbTest, GroupByParallel)
+{
+	// Rows: (a: int32, b: string[8]), aggregated by 4 threads
+	Column a(Type::INT, "a");
+	Column b(Type::STRING, "b", 8);
+	b.offset = a.size;
+	const uint16_t row_size = a.size + b.size;
+	const size_t n = 300000;
+	std::vector<uint8_t> storage(n * row_size, 0xff); // garbage after string terminators
+	std::vector<size_t> rows;
+	for (size_t i = 0; i < n; ++i)
+	{
+		uint8_t *row_ptr = storage.data() + i * row_size;
+		*((int32_t *)row_ptr) = (int32_t)(i * 7919 % 100000);
+		std::string s(1 + i % 5, 'x');
+		std::copy(s.c_str(), s.c_str() + s.size() + 1, row_ptr + b.offset);
+		rows.push_back(i);
+	}
+
+	std::map<std::string, int32_t> expected_max;
+	for (size_t i = 0; i < n; ++i)
+	{
+		const uint8_t *row_ptr = storage.data() + i * row_size;
+		int32_t &m = expected_max[std::string((const char *)row_ptr + b.offset)];
+		m = std::max(m, *((const int32_t *)row_ptr));
+	}
+
+	HashAggregator by_b(storage.data(), row_size, { &b }, { { AggFunc::COUNT, nullptr }, { AggFunc::MAX, &a } }, 4);
+	Groups groups = by_b.run(rows);
+	ASSERT_EQ(groups.size(), 5);
+	for (size_t g = 0; g < groups.size(); ++g)
+	{
+		std::string key((const char *)storage.data() + groups.first_row[g] * row_size + b.offset);
+		EXPECT_EQ(groups.acc[g * 2], (int64_t)n / 5);
+		EXPECT_EQ(*((int32_t *)(storage.data() + groups.acc[g * 2 + 1] * row_size)), expected_max.at(key));
+	}
+
+	HashAggregator by_a(storage.data(), row_size, { &a }, { { AggFunc::COUNT, nullptr }, { AggFunc::SUM, &a } }, 4);
+	groups = by_a.run(rows);
+	ASSERT_EQ(groups.size(), 100000);
+	for (size_t g = 0; g < groups.size(); ++g)
+	{
+		int32_t key = *((int32_t *)(storage.data() + groups.first_row[g] * row_size));
+		EXPECT_EQ(groups.acc[g * 2], 3);
+		EXPECT_EQ(groups.acc[g * 2 + 1], 3 * (int64_t)key);
+	}
+}
+
+TEST(MemdbTest, ZoneMaps)
+{
+	Database db;
+	ASSERT_TRUE(db.execute("create table events ({autoincrement} id: int32, ts: int32, tag: string[8])").is_ok());
+	const int n = 3 * ZoneMap::BLOCK_SIZE + 100;
+	for (int i = 0; i < n; ++i)
+	{
+		ASSERT_TRUE(db.insert("events", { Value(), Value((int32_t)(1000 + i)), Value(std::string(i < 10 ? "first" : "other")) }).is_ok());
+	}
+
+	auto rs = db.execute("select id, ts from events where ts >= 5000 && ts < 5010");
+	ASSERT_TRUE(rs.is_ok()) << rs.get_error();
+	EXPECT_EQ(rs.get_row_count(), 10);
+	EXPECT_EQ((*rs.begin()).get<int32_t>("id"), 4001);
+
+	rs = db.execute("select id from events where tag = \"first\"");
+	EXPECT_EQ(rs.get_row_count(), 10);
+
+	std::stringstream ss;
+	db.save_to_file(ss);
+	Database db2;
+	db2.load_from_file(ss);
+	rs = db2.execute("select id, ts from events where ts > 13000");
+	ASSERT_TRUE(rs.is_ok()) << rs.get_error();
+	EXPECT_EQ(rs.get_row_count(), n - 12001);
+
+	// Files of another format version are rejected
+	std::string saved = ss.str();
+	uint32_t version = 0;
+	std::memcpy(&saved[sizeof(uint32_t)], &version, sizeof(version));
+	std::stringstream old_file(saved);
+	Database db3;
+	EXPECT_THROW(db3.load_from_file(old_file), std::runtime_error);
+	std::stringstream not_a_file("select");
+	EXPECT_THROW(db3.load_from_file(not_a_file), std::runtime_error);
+
+	// A block with values in [10, 20]
+	Column c(Type::INT, "x");
+	ZoneMap zone_map(0, c);
+	for (int32_t v = 10; v <= 20; ++v)
+		zone_map.update(v - 10, (const uint8_t *)&v);
+	EXPECT_TRUE(zone_map.may_match(0, Condition(Value((int32_t)15), RelOp::EQ)));
+	EXPECT_FALSE(zone_map.may_match(0, Condition(Value((int32_t)21), RelOp::EQ)));
+	EXPECT_FALSE(zone_map.may_match(0, Condition(Value((int32_t)10), RelOp::LT)));
+	EXPECT_TRUE(zone_map.may_match(0, Condition(Value((int32_t)10), RelOp::LE)));
+	EXPECT_FALSE(zone_map.may_match(0, Condition(Value((int32_t)20), RelOp::GT)));
+	EXPECT_TRUE(zone_map.may_match(0, Condition(Value((int32_t)20), RelOp::GE)));
+}
+
+TEST(MemdbTest, BloomFilters)
+{
+	Database db;
+	ASSERT_TRUE(db.execute("create table users ({key, autoincrement} id: int32, {unique, bloom} login: string[16], code: int32)").is_ok());
+	const int n = 10000;
+	for (int i = 0; i < n; ++i)
+	{
+		ASSERT_TRUE(db.execute("insert (login = \"user" + std::to_string(i) + "\", code = " + std::to_string(i % 7) + ") to users").is_ok());
+	}
+	EXPECT_FALSE(db.execute("insert (login = \"user42\", code = 1) to users").is_ok());
+	EXPECT_FALSE(db.execute("insert (login = \"user9999\", code = 1) to users").is_ok());
+	EXPECT_TRUE(db.execute("insert (login = \"user10000\", code = 1) to users").is_ok());
+
+	auto rs = db.execute("select id from users where login = \"user5000\"");
+	ASSERT_TRUE(rs.is_ok()) << rs.get_error();
+	ASSERT_EQ(rs.get_row_count(), 1);
+	EXPECT_EQ((*rs.begin()).get<int32_t>("id"), 5001);
+
+	std::stringstream ss;
+	db.save_to_file(ss);
+	Database db2;
+	db2.load_from_file(ss);
+	EXPECT_FALSE(db2.execute("insert (login = \"user7\", code = 1) to users").is_ok());
+	rs = db2.execute("select id from users where login = \"user10000\" && code = 1");
+	EXPECT_EQ(rs.get_row_count(), 1);
+
+	Column c(Type::INT, "x");
+	BloomFilter filter(0, c);
+	for (int32_t v = 0; v < 1000; ++v)
+		filter.add(v, (const uint8_t *)&v);
+	for (int32_t v = 0; v < 1000; ++v)
+		EXPECT_TRUE(filter.may_contain(0, Value(v)));
+	int false_positives = 0;
+	for (int32_t v = 1000; v < 11000; ++v)
+		false_positives += filter.may_contain(0, Value(v));
+	EXPECT_LT(false_positives, 100);
+}
+
+TEST(MemdbTest, DictionaryEncoding)
+{
+	Database db;
+	ASSERT_TRUE(db.execute("create table orders ({key, autoincrement} id: int32, {dict} status: string[16], {dict, unique} code: string[8])").is_ok());
+	const char *statuses[] = { "new", "paid", "shipped", "cancelled" };
+	for (int i = 0; i < 1000; ++i)
+	{
+		std::string query = std::string("insert (status = \"") + statuses[i % 4] + "\", code = \"c" + std::to_string(i) + "\") to orders";
+		ASSERT_TRUE(db.execute(query).is_ok());
+	}
+	EXPECT_FALSE(db.execute("insert (status = \"new\", code = \"c5\") to orders").is_ok());
+
+	auto rs = db.execute("select id, status from orders where status = \"paid\"");
+	ASSERT_TRUE(rs.is_ok()) << rs.get_error();
+	EXPECT_EQ(rs.get_row_count(), 250);
+	for (const auto &row : rs)
+		EXPECT_EQ(row.get<std::string>("status"), "paid");
+
+	// range conditions use the sorted order of the dictionary
+	rs = db.execute("select id from orders where status >= \"new\" && status < \"shipped\"");
+	EXPECT_EQ(rs.get_row_count(), 500);
+	rs = db.execute("select id from orders where status != \"new\" && status > \"a\"");
+	EXPECT_EQ(rs.get_row_count(), 750);
+	rs = db.execute("select id from orders where status = \"unknown\"");
+	EXPECT_EQ(rs.get_row_count(), 0);
+
+	rs = db.execute("select status, count(*), min(code) from orders group by status");
+	ASSERT_TRUE(rs.is_ok()) << rs.get_error();
+	EXPECT_EQ(rs.get_row_count(), 4);
+	for (const auto &row : rs)
+	{
+		EXPECT_EQ(row.get<int32_t>("count(*)"), 250);
+		if (row.get<std::string>("status") == "cancelled")
+		{
+			EXPECT_EQ(row.get<std::string>("min(code)"), "c103");
+		}
+	}
+
+	std::stringstream ss;
+	db.save_to_file(ss);
+	Database db2;
+	db2.load_from_file(ss);
+	rs = db2.select_all("orders");
+	ASSERT_EQ(rs.get_row_count(), 1000);
+	EXPECT_EQ((*rs.begin()).get<std::string>("status"), "new");
+	EXPECT_EQ((*rs.begin()).get<std::string>("code"), "c0");
+	ASSERT_TRUE(db2.execute("create ordered index on orders by status").is_ok());
+	rs = db2.execute("select id from orders where status = \"shipped\"");
+	EXPECT_EQ(rs.get_row_count(), 250);
+
+	// values added after a range condition are merged into the sorted order
+	rs = db2.execute("select id from orders where status >= \"new\" && status < \"shipped\"");
+	EXPECT_EQ(rs.get_row_count(), 500);
+	ASSERT_TRUE(db2.execute("insert (status = \"open\", code = \"c1000\") to orders").is_ok());
+	ASSERT_TRUE(db2.execute("insert (status = \"archived\", code = \"c1001\") to orders").is_ok());
+	rs = db2.execute("select id from orders where status >= \"new\" && status < \"shipped\"");
+	EXPECT_EQ(rs.get_row_count(), 501);
+	rs = db2.execute("select id from orders where status < \"c\"");
+	EXPECT_EQ(rs.get_row_count(), 1);
+	rs = db2.execute("select min(status), max(status) from orders");
+	ASSERT_TRUE(rs.is_ok()) << rs.get_error();
+	EXPECT_EQ((*rs.begin()).get<std::string>("min(status)"), "archived");
+	EXPECT_EQ((*rs.begin()).get<std::string>("max(status)"), "shipped");
+
+	EXPECT_FALSE(db.execute("create table bad ({dict} x: int32)").is_ok());
+}
+
+TEST(MemdbTest, ColumnStats)
+{
+	// 10000 rows, values 0..999 ten times each
+	std::vector<Value> sample;
+	for (int32_t i = 0; i < 10000; ++i)
+		sample.push_back(Value(i % 1000));
+	ColumnStats stats;
+	stats.build(sample, sample.size());
+	EXPECT_DOUBLE_EQ(stats.distinct, 1000);
+	EXPECT_FALSE(stats.is_stale(10500));
+	EXPECT_TRUE(stats.is_stale(12000));
+
+	EXPECT_NEAR(stats.selectivity(Condition(Value((int32_t)500), RelOp::EQ)), 0.001, 0.0001);
+	EXPECT_NEAR(stats.selectivity(Condition(Value((int32_t)250), RelOp::LT)), 0.25, 0.02);
+	EXPECT_NEAR(stats.selectivity(Condition(Value((int32_t)250), RelOp::GE)), 0.75, 0.02);
+	EXPECT_DOUBLE_EQ(stats.selectivity(Condition(Value((int32_t)5000), RelOp::EQ)), 0);
+	Condition lower(Value((int32_t)100), RelOp::GE);
+	Condition upper(Value((int32_t)200), RelOp::LT);
+	EXPECT_NEAR(stats.selectivity({ &lower, &upper }), 0.1, 0.02);
+
+	// selective conditions use the index, others - a full scan; the results are the same
+	Database db;
+	make_users(db, 5000);
+	ASSERT_TRUE(db.execute("create ordered index on users by score").is_ok());
+	auto rs = db.execute("select id from users where score >= 100 && score < 110");
+	ASSERT_TRUE(rs.is_ok()) << rs.get_error();
+	EXPECT_EQ(rs.get_row_count(), 10);
+	EXPECT_EQ((*rs.begin()).get<int32_t>("id"), 101);
+	rs = db.execute("select id from users where score >= 100 && is_admin = true");
+	EXPECT_EQ(rs.get_row_count(), 1633);
+	EXPECT_EQ((*rs.begin()).get<int32_t>("id"), 103);
+}
+
+static std::map<std::string, std::string> explain(Database &db, const std::string &query)
+{
+	std::map<std::string, std::string> items;
+	auto rs = db.execute(query);
+	EXPECT_TRUE(rs.is_ok()) << rs.get_error();
+	for (const auto &row : rs)
+		items[row.get<std::string>("property")] = row.get<std::string>("value");
+	return items;
+}
+
+TEST(MemdbTest, Explain)
+{
+	Database db;
+	make_users(db, 5000);
+	ASSERT_TRUE(db.execute("create ordered index on users by score").is_ok());
+
+	auto items = explain(db, "explain select id from users where score >= 100 && score < 110 && is_admin = true");
+	EXPECT_EQ(items["access path"], "index range");
+	EXPECT_EQ(items["index"], "score");
+	EXPECT_EQ(items["range"], "score < 110 && score >= 100");
+	EXPECT_EQ(items["predicates"], "is_admin = true");
+	EXPECT_EQ(items.count("rows examined"), 0);
+
+	items = explain(db, "explain analyze select id from users where score >= 100 && score < 110 && is_admin = true");
+	EXPECT_EQ(items["access path"], "index range");
+	EXPECT_EQ(items["rows examined"], "10");
+	EXPECT_EQ(items["rows matched"], "3");
+	EXPECT_EQ(items["result rows"], "3");
+	EXPECT_EQ(items.count("scan time"), 1);
+
+	items = explain(db, "explain analyze select id from users where score >= 0");
+	EXPECT_EQ(items["access path"], "full scan");
+	EXPECT_EQ(items["rows examined"], "5000");
+	EXPECT_EQ(items["predicates"], "score >= 0");
+
+	items = explain(db, "explain select id from users where score = 1 || is_admin");
+	EXPECT_EQ(items["access path"], "full scan");
+	EXPECT_EQ(items["predicates"], "((score = 1) || is_admin)");
+
+	items = explain(db, "explain analyze select login, count(*) from users group by login");
+	EXPECT_EQ(items["predicates"], "none");
+	EXPECT_EQ(items["result rows"], "10");
+
+	EXPECT_FALSE(db.execute("explain select id from users where unknown = 1").is_ok());
+	EXPECT_FALSE(db.execute("explain analyze").is_ok());
+}
+
+TEST(MemdbTest, QueryStats)
+{
+	Database db;
+	make_users(db, 5000);
+	ASSERT_TRUE(db.execute("create ordered index on users by score").is_ok());
+
+	auto rs = db.execute("select id, login from users where score >= 100 && score < 110 && is_admin = true");
+	ASSERT_TRUE(rs.is_ok()) << rs.get_error();
+	const QueryStats &stats = rs.get_stats();
+	EXPECT_EQ(stats.rows_examined, 10);
+	EXPECT_EQ(stats.rows_matched, 3);
+	EXPECT_EQ(stats.index_probes, 2);
+	EXPECT_GE(stats.comparisons, 30u); // two binary searches and the row checks
+	EXPECT_EQ(stats.bytes_copied, 3 * (4 + 16));
+	EXPECT_GE(stats.allocations, 2u);
+	EXPECT_GT(stats.parse_ns, 0);
+	EXPECT_GT(stats.scan_ns, 0);
+	EXPECT_GE(stats.total_ns, stats.parse_ns + stats.plan_ns + stats.scan_ns + stats.materialize_ns);
+
+	rs = db.execute("select id from users where is_admin = true");
+	EXPECT_EQ(rs.get_stats().rows_examined, 5000);
+	EXPECT_EQ(rs.get_stats().index_probes, 0);
+	EXPECT_EQ(rs.get_stats().comparisons, 5000);
+}
+
+TEST(MemdbTest, ASTArena)
+{
+	std::string text = "select id from users where score > 2 * 3 + 1 && !(1 = 2) && login = \"user\" + \"1\"";
+	Lexer lexer(text);
+	auto lexems = lexer.tokenize();
+	SelectParser parser(lexems);
+	SelectDef def = parser.parse();
+	ASSERT_NE(def.arena, nullptr);
+	EXPECT_EQ(to_string(def.ast), "((score > 7) && (login = \"user1\"))");
+	ASSERT_EQ(def.ast->kind, NodeKind::INTERNAL);
+	EXPECT_EQ(as_leaf(def.ast), nullptr);
+	EXPECT_EQ(as_internal(def.ast)->op, Op::AND);
+
+	// many nodes span several blocks of the arena
+	Database db;
+	make_users(db, 100);
+	std::string query = "select id from users where score >= 0";
+	for (int i = 0; i < 200; ++i)
+		query += " && score != " + std::to_string(1000 + i);
+	auto rs = db.execute(query);
+	ASSERT_TRUE(rs.is_ok()) << rs.get_error();
+	EXPECT_EQ(rs.get_row_count(), 100);
+}
+
+TEST(MemdbTest, RowWriter)
+{
+	Database db;
+	ASSERT_TRUE(db.execute("create table users ({key, autoincrement} id: int32, {unique} login: string[16], "
+		"is_admin: bool = false, {dict} city: string[16] = \"none\", hash: bytes[4])").is_ok());
+
+	RowWriter w = db.writer("users");
+	size_t login = w.column("login"), is_admin = w.column("is_admin"), city = w.column("city"), hash = w.column("hash");
+	for (int i = 0; i < 100; ++i)
+	{
+		w.set_string(login, "user" + std::to_string(i)).set_bytes(hash, Bytes{1, 2, 3, (uint8_t)i});
+		if (i % 2 == 0)
+			w.set_string(city, i % 4 == 0 ? "Moscow" : "Kazan").set_bool(is_admin, true);
+		auto rs = w.commit();
+		ASSERT_TRUE(rs.is_ok()) << rs.get_error();
+	}
+
+	auto rs = db.execute("select id, is_admin, city from users where login = \"user42\"");
+	ASSERT_TRUE(rs.is_ok()) << rs.get_error();
+	ASSERT_EQ(rs.get_row_count(), 1);
+	EXPECT_EQ((*rs.begin()).get<int32_t>("id"), 43);
+	EXPECT_TRUE((*rs.begin()).get<bool>("is_admin"));
+	EXPECT_EQ((*rs.begin()).get<std::string>("city"), "Kazan");
+	EXPECT_EQ(db.execute("select id from users where city = \"none\" && is_admin = false").get_row_count(), 50);
+	EXPECT_EQ(db.execute("select id from users where hash = 0x01020305").get_row_count(), 1);
+	EXPECT_EQ(db.execute("select id from users where id > 90").get_row_count(), 10);
+
+	// errors are reported by commit and leave the table unchanged
+	EXPECT_FALSE(w.set_string(login, "user1").set_bytes(hash, Bytes{0, 0, 0, 0}).commit().is_ok());
+	EXPECT_FALSE(w.set_int(login, 1).commit().is_ok());
+	EXPECT_FALSE(w.set_string(login, "a very long login name").commit().is_ok());
+	EXPECT_FALSE(w.set_string(login, "user100").commit().is_ok()); // hash has no default
+	EXPECT_TRUE(w.set_string(login, "user100").set_bytes(hash, Bytes{0, 0, 0, 0}).commit().is_ok());
+	rs = db.execute("select id from users where login = \"user100\"");
+	ASSERT_EQ(rs.get_row_count(), 1);
+	EXPECT_EQ((*rs.begin()).get<int32_t>("id"), 101);
+	EXPECT_EQ(db.execute("select id from users").get_row_count(), 101);
+
+	// the row is kept by the writer until commit, an insert in between does not change it
+	w.set_string(login, "pending").set_bytes(hash, Bytes{9, 9, 9, 9});
+	ASSERT_TRUE(db.execute("insert (login = \"inserted\", hash = 0x01010101) to users").is_ok());
+	ASSERT_TRUE(w.commit().is_ok());
+	EXPECT_EQ(db.execute("select id from users where login = \"pending\" && hash = 0x09090909").get_row_count(), 1);
+	EXPECT_EQ(db.execute("select id from users where login = \"inserted\" && hash = 0x01010101").get_row_count(), 1);
+
+	EXPECT_FALSE(db.writer("missing").commit().is_ok());
+}
+
+TEST(MemdbTest, PositionalAccess)
+{
+	Database db;
+	ASSERT_TRUE(db.execute("create table users ({key, autoincrement} id: int32, login: string[16], "
+		"is_admin: bool = false, {dict} city: string[16] = \"none\", hash: bytes[4])").is_ok());
+	ASSERT_TRUE(db.execute("insert (login = \"vasya\", is_admin = true, city = \"Kazan\", hash = 0x01020304) to users").is_ok());
+	ASSERT_TRUE(db.execute("insert (login = \"petya\", hash = 0x05060708) to users").is_ok());
+
+	auto rs = db.execute("select hash, city, login, is_admin, id from users where id > 0");
+	ASSERT_TRUE(rs.is_ok()) << rs.get_error();
+	size_t login = rs.get_column_index("login");
+	EXPECT_EQ(login, 2);
+	EXPECT_THROW(rs.get_column_index("missing"), std::runtime_error);
+
+	auto row = *rs.begin();
+	EXPECT_EQ(row.get<int32_t>(4), 1);
+	EXPECT_TRUE(row.get<bool>(3));
+	EXPECT_EQ(row.get<std::string>(login), "vasya");
+	EXPECT_EQ(row.get_view<std::string_view>(login), "vasya");
+	EXPECT_EQ(row.get_view<std::string_view>("city"), "Kazan");
+	EXPECT_EQ(row.get<Bytes>(0), (Bytes{1, 2, 3, 4}));
+	BytesView hash = row.get_view<BytesView>(0);
+	ASSERT_EQ(hash.size(), 4);
+	EXPECT_EQ(hash[3], 4);
+	EXPECT_EQ(Bytes(hash.begin(), hash.end()), row.get<Bytes>("hash"));
+	EXPECT_THROW(row.get<int32_t>(login), std::runtime_error);
+	EXPECT_THROW(row.get<int32_t>(5), std::runtime_error);
+
+	std::vector<std::string_view> logins;
+	for (const auto &r : rs)
+		logins.push_back(r.get_view<std::string_view>(login));
+	EXPECT_EQ(logins, (std::vector<std::string_view>{"vasya", "petya"}));
+	EXPECT_EQ((*(++rs.begin())).get<std::string>(1), "none");
+
+	rs = db.execute("select is_admin, count(*) from users group by is_admin");
+	ASSERT_TRUE(rs.is_ok()) << rs.get_error();
+	int32_t total = 0;
+	for (const auto &r : rs)
+		total += r.get<int32_t>(1);
+	EXPECT_EQ(total, 2);
+}
+
+TEST(MemdbTest, GatherPlan)
+{
+	// adjacent columns are merged into one segment
+	std::vector<Column> cols = { Column(Type::INT, "a"), Column(Type::INT, "b"), Column(Type::STRING, "c", 8) };
+	uint16_t row_size = 0;
+	for (auto &col : cols)
+	{
+		col.offset = row_size;
+		row_size += col.size;
+	}
+	GatherPlan all;
+	all.add(cols[0], 0, nullptr);
+	all.add(cols[1], 4, nullptr);
+	all.add(cols[2], 8, nullptr);
+	ASSERT_EQ(all.get_segments().size(), 1);
+	EXPECT_EQ(all.get_segments()[0].len, 16);
+
+	GatherPlan reordered(4);
+	reordered.add(cols[1], 0, nullptr);
+	reordered.add(cols[2], 4, nullptr);
+	reordered.add(cols[0], 12, nullptr);
+	ASSERT_EQ(reordered.get_segments().size(), 2);
+
+	// large results are copied by several threads
+	size_t n = 1000000;
+	std::vector<uint8_t> storage(n * row_size);
+	std::vector<size_t> rows;
+	for (size_t i = 0; i < n; ++i)
+	{
+		int32_t a = (int32_t)i, b = -(int32_t)i;
+		std::memcpy(&storage[i * row_size], &a, 4);
+		std::memcpy(&storage[i * row_size + 4], &b, 4);
+		if (i % 3 == 0)
+			rows.push_back(n - 1 - i);
+	}
+	std::vector<uint8_t> out(rows.size() * 16);
+	reordered.run(storage.data(), row_size, rows, out.data(), 16);
+	for (size_t i = 0; i < rows.size(); ++i)
+	{
+		int32_t a, b;
+		std::memcpy(&b, &out[i * 16], 4);
+		std::memcpy(&a, &out[i * 16 + 12], 4);
+		ASSERT_EQ(a, (int32_t)rows[i]);
+		ASSERT_EQ(b, -(int32_t)rows[i]);
+	}
+
+	Database db;
+	make_users(db, 100);
+	ASSERT_TRUE(db.execute("create table cities ({key, autoincrement} id: int32, {dict} name: string[16], size: int32)").is_ok());
+	ASSERT_TRUE(db.execute("insert (name = \"Kazan\", size = 1) to cities").is_ok());
+	auto rs = db.execute("select size, name, id from cities");
+	ASSERT_EQ(rs.get_row_count(), 1);
+	EXPECT_EQ((*rs.begin()).get<std::string>("name"), "Kazan");
+	EXPECT_EQ((*rs.begin()).get<int32_t>("size"), 1);
+	rs = db.execute("select score, login from users where id = 5");
+	EXPECT_EQ((*rs.begin()).get<std::string>("login"), "user4");
+	EXPECT_EQ((*rs.begin()).get<int32_t>("score"), 4);
+}
+
+TEST(MemdbTest, ExecuteAsync)
+{
+	Database db(4);
+	make_users(db, 1000);
+	ASSERT_TRUE(db.execute("create ordered index on users by score").is_ok());
+
+	std::vector<std::future<ResultSet>> selects;
+	std::vector<std::future<ResultSet>> inserts;
+	for (int i = 0; i < 100; ++i)
+	{
+		selects.push_back(db.execute_async("select id from users where score >= " + std::to_string(i * 10) +
+			" && score < " + std::to_string(i * 10 + 10)));
+		inserts.push_back(db.execute_async("insert (login = \"new\", score = " + std::to_string(2000 + i) + ") to users"));
+	}
+	for (auto &f : selects)
+	{
+		ResultSet rs = f.get();
+		ASSERT_TRUE(rs.is_ok()) << rs.get_error();
+		EXPECT_EQ(rs.get_row_count(), 10);
+	}
+	for (auto &f : inserts)
+		EXPECT_TRUE(f.get().is_ok());
+	EXPECT_EQ(db.execute("select id from users where score >= 2000").get_row_count(), 100);
+
+	std::vector<std::string> queries;
+	for (int i = 0; i < 50; ++i)
+		queries.push_back("select id from users where login = \"user" + std::to_string(i % 10) + "\"");
+	queries.push_back("select id from missing");
+	auto results = db.execute_batch(queries);
+	ASSERT_EQ(results.size(), 51);
+	for (size_t i = 0; i < 50; ++i)
+		EXPECT_EQ(results[i].get().get_row_count(), 100);
+	EXPECT_FALSE(results[50].get().is_ok());
+
+	std::promise<size_t> promise;
+	db.execute_async("select id from users", [&promise](ResultSet rs) { promise.set_value(rs.get_row_count()); });
+	EXPECT_EQ(promise.get_future().get(), 1100);
+
+	ExecutorStats stats = db.get_executor_stats();
+	EXPECT_EQ(stats.threads, 4);
+	EXPECT_EQ(stats.submitted, 252);
+	EXPECT_LE(stats.completed, stats.submitted); // a task is counted after its result is ready
+	EXPECT_EQ(stats.queue_depth, 0);
+	EXPECT_GE(stats.max_queue_depth, 1);
+	EXPECT_GT(stats.exec_ns, 0);
+
+	// Direct calls lock the database as the queries do: the storage grows under the selects
+	ASSERT_TRUE(db.create_table("log", { Column(Type::INT, "n") }).is_ok());
+	selects.clear();
+	for (int i = 0; i < 200; ++i)
+		selects.push_back(db.execute_async("select id from users where score < 10"));
+	std::thread writer_thread([&db]()
+	{
+		RowWriter w = db.writer("users");
+		size_t login = w.column("login"), score = w.column("score");
+		for (int i = 0; i < 2000; ++i)
+			w.set_string(login, "writer").set_int(score, 5000 + i).commit();
+	});
+	std::thread insert_thread([&db]()
+	{
+		for (int i = 0; i < 2000; ++i)
+			db.insert("log", { Value(i) });
+	});
+	for (int i = 0; i < 200; ++i)
+		EXPECT_EQ(db.select("users", { "id" }, { std::make_pair(Condition(Value(10), RelOp::LT), (size_t)3) }).get_row_count(), 10);
+	writer_thread.join();
+	insert_thread.join();
+	for (auto &f : selects)
+		EXPECT_EQ(f.get().get_row_count(), 10);
+	EXPECT_EQ(db.execute("select id from users where score >= 5000").get_row_count(), 2000);
+	EXPECT_EQ(db.select_all("log").get_row_count(), 2000);
+}
+
+TEST(MemdbTest, ServerClient)
+{
+	Database db;
+	make_users(db, 100);
+	std::string path = "/tmp/memdb_test_" + std::to_string(::getpid()) + ".sock";
+	Server server(db, path);
+	std::thread server_thread([&server]() { server.run(); });
+	{
+		Client client(path);
+		auto rs = client.execute("select login, id, is_admin from users where id <= 3");
+		ASSERT_TRUE(rs.is_ok()) << rs.get_error();
+		ASSERT_EQ(rs.get_row_count(), 3);
+		EXPECT_EQ(rs.get_columns(), (std::vector<std::string>{"login", "id", "is_admin"}));
+		EXPECT_EQ((*rs.begin()).get<std::string>("login"), "user0");
+		EXPECT_EQ((*rs.begin()).get<int32_t>(1), 1);
+		EXPECT_TRUE((*rs.begin()).get<bool>(2));
+		EXPECT_EQ(rs.get_stats().rows_matched, 3);
+
+		// pipelined requests are answered in order
+		for (int i = 1; i <= 10; ++i)
+			client.send("select id from users where id = " + std::to_string(i));
+		client.send("select id from missing");
+		client.send("insert (login = \"new\") to users");
+		EXPECT_EQ(client.pending(), 12);
+		for (int i = 1; i <= 10; ++i)
+		{
+			rs = client.receive();
+			ASSERT_EQ(rs.get_row_count(), 1);
+			EXPECT_EQ((*rs.begin()).get<int32_t>("id"), i);
+		}
+		rs = client.receive();
+		EXPECT_FALSE(rs.is_ok());
+		EXPECT_EQ(rs.get_error(), "No table with the given name was found.");
+		EXPECT_TRUE(client.receive().is_ok());
+		EXPECT_EQ(client.pending(), 0);
+		EXPECT_THROW(client.receive(), std::runtime_error);
+	}
+	EXPECT_EQ(db.execute("select id from users").get_row_count(), 101);
+
+	// A malformed query is answered with an error, the server goes on
+	{
+		Client client(path);
+		auto rs = client.execute("select a from t where a @ 1");
+		EXPECT_FALSE(rs.is_ok());
+		EXPECT_FALSE(rs.get_error().empty());
+		EXPECT_EQ(client.execute("select id from users where id <= 3").get_row_count(), 3);
+	}
+	EXPECT_FALSE(db.execute("select a from t where a @ 1").is_ok());
+
+	// The threads of the closed connections are joined
+	for (int i = 0; i < 5; ++i)
+	{
+		Client client(path);
+		EXPECT_TRUE(client.execute("select id from users where id = 1").is_ok());
+	}
+	for (int i = 0; i < 100 && server.connection_count() > 0; ++i)
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	EXPECT_EQ(server.connection_count(), 0);
+
+	server.stop();
+	server_thread.join();
+}
+
+TEST(MemdbTest, HashPartitioning)
+{
+	Database db;
+	ASSERT_TRUE(db.execute("create table events ({key, autoincrement} id: int32, {unique, bloom} code: int32, "
+		"user: string[16], score: int32 = 0) partition by hash(user) into 4").is_ok());
+	EXPECT_FALSE(db.execute("create table bad (x: int32) partition by hash(y) into 4").is_ok());
+	EXPECT_FALSE(db.execute("create table bad (x: int32) partition by hash(x) into 0").is_ok());
+
+	RowWriter w = db.writer("events");
+	ResultSet committed = w.commit(); // rows are inserted by queries
+	EXPECT_FALSE(committed.is_ok());
+	EXPECT_EQ(committed.get_error(), "RowWriter is not supported for partitioned tables, insert the rows by queries.");
+	EXPECT_THROW(w.column("code"), std::runtime_error);
+	for (int i = 0; i < 20000; ++i)
+	{
+		std::string query = "insert (code = " + std::to_string(i) + ", user = \"user" + std::to_string(i % 10) +
+			"\", score = " + std::to_string(i) + ") to events";
+		ASSERT_TRUE(db.execute(query).is_ok());
+	}
+	EXPECT_FALSE(db.execute("insert (code = 5, user = \"other\") to events").is_ok()); // unique in all partitions
+	ASSERT_TRUE(db.execute("create ordered index on events by score").is_ok());
+
+	auto rs = db.execute("select id, user from events");
+	ASSERT_TRUE(rs.is_ok()) << rs.get_error();
+	EXPECT_EQ(rs.get_row_count(), 20000);
+	std::set<int> ids;
+	for (auto row : rs)
+		ids.insert(row.get<int>("id"));
+	EXPECT_EQ(ids.size(), 20000); // one autoincrement for all partitions
+	EXPECT_EQ(*ids.rbegin(), 20000);
+
+	rs = db.execute("select id, score from events where user = \"user3\" && score < 100");
+	ASSERT_TRUE(rs.is_ok()) << rs.get_error();
+	EXPECT_EQ(rs.get_row_count(), 10);
+	auto items = explain(db, "explain analyze select id from events where user = \"user3\" && score < 100");
+	EXPECT_EQ(items["partitions"], "1 of 4");
+	EXPECT_EQ(items["access path"], "index range");
+	items = explain(db, "explain select id from events where score < 100");
+	EXPECT_EQ(items["partitions"], "4 of 4");
+
+	rs = db.execute("select user, count(*), sum(score), min(score), max(score) from events where score < 1000 group by user");
+	ASSERT_TRUE(rs.is_ok()) << rs.get_error();
+	ASSERT_EQ(rs.get_row_count(), 10);
+	for (auto row : rs)
+	{
+		int k = row.get<std::string>("user")[4] - '0';
+		EXPECT_EQ(row.get<int>("count(*)"), 100);
+		EXPECT_EQ(row.get<int>("sum(score)"), 100 * k + 10 * 99 * 100 / 2);
+		EXPECT_EQ(row.get<int>("min(score)"), k);
+		EXPECT_EQ(row.get<int>("max(score)"), 990 + k);
+	}
+	rs = db.execute("select min(user), max(score), count(id) from events where score >= 19990");
+	ASSERT_TRUE(rs.is_ok()) << rs.get_error();
+	ASSERT_EQ(rs.get_row_count(), 1);
+	for (auto row : rs)
+	{
+		EXPECT_EQ(row.get<std::string>("min(user)"), "user0");
+		EXPECT_EQ(row.get<int>("max(score)"), 19999);
+		EXPECT_EQ(row.get<int>("count(id)"), 10);
+	}
+
+	std::stringstream file;
+	db.save_to_file(file);
+	Database loaded;
+	loaded.load_from_file(file);
+	EXPECT_EQ(loaded.execute("select id from events where user = \"user7\"").get_row_count(), 2000);
+	ASSERT_TRUE(loaded.execute("insert (code = 20000, user = \"user1\") to events").is_ok());
+	rs = loaded.execute("select id from events where code = 20000");
+	ASSERT_EQ(rs.get_row_count(), 1);
+	for (auto row : rs)
+		EXPECT_EQ(row.get<int>("id"), 20001);
+}
+
+TEST(MemdbTest, RangePartitioning)
+{
+	Database db;
+	ASSERT_TRUE(db.execute("create table log ({key, autoincrement} id: int32, ts: int32, level: int32 = 0, "
+		"message: string[32]) partition by range(ts) every 1000").is_ok());
+	EXPECT_FALSE(db.execute("create table bad (x: string[8]) partition by range(x)").is_ok());
+	EXPECT_FALSE(db.execute("create table bad (x: int32) partition by range(x) every 0").is_ok());
+
+	// No partitions yet
+	auto rs = db.execute("select id, message from log where id > 10");
+	ASSERT_TRUE(rs.is_ok()) << rs.get_error();
+	EXPECT_EQ(rs.get_row_count(), 0);
+	rs = db.execute("select count(*) from log");
+	ASSERT_TRUE(rs.is_ok()) << rs.get_error();
+	for (auto row : rs)
+		EXPECT_EQ(row.get<int>("count(*)"), 0);
+
+	ASSERT_TRUE(db.execute("create ordered index on log by level").is_ok());
+	for (int i = 0; i < 5500; ++i)
+	{
+		std::string query = "insert (ts = " + std::to_string(i) + ", level = " + std::to_string(i % 5) + ", message = \"m" + std::to_string(i) + "\") to log";
+		ASSERT_TRUE(db.execute(query).is_ok());
+	}
+	EXPECT_EQ(db.execute("select id from log").get_row_count(), 5500);
+
+	auto items = explain(db, "explain analyze select id from log where ts >= 5200 && level = 1");
+	EXPECT_EQ(items["partitions"], "1 of 6");
+	EXPECT_EQ(items["result rows"], "60");
+	items = explain(db, "explain select id from log where 2500 > ts && ts > 999");
+	EXPECT_EQ(items["partitions"], "2 of 6");
+	items = explain(db, "explain select id from log where ts < 0");
+	EXPECT_EQ(items["partitions"], "0 of 6");
+	EXPECT_EQ(items["access path"], "none");
+	EXPECT_EQ(db.execute("select id from log where ts < 2500 && ts > 999").get_row_count(), 1500);
+
+	rs = db.execute("select level, count(*) from log where ts >= 4000 group by level");
+	ASSERT_TRUE(rs.is_ok()) << rs.get_error();
+	ASSERT_EQ(rs.get_row_count(), 5);
+	for (auto row : rs)
+		EXPECT_EQ(row.get<int>("count(*)"), 300);
+
+	ASSERT_TRUE(db.freeze_partitions("log", 2000).is_ok());
+	EXPECT_FALSE(db.execute("insert (ts = 5, message = \"late\") to log").is_ok());
+	EXPECT_TRUE(db.execute("insert (ts = 2005, message = \"late\") to log").is_ok());
+	EXPECT_FALSE(db.freeze_partitions("missing", 2000).is_ok());
+	EXPECT_EQ(db.execute("select id from log where ts < 2000").get_row_count(), 2000);
+
+	ASSERT_TRUE(db.drop_partitions("log", 3500).is_ok());
+	EXPECT_EQ(db.execute("select id from log").get_row_count(), 2500);
+	items = explain(db, "explain select id from log");
+	EXPECT_EQ(items["partitions"], "3 of 3");
+
+	std::stringstream file;
+	db.save_to_file(file);
+	Database loaded;
+	loaded.load_from_file(file);
+	ASSERT_TRUE(loaded.execute("insert (ts = 5500, level = 7, message = \"new\") to log").is_ok());
+	rs = loaded.execute("select id from log where level = 7");
+	ASSERT_EQ(rs.get_row_count(), 1);
+	for (auto row : rs)
+		EXPECT_EQ(row.get<int>("id"), 5502);
+	items = explain(loaded, "explain select id from log where ts > 5000 && level = 7");
+	EXPECT_EQ(items["partitions"], "1 of 3");
+	EXPECT_EQ(items["access path"], "index range");
+
+	// Groups of a string column found in several partitions are merged
+	ASSERT_TRUE(db.execute("create table tags (ts: int32, tag: string[24]) partition by range(ts) every 10").is_ok());
+	const char* tags[] = { "a", "bb", "a longer tag value" };
+	for (int i = 0; i < 90; ++i)
+	{
+		std::string query = "insert (ts = " + std::to_string(i) + ", tag = \"" + tags[(i / 10 + i) % 3] + "\") to tags";
+		ASSERT_TRUE(db.execute(query).is_ok());
+	}
+	rs = db.execute("select tag, count(*) from tags group by tag");
+	ASSERT_TRUE(rs.is_ok()) << rs.get_error();
+	ASSERT_EQ(rs.get_row_count(), 3);
+	for (auto row : rs)
+		EXPECT_EQ(row.get<int>("count(*)"), 30) << row.get<std::string>("tag");
+}
+
+TEST(MemdbTest, LikeAndStartsWith)
+{
+	Database db;
+	ASSERT_TRUE(db.execute("create table people ({key, autoincrement} id: int32, name: string[40], {dict} city: string[16])").is_ok());
+	const char* cities[] = { "Moscow", "Minsk", "Kazan", "Omsk" };
+	for (int i = 0; i < 2000; ++i)
+	{
+		std::string query = "insert (name = \"user" + std::to_string(i) + (i % 2 ? "odd" : "even") +
+			"\", city = \"" + cities[i % 4] + "\") to people";
+		ASSERT_TRUE(db.execute(query).is_ok());
+	}
+	ASSERT_TRUE(db.execute("create ordered index on people by name").is_ok());
+
+	auto items = explain(db, "explain analyze select id from people where name starts_with \"user12\"");
+	EXPECT_EQ(items["access path"], "index range");
+	EXPECT_EQ(items["range"], "name >= \"user12\" && name < \"user13\"");
+	EXPECT_EQ(items["predicates"], "none");
+	EXPECT_EQ(items["result rows"], "111"); // 12, 120..129, 1200..1299
+
+	items = explain(db, "explain analyze select id from people where name like \"user12%odd\"");
+	EXPECT_EQ(items["access path"], "index range");
+	EXPECT_EQ(items["predicates"], "name like \"user12%odd\"");
+	EXPECT_EQ(items["result rows"], "55");
+
+	EXPECT_EQ(db.execute("select id from people where name like \"%9_9%\"").get_row_count(), 20);
+	EXPECT_EQ(db.execute("select id from people where name like \"user1__\"").get_row_count(), 0);
+	EXPECT_EQ(db.execute("select id from people where name starts_with \"user_\"").get_row_count(), 0);
+	EXPECT_EQ(db.execute("select id from people where name like \"user1__odd\"").get_row_count(), 50);
+	EXPECT_EQ(db.execute("select id from people where name like \"%even\" && id <= 10").get_row_count(), 5);
+	EXPECT_EQ(db.execute("select id from people where city like \"M%\"").get_row_count(), 1000);
+	EXPECT_EQ(db.execute("select id from people where city like \"%sk\"").get_row_count(), 1000);
+	EXPECT_EQ(db.execute("select id from people where city starts_with \"Om\" || city = \"Kazan\"").get_row_count(), 1000);
+	EXPECT_EQ(db.execute("select id from people where \"Moscow\" like city").get_row_count(), 500);
+	EXPECT_EQ(db.execute("select id from people where name like \"\"").get_row_count(), 0);
+	EXPECT_FALSE(db.execute("select id from people where id like \"1%\"").is_ok());
+	EXPECT_FALSE(db.execute("select id from people where name like 1").is_ok());
+
+	// The vectorized substring search agrees with the plain one
+	std::string hay;
+	for (int i = 0; i < 300; ++i)
+		hay += (char)('a' + (i * 7) % 5);
+	for (size_t m = 1; m < 20; ++m)
+	{
+		for (size_t start = 0; start + m <= hay.size(); start += 13)
+		{
+			std::string needle = hay.substr(start, m);
+			EXPECT_EQ(find_substring(hay.data(), hay.size(), needle.data(), m), hay.find(needle));
+		}
+	}
+	EXPECT_EQ(find_substring(hay.data(), hay.size(), "x", 1), hay.size());
+}
+
+TEST(MemdbTest, TrigramIndex)
+{
+	Database db;
+	ASSERT_TRUE(db.execute("create table people ({key, autoincrement} id: int32, name: string[40], {dict} city: string[16])").is_ok());
+	const char* cities[] = { "Moscow", "Minsk", "Kazan", "Omsk" };
+	auto insert = [&](int from, int to)
+	{
+		for (int i = from; i < to; ++i)
+		{
+			std::string query = "insert (name = \"user" + std::to_string(i) + (i % 2 ? "odd" : "even") +
+				"\", city = \"" + cities[i % 4] + "\") to people";
+			ASSERT_TRUE(db.execute(query).is_ok());
+		}
+	};
+	insert(0, 1000);
+	ASSERT_TRUE(db.execute("create trigram index on people by name, city").is_ok());
+	EXPECT_FALSE(db.execute("create trigram index on people by name").is_ok());
+	EXPECT_FALSE(db.execute("create trigram index on people by id").is_ok());
+	insert(1000, 2000); // rows added after the index is created
+
+	auto items = explain(db, "explain analyze select id from people where name like \"%123%\"");
+	EXPECT_EQ(items["access path"], "trigram index");
+	EXPECT_EQ(items["index"], "name");
+	EXPECT_EQ(items["pattern"], "name like \"%123%\"");
+	EXPECT_EQ(items["result rows"], "12"); // 123, 1123, 1230..1239
+	EXPECT_EQ(items["rows examined"], "12");
+
+	// Only the literal parts of the pattern are looked up, the rows are checked by the whole pattern
+	EXPECT_EQ(db.execute("select id from people where name like \"%12_4odd%\"").get_row_count(), 0);
+	EXPECT_EQ(db.execute("select id from people where name like \"%12_5odd%\"").get_row_count(), 10);
+	EXPECT_EQ(db.execute("select id from people where name like \"%9_9%\"").get_row_count(), 20);
+	EXPECT_EQ(db.execute("select id from people where name like \"%1999odd\" && id > 0").get_row_count(), 1);
+	EXPECT_EQ(db.execute("select id from people where name like \"%xyz%\"").get_row_count(), 0);
+	EXPECT_EQ(db.execute("select id from people where city like \"%sk%\"").get_row_count(), 1000);
+
+	std::stringstream ss;
+	db.save_to_file(ss);
+	Database db2;
+	db2.load_from_file(ss);
+	items = explain(db2, "explain analyze select id from people where name like \"%123%\"");
+	EXPECT_EQ(items["access path"], "trigram index");
+	EXPECT_EQ(items["result rows"], "12");
+	ASSERT_TRUE(db2.execute("insert (name = \"x123\", city = \"Omsk\") to people").is_ok());
+	EXPECT_EQ(db2.execute("select id from people where name like \"%123%\"").get_row_count(), 13);
+
+	// Partitions get the index, including the ones created later
+	ASSERT_TRUE(db.execute("create table events (ts: int32, msg: string[32]) partition by range(ts) every 100").is_ok());
+	ASSERT_TRUE(db.execute("create trigram index on events by msg").is_ok());
+	for (int i = 0; i < 500; ++i)
+		ASSERT_TRUE(db.execute("insert (" + std::to_string(i) + ", \"event" + std::to_string(i) + "\") to events").is_ok());
+	EXPECT_EQ(db.execute("select ts from events where msg like \"%t42%\"").get_row_count(), 11);
+}
+
+TEST(MemdbTest, ResultCache)
+{
+	Database db;
+	make_users(db, 1000);
+	db.set_result_cache(1 << 20);
+
+	ResultSet first = db.execute("select id, login from users where score < 100");
+	ResultSet second = db.execute("SELECT id,login FROM users WHERE score<100");
+	ASSERT_TRUE(second.is_ok());
+	EXPECT_EQ(second.get_row_count(), 100);
+	EXPECT_EQ(second.get_stats().rows_examined, 0); // not executed
+	EXPECT_EQ((*second.begin()).get<int32_t>("id"), (*first.begin()).get<int32_t>("id"));
+	ResultCacheStats stats = db.get_result_cache_stats();
+	EXPECT_EQ(stats.hits, 1);
+	EXPECT_EQ(stats.misses, 1);
+	EXPECT_EQ(stats.entries, 1);
+
+	// Other literals make another query
+	EXPECT_EQ(db.execute("select id, login from users where score < 10").get_row_count(), 10);
+	EXPECT_EQ(db.get_result_cache_stats().misses, 2);
+
+	// A change of the table invalidates its results
+	ASSERT_TRUE(db.execute("insert (login = \"new\", score = 5) to users").is_ok());
+	EXPECT_EQ(db.execute("select id, login from users where score < 100").get_row_count(), 101);
+	RowWriter w = db.writer("users");
+	ASSERT_TRUE(w.set_string(1, "writer").set_int(3, 7).commit().is_ok());
+	EXPECT_EQ(db.execute("select id, login from users where score < 100").get_row_count(), 102);
+	stats = db.get_result_cache_stats();
+	EXPECT_EQ(stats.hits, 1);
+	EXPECT_EQ(stats.misses, 4);
+	EXPECT_EQ(db.execute("select id, login from users where score < 100").get_row_count(), 102);
+	EXPECT_EQ(db.get_result_cache_stats().hits, 2);
+	EXPECT_FALSE(db.execute("select id from missing").is_ok());
+
+	// The least recently used results are evicted to stay within the budget
+	db.set_result_cache(16 * 1024);
+	for (int i = 0; i < 50; ++i)
+		EXPECT_EQ(db.execute("select id, login from users where score >= " + std::to_string(i * 10) + " && score < " +
+			std::to_string(i * 10 + 10)).get_row_count(), i == 0 ? 12 : 10);
+	stats = db.get_result_cache_stats();
+	EXPECT_GT(stats.evictions, 0);
+	EXPECT_LE(stats.bytes, 16 * 1024);
+	EXPECT_EQ(stats.entries + stats.evictions, 50);
+	db.execute("select id, login from users where score >= 490 && score < 500");
+	EXPECT_EQ(db.get_result_cache_stats().hits, 1);
+
+	// Partitioned tables and loading
+	ASSERT_TRUE(db.execute("create table events (ts: int32, msg: string[16]) partition by range(ts) every 100").is_ok());
+	ASSERT_TRUE(db.execute("insert (1, \"a\") to events").is_ok());
+	EXPECT_EQ(db.execute("select ts from events where ts < 1000").get_row_count(), 1);
+	ASSERT_TRUE(db.execute("insert (500, \"b\") to events").is_ok());
+	EXPECT_EQ(db.execute("select ts from events where ts < 1000").get_row_count(), 2);
+	ASSERT_TRUE(db.drop_partitions("events", 100).is_ok());
+	EXPECT_EQ(db.execute("select ts from events where ts < 1000").get_row_count(), 1);
+
+	std::stringstream ss;
+	Database other;
+	make_users(other, 10);
+	other.save_to_file(ss);
+	db.load_from_file(ss);
+	EXPECT_EQ(db.get_result_cache_stats().entries, 0);
+	EXPECT_EQ(db.execute("select id, login from users where score < 100").get_row_count(), 10);
+}
+
+TEST(MemdbTest, PlanCache)
+{
+	Database db;
+	make_users(db, 1000);
+	ASSERT_TRUE(db.execute("create ordered index on users by score").is_ok());
+	PlanCacheStats before = db.get_plan_cache_stats();
+
+	// Queries differing only in literals share the parsed select
+	for (int i = 0; i < 10; ++i)
+	{
+		ResultSet rs = db.execute("select id, score from users where score = " + std::to_string(i * 100) + " && is_admin");
+		ASSERT_TRUE(rs.is_ok()) << rs.get_error();
+		EXPECT_EQ(rs.get_row_count(), i % 3 == 0 ? 1 : 0);
+	}
+	PlanCacheStats stats = db.get_plan_cache_stats();
+	EXPECT_EQ(stats.misses - before.misses, 1);
+	EXPECT_EQ(stats.hits - before.hits, 9);
+
+	// The access path is still chosen by the literal values
+	auto items = explain(db, "explain select id from users where score < 10");
+	EXPECT_EQ(items["access path"], "index range");
+	EXPECT_EQ(db.execute("select id from users where score < 10").get_row_count(), 10);
+	EXPECT_EQ(db.execute("select id from users where score < 1000").get_row_count(), 1000);
+	EXPECT_EQ(db.execute("select id from users where login like \"%9\"").get_row_count(), 100);
+	EXPECT_EQ(db.execute("select id from users where login like \"user1%\"").get_row_count(), 100);
+
+	// Conditions which are not simple and groups get their literals too
+	EXPECT_EQ(db.execute("select id from users where score < 10 || score >= 990").get_row_count(), 20);
+	EXPECT_EQ(db.execute("select id from users where score < 50 || score >= 900").get_row_count(), 150);
+	EXPECT_EQ(db.execute("select login, count(*) from users where score < 100 group by login").get_row_count(), 10);
+	EXPECT_EQ(db.execute("select login, count(*) from users where score < 5 group by login").get_row_count(), 5);
+
+	// Folded constants and literals deciding the result alone are not reused
+	EXPECT_EQ(db.execute("select id from users where score < 2 + 3").get_row_count(), 5);
+	EXPECT_EQ(db.execute("select id from users where score < 4 + 4").get_row_count(), 8);
+	EXPECT_EQ(db.execute("select id from users where score > -1 && score < 3").get_row_count(), 3);
+	EXPECT_EQ(db.execute("select id from users where score > -5 && score < 1").get_row_count(), 1);
+	EXPECT_EQ(db.execute("select id from users where is_admin && true").get_row_count(), 334);
+	EXPECT_EQ(db.execute("select id from users where is_admin && false").get_row_count(), 0);
+	EXPECT_EQ(db.execute("select id from users where score < 1 + 1 || false").get_row_count(), 2);
+	EXPECT_EQ(db.execute("select id from users where score < 1 + 1 || true").get_row_count(), 1000);
+
+	// Errors are reported by every query
+	EXPECT_FALSE(db.execute("select id from users where missing = 1").is_ok());
+	EXPECT_FALSE(db.execute("select id from users where missing = 2").is_ok());
+	EXPECT_FALSE(db.execute("select missing from users where score = 1").is_ok());
+	EXPECT_FALSE(db.execute("select missing from users where score = 2").is_ok());
+
+	// A column compared to a column is not a condition on the values of the last checked row
+	ASSERT_TRUE(db.execute("create table pairs (a: int32, b: int32)").is_ok());
+	for (int i = 0; i < 10; ++i)
+		ASSERT_TRUE(db.insert("pairs", { Value(i), Value(i < 5 ? i + 1 : i - 1) }).is_ok());
+	for (int k = 0; k < 3; ++k)
+	{
+		EXPECT_EQ(db.execute("select a from pairs where a < b").get_row_count(), 5);
+		EXPECT_EQ(db.execute("select a from pairs where a < b && a > -1").get_row_count(), 5);
+		EXPECT_EQ(db.execute("select a from pairs where a < b && a > 2").get_row_count(), 2);
+	}
+	for (int i = 0; i < 1000; ++i)
+		ASSERT_TRUE(db.insert("pairs", { Value(i), Value(i) }).is_ok());
+	EXPECT_EQ(db.execute("select a from pairs where a < b").get_row_count(), 5);
+
+	db.set_plan_cache(0);
+	EXPECT_EQ(db.execute("select id from users where score < 10").get_row_count(), 10);
+	EXPECT_EQ(db.get_plan_cache_stats().hits, 0);
+}
+
+TEST(MemdbTest, IndexIntersection)
+{
+	Database db;
+	ASSERT_TRUE(db.execute("create table points ({key, autoincrement} id: int32, x: int32, y: int32, z: int32)").is_ok());
+	ASSERT_TRUE(db.execute("create table plain (id: int32, x: int32, y: int32, z: int32)").is_ok());
+	const int n = 50000;
+	for (int i = 0; i < n; ++i)
+	{
+		std::vector<Value> values = { Value(), Value(i % 100), Value(i / 500), Value(i % 7) };
+		ASSERT_TRUE(db.insert("points", values).is_ok());
+		values[0] = Value(i);
+		ASSERT_TRUE(db.insert("plain", values).is_ok());
+	}
+	ASSERT_TRUE(db.execute("create ordered index on points by x, y").is_ok());
+
+	// Two moderately selective ranges are intersected as row bitmaps
+	auto items = explain(db, "explain analyze select id from points where x < 10 && y >= 20 && y < 40 && z = 3");
+	EXPECT_EQ(items["access path"], "index intersection");
+	EXPECT_EQ(items["predicates"], "z = 3");
+	EXPECT_EQ(items["rows examined"], "1000");
+	EXPECT_EQ(items["result rows"], std::to_string(db.execute("select id from plain where x < 10 && y >= 20 && y < 40 && z = 3").get_row_count()));
+
+	// A highly selective range alone is cheaper
+	items = explain(db, "explain select id from points where id < 50 && x < 50");
+	EXPECT_EQ(items["access path"], "index range");
+
+	// The rows are the same as found by a scan and come in ascending order
+	const char* conditions[] = {
+		"x < 10 && y < 20", "x >= 50 && x < 60 && y > 60", "x = 7 && y >= 0", "x > 95 && y < 50 && z != 2", "x < 3 && y > 90 && y < 10" };
+	for (const char* cond : conditions)
+	{
+		ResultSet indexed = db.execute(std::string("select id from points where ") + cond);
+		ResultSet scanned = db.execute(std::string("select id from plain where ") + cond);
+		ASSERT_TRUE(indexed.is_ok()) << indexed.get_error();
+		ASSERT_EQ(indexed.get_row_count(), scanned.get_row_count()) << cond;
+		auto it = scanned.begin();
+		for (auto row : indexed)
+		{
+			EXPECT_EQ(row.get<int32_t>("id") - 1, (*it).get<int32_t>("id"));
+			++it;
+		}
+	}
+
+	// Bitmaps with sparse and dense chunks
+	std::vector<size_t> evens, threes;
+	for (size_t i = 0; i < 300000; i += 2)
+		evens.push_back(i);
+	for (size_t i = 0; i < 300000; i += (i < 150000 ? 3 : 301))
+		threes.push_back(i);
+	std::reverse(threes.begin(), threes.end());
+	RowBitmap both = RowBitmap::from_rows(evens.begin(), evens.end()).intersect(RowBitmap::from_rows(threes.begin(), threes.end()));
+	std::vector<size_t> rows;
+	both.for_each([&rows](size_t row) { rows.push_back(row); });
+	std::vector<size_t> expected;
+	std::sort(threes.begin(), threes.end());
+	std::set_intersection(evens.begin(), evens.end(), threes.begin(), threes.end(), std::back_inserter(expected));
+	EXPECT_EQ(rows, expected);
+	EXPECT_EQ(both.size(), expected.size());
+	EXPECT_TRUE(both.contains(6));
+	EXPECT_FALSE(both.contains(4));
+}
+
+TEST(MemdbTest, OrAndNotEqual)
+{
+	Database db;
+	ASSERT_TRUE(db.execute("create table points ({key, autoincrement} id: int32, x: int32, y: int32, z: int32)").is_ok());
+	ASSERT_TRUE(db.execute("create table plain (id: int32, x: int32, y: int32, z: int32)").is_ok());
+	const int n = 50000;
+	for (int i = 0; i < n; ++i)
+	{
+		std::vector<Value> values = { Value(), Value(i % 100), Value(i / 500), Value(i % 1000 == 0 ? i / 1000 : 0) };
+		ASSERT_TRUE(db.insert("points", values).is_ok());
+		values[0] = Value(i);
+		ASSERT_TRUE(db.insert("plain", values).is_ok());
+	}
+	ASSERT_TRUE(db.execute("create ordered index on points by x, y, z").is_ok());
+
+	// Every conjunction is found by its index, the rows are merged
+	auto items = explain(db, "explain analyze select id from points where x = 3 || y = 10 && z = 0 || y > 95");
+	EXPECT_EQ(items["access path"], "index union");
+	EXPECT_EQ(items["disjunct 1"], "index range: x = 3");
+	EXPECT_EQ(items["result rows"], std::to_string(db.execute("select id from plain where x = 3 || y = 10 && z = 0 || y > 95").get_row_count()));
+
+	// A rare value is excluded by the two ranges around the frequent one
+	items = explain(db, "explain analyze select id from points where z != 0");
+	EXPECT_EQ(items["access path"], "index range");
+	EXPECT_EQ(items["result rows"], "49");
+	EXPECT_EQ(items["rows examined"], "49");
+
+	// A conjunction without an index needs a full scan anyway
+	items = explain(db, "explain select id from points where x = 3 || id % 7 = 1");
+	EXPECT_EQ(items["access path"], "full scan");
+	items = explain(db, "explain select id from points where x < 90 || y > 10");
+	EXPECT_EQ(items["access path"], "full scan");
+
+	// The rows are the same as found by a scan, found once and in ascending order
+	const char* conditions[] = {
+		"x = 3 || x = 5", "x < 2 || y < 2", "(x = 1 || x = 2) && (y = 7 || y > 97)", "z != 0 || x = 99",
+		"x = 3 || x = 3 && y < 10", "x != 50 && y = 3", "x < 2 || x > 2 && x < 1" };
+	for (const char* cond : conditions)
+	{
+		ResultSet indexed = db.execute(std::string("select id from points where ") + cond);
+		ResultSet scanned = db.execute(std::string("select id from plain where ") + cond);
+		ASSERT_TRUE(indexed.is_ok()) << indexed.get_error();
+		ASSERT_EQ(indexed.get_row_count(), scanned.get_row_count()) << cond;
+		auto it = scanned.begin();
+		for (auto row : indexed)
+		{
+			EXPECT_EQ(row.get<int32_t>("id") - 1, (*it).get<int32_t>("id"));
+			++it;
+		}
+	}
+}
+
+TEST(MemdbTest, PredicateNormalization)
+{
+	auto normalize = [](const std::string& cond)
+	{
+		std::string text = "select id from points where " + cond;
+		Lexer lexer(text);
+		auto lexems = lexer.tokenize();
+		SelectParser parser(lexems);
+		SelectDef def = parser.parse();
+		return to_string(def.ast);
+	};
+	EXPECT_EQ(normalize("5 < x"), "(x > 5)");
+	EXPECT_EQ(normalize("x + 1 > 5"), "(x > 4)");
+	EXPECT_EQ(normalize("10 - x >= 3 + 1"), "(x <= 6)");
+	EXPECT_EQ(normalize("1 + (x - 2) = 7"), "(x = 8)");
+	EXPECT_EQ(normalize("x * 2 > 5"), "((x * 2) > 5)");
+	EXPECT_EQ(normalize("!(x >= 10)"), "(x < 10)");
+	EXPECT_EQ(normalize("!(x < 1 || !flag)"), "((x >= 1) && flag)");
+	EXPECT_EQ(normalize("x > 3 && y < 2 && x > 5"), "((y < 2) && (x > 5))");
+	EXPECT_EQ(normalize("x >= 5 && x > 5"), "(x > 5)");
+	EXPECT_EQ(normalize("x = 2 && x < 9"), "(x = 2)");
+	EXPECT_EQ(normalize("x > 5 && x < 3"), "false");
+	EXPECT_EQ(normalize("x = 2 && x = 3"), "false");
+	EXPECT_EQ(normalize("flag && true"), "flag");
+	EXPECT_EQ(normalize("flag || true"), "true");
+
+	Database db;
+	ASSERT_TRUE(db.execute("create table points ({key, autoincrement} id: int32, x: int32, flag: bool)").is_ok());
+	ASSERT_TRUE(db.execute("create table plain (id: int32, x: int32, flag: bool)").is_ok());
+	for (int i = 0; i < 10000; ++i)
+	{
+		std::vector<Value> values = { Value(), Value(i % 1000), Value(i % 3 == 0) };
+		ASSERT_TRUE(db.insert("points", values).is_ok());
+		values[0] = Value(i);
+		ASSERT_TRUE(db.insert("plain", values).is_ok());
+	}
+	ASSERT_TRUE(db.execute("create ordered index on points by x").is_ok());
+
+	// The rewritten conditions use the index and find the same rows
+	const char* conditions[] = {
+		"5 > x", "x + 1 < 5", "990 <= x - 1", "!(x >= 10) && flag", "x > 3 && x > 995", "!(x != 7 || !flag)", "x > 995 && x < 3" };
+	for (const char* cond : conditions)
+	{
+		auto items = explain(db, std::string("explain select id from points where ") + cond);
+		EXPECT_TRUE(items["access path"] == "index range" || items["access path"] == "none") << cond;
+		ResultSet indexed = db.execute(std::string("select id from points where ") + cond);
+		ResultSet scanned = db.execute(std::string("select id from plain where ") + cond);
+		ASSERT_TRUE(indexed.is_ok()) << indexed.get_error();
+		EXPECT_EQ(indexed.get_row_count(), scanned.get_row_count()) << cond;
+	}
+
+	// The dropped parts of the condition are still checked against the table
+	ASSERT_TRUE(db.execute("create table labels (id: int32, s: string[8])").is_ok());
+	ASSERT_TRUE(db.execute("insert (id = 1, s = \"a\") to labels").is_ok());
+	for (const char* cond : { "nosuch > 5 && nosuch < 3", "nosuch && false", "x > 1 || nosuch || true" })
+	{
+		ResultSet rs = db.execute(std::string("select id from points where ") + cond);
+		EXPECT_FALSE(rs.is_ok()) << cond;
+		EXPECT_EQ(rs.get_error(), "Unknown symbol \"nosuch\" in the condition.") << cond;
+		rs = db.execute(std::string("explain select id from points where ") + cond);
+		EXPECT_FALSE(rs.is_ok()) << cond;
+	}
+	ResultSet rs = db.execute("select id from labels where s > 5 && s < 3");
+	EXPECT_FALSE(rs.is_ok());
+	EXPECT_EQ(rs.get_error(), "Invalid type");
+	rs = db.execute("select id from labels where s > \"b\" && s < \"a\"");
+	ASSERT_TRUE(rs.is_ok()) << rs.get_error();
+	EXPECT_EQ(rs.get_row_count(), 0);
+}
+
+TEST(MemdbTest, CheckOrder)
+{
+	Database db;
+	ASSERT_TRUE(db.execute("create table items (id: int32, name: string[16], x: int32)").is_ok());
+	const int n = 20000;
+	for (int i = 0; i < n; ++i)
+	{
+		std::string name = i % 1000 == 0 ? "zz" + std::to_string(i) : "item" + std::to_string(i);
+		ASSERT_TRUE(db.insert("items", { Value(i), Value(name), Value(i % 1000) }).is_ok());
+	}
+
+	// The selective equality on int32 is checked first, the string range only for the rows passing it
+	ResultSet rs = db.execute("select id from items where name >= \"item\" && x = 7");
+	ASSERT_TRUE(rs.is_ok()) << rs.get_error();
+	EXPECT_EQ(rs.get_row_count(), 20);
+	EXPECT_EQ(rs.get_stats().comparisons, n + 20);
+
+	// The pattern is estimated to pass every row, but after the first rows
+	// it is seen to reject almost all of them and is checked first
+	rs = db.execute("select id from items where x < 900 && name like \"%zz%\"");
+	ASSERT_TRUE(rs.is_ok()) << rs.get_error();
+	EXPECT_EQ(rs.get_row_count(), 20);
+	EXPECT_LT(rs.get_stats().comparisons, n * 11 / 10);
+	EXPECT_GT(rs.get_stats().comparisons, n);
+}
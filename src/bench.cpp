@@ -0,0 +1,437 @@
+#include <iostream>
+#include <sstream>
+#include <random>
+#include <map>
+#include <tuple>
+#include <memory>
+#include <vector>
+#include <string>
+
+#include <benchmark/benchmark.h>
+
+#include <memdb.h>
+
+using namespace memdb;
+
+// Benchmarks of the database engine.
+// Parameters of the table: number of rows, distribution of the num column
+// and width of the string and bytes columns. Selects are also parameterized
+// by selectivity in per mille of the num range.
+// The output is JSON unless another format is requested.
+
+enum Distribution
+{
+    UNIFORM,    // random values in [0, rows)
+    SEQUENTIAL, // values in the insertion order
+    SKEWED      // random values concentrated near zero
+};
+
+struct TableParams
+{
+    size_t rows;
+    int distribution;
+    size_t width;
+
+    TableParams(const benchmark::State &state)
+        : rows((size_t)state.range(0)), distribution((int)state.range(1)), width((size_t)state.range(2))
+    {
+    }
+
+    std::string create_query() const
+    {
+        return "create table t ({key, autoincrement} id: int32, num: int32, name: string[" + std::to_string(width) +
+               "], data: bytes[" + std::to_string(width) + "])";
+    }
+
+    std::tuple<size_t, int, size_t> tie() const { return std::make_tuple(rows, distribution, width); }
+};
+
+class Generator
+{
+    std::default_random_engine gen;
+    const TableParams &params;
+    size_t next = 0;
+
+public:
+    Generator(const TableParams &params) : gen(42), params(params) {}
+
+    int32_t num()
+    {
+        std::uniform_real_distribution<double> distr(0.0, 1.0);
+        switch (params.distribution)
+        {
+        case SEQUENTIAL:
+            return (int32_t)next++;
+        case SKEWED:
+        {
+            double u = distr(gen);
+            return (int32_t)(u * u * u * params.rows);
+        }
+        default:
+            return (int32_t)(distr(gen) * params.rows);
+        }
+    }
+
+    std::string name()
+    {
+        std::uniform_int_distribution<int> distr('a', 'z');
+        std::string s(params.width - 1, ' ');
+        for (auto &c : s)
+            c = (char)distr(gen);
+        return s;
+    }
+
+    Bytes data()
+    {
+        std::uniform_int_distribution<int> distr(0, UINT8_MAX);
+        Bytes bytes(params.width);
+        for (auto &b : bytes)
+            b = (uint8_t)distr(gen);
+        return bytes;
+    }
+
+    std::vector<Value> row()
+    {
+        return {Value(), Value(num()), Value(name()), Value(data())};
+    }
+};
+
+static std::unique_ptr<Database> make_database(const TableParams &params)
+{
+    std::unique_ptr<Database> db(new Database());
+    ResultSet rs = db->execute(params.create_query());
+    if (!rs.is_ok())
+        throw std::runtime_error(rs.get_error());
+    Generator gen(params);
+    for (size_t i = 0; i < params.rows; ++i)
+    {
+        db->insert("t", gen.row());
+    }
+    return db;
+}
+
+// Populated tables are shared by the benchmarks which do not change them
+static Database &get_database(const TableParams &params, bool with_index)
+{
+    static std::map<std::tuple<size_t, int, size_t, bool>, std::unique_ptr<Database>> cache;
+    auto key = std::tuple_cat(params.tie(), std::make_tuple(with_index));
+    auto it = cache.find(key);
+    if (it == cache.end())
+    {
+        std::unique_ptr<Database> db = make_database(params);
+        if (with_index)
+            db->execute("create ordered index on t by num");
+        it = cache.insert(std::make_pair(key, std::move(db))).first;
+    }
+    return *it->second;
+}
+
+static void report(benchmark::State &state, const ResultSet &rs)
+{
+    if (!rs.is_ok())
+    {
+        state.SkipWithError(rs.get_error().c_str());
+        return;
+    }
+    const QueryStats &stats = rs.get_stats();
+    state.counters["result_rows"] = (double)rs.get_row_count();
+    state.counters["rows_examined"] = (double)stats.rows_examined;
+    state.counters["plan_ns"] = (double)stats.plan_ns;
+    state.counters["scan_ns"] = (double)stats.scan_ns;
+    state.counters["materialize_ns"] = (double)stats.materialize_ns;
+}
+
+static void table_args(benchmark::internal::Benchmark *b)
+{
+    for (int64_t rows : {10000, 100000})
+        for (int64_t distribution : {UNIFORM, SEQUENTIAL, SKEWED})
+            for (int64_t width : {16, 64})
+                b->Args({rows, distribution, width});
+    b->ArgNames({"rows", "dist", "width"});
+}
+
+static void select_args(benchmark::internal::Benchmark *b)
+{
+    for (int64_t rows : {10000, 100000})
+        for (int64_t distribution : {UNIFORM, SEQUENTIAL, SKEWED})
+            for (int64_t selectivity : {1, 10, 100, 1000})
+                b->Args({rows, distribution, 16, selectivity});
+    b->ArgNames({"rows", "dist", "width", "sel"});
+}
+
+static std::string range_query(const TableParams &params, int64_t selectivity)
+{
+    size_t upper = params.rows * (size_t)selectivity / 1000;
+    return "select id, name from t where num >= 0 && num < " + std::to_string(upper);
+}
+
+static void BM_Insert(benchmark::State &state)
+{
+    TableParams params(state);
+    for (auto _ : state)
+    {
+        state.PauseTiming();
+        Database db;
+        db.execute(params.create_query());
+        Generator gen(params);
+        std::vector<std::vector<Value>> rows;
+        rows.reserve(params.rows);
+        for (size_t i = 0; i < params.rows; ++i)
+            rows.push_back(gen.row());
+        state.ResumeTiming();
+
+        for (const auto &row : rows)
+            db.insert("t", row);
+    }
+    state.SetItemsProcessed(state.iterations() * params.rows);
+}
+BENCHMARK(BM_Insert)->Apply(table_args)->Unit(benchmark::kMillisecond);
+
+static void BM_InsertQuery(benchmark::State &state)
+{
+    TableParams params(state);
+    for (auto _ : state)
+    {
+        state.PauseTiming();
+        Database db;
+        db.execute(params.create_query());
+        Generator gen(params);
+        std::vector<std::string> queries;
+        queries.reserve(params.rows);
+        for (size_t i = 0; i < params.rows; ++i)
+        {
+            queries.push_back("insert (num = " + std::to_string(gen.num()) + ", name = \"" + gen.name() +
+                              "\", data = " + to_string(gen.data()) + ") to t");
+        }
+        state.ResumeTiming();
+
+        for (const auto &query : queries)
+            db.execute(query);
+    }
+    state.SetItemsProcessed(state.iterations() * params.rows);
+}
+BENCHMARK(BM_InsertQuery)->Apply(table_args)->Unit(benchmark::kMillisecond);
+
+static void BM_Writer(benchmark::State &state)
+{
+    TableParams params(state);
+    for (auto _ : state)
+    {
+        state.PauseTiming();
+        Database db;
+        db.execute(params.create_query());
+        Generator gen(params);
+        std::vector<std::tuple<int32_t, std::string, Bytes>> rows;
+        rows.reserve(params.rows);
+        for (size_t i = 0; i < params.rows; ++i)
+            rows.emplace_back(gen.num(), gen.name(), gen.data());
+        state.ResumeTiming();
+
+        RowWriter w = db.writer("t");
+        size_t num = w.column("num"), name = w.column("name"), data = w.column("data");
+        for (const auto &row : rows)
+            w.set_int(num, std::get<0>(row)).set_string(name, std::get<1>(row)).set_bytes(data, std::get<2>(row)).commit();
+    }
+    state.SetItemsProcessed(state.iterations() * params.rows);
+}
+BENCHMARK(BM_Writer)->Apply(table_args)->Unit(benchmark::kMillisecond);
+
+static void BM_IndexBuild(benchmark::State &state)
+{
+    TableParams params(state);
+    for (auto _ : state)
+    {
+        state.PauseTiming();
+        std::unique_ptr<Database> db = make_database(params);
+        state.ResumeTiming();
+
+        ResultSet rs = db->execute("create ordered index on t by num");
+        benchmark::DoNotOptimize(rs);
+
+        state.PauseTiming();
+        db.reset();
+        state.ResumeTiming();
+    }
+    state.SetItemsProcessed(state.iterations() * params.rows);
+}
+BENCHMARK(BM_IndexBuild)->Apply(table_args)->Unit(benchmark::kMillisecond);
+
+static void BM_SelectIndex(benchmark::State &state)
+{
+    TableParams params(state);
+    Database &db = get_database(params, true);
+    std::string query = range_query(params, state.range(3));
+    ResultSet rs;
+    for (auto _ : state)
+    {
+        rs = db.execute(query);
+        benchmark::DoNotOptimize(rs);
+    }
+    report(state, rs);
+}
+BENCHMARK(BM_SelectIndex)->Apply(select_args)->Unit(benchmark::kMicrosecond);
+
+static void BM_SelectScan(benchmark::State &state)
+{
+    TableParams params(state);
+    Database &db = get_database(params, false);
+    std::string query = range_query(params, state.range(3));
+    ResultSet rs;
+    for (auto _ : state)
+    {
+        rs = db.execute(query);
+        benchmark::DoNotOptimize(rs);
+    }
+    report(state, rs);
+}
+BENCHMARK(BM_SelectScan)->Apply(select_args)->Unit(benchmark::kMicrosecond);
+
+// Point selects submitted to the thread pool of the database at once
+static void BM_SelectBatch(benchmark::State &state)
+{
+    TableParams params(state);
+    Database &db = get_database(params, true);
+    std::vector<std::string> queries;
+    for (size_t i = 0; i < 1000; ++i)
+        queries.push_back("select id, name from t where num = " + std::to_string(i * params.rows / 1000));
+    for (auto _ : state)
+    {
+        auto results = db.execute_batch(queries);
+        for (auto &result : results)
+            benchmark::DoNotOptimize(result.get());
+    }
+    ExecutorStats stats = db.get_executor_stats();
+    state.counters["max_queue_depth"] = (double)stats.max_queue_depth;
+    state.counters["exec_ns"] = (double)stats.exec_ns / std::max<size_t>(1, stats.completed);
+    state.SetItemsProcessed(state.iterations() * queries.size());
+}
+BENCHMARK(BM_SelectBatch)->Apply(table_args)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+// Selecting all rows is dominated by making the result set
+static void BM_MakeResultSet(benchmark::State &state)
+{
+    TableParams params(state);
+    Database &db = get_database(params, false);
+    ResultSet rs;
+    for (auto _ : state)
+    {
+        rs = db.execute("select name, id from t");
+        benchmark::DoNotOptimize(rs);
+    }
+    report(state, rs);
+    state.SetBytesProcessed(state.iterations() * rs.get_stats().bytes_copied);
+}
+BENCHMARK(BM_MakeResultSet)->Apply(table_args)->Unit(benchmark::kMicrosecond);
+
+// Reading all values of a result by the column names and by the positions
+static void BM_IterateByName(benchmark::State &state)
+{
+    TableParams params(state);
+    ResultSet rs = get_database(params, false).execute("select name, id from t");
+    for (auto _ : state)
+    {
+        size_t sum = 0;
+        for (const auto &row : rs)
+            sum += row.get<int32_t>("id") + row.get<std::string>("name").size();
+        benchmark::DoNotOptimize(sum);
+    }
+    state.SetItemsProcessed(state.iterations() * rs.get_row_count());
+}
+BENCHMARK(BM_IterateByName)->Apply(table_args)->Unit(benchmark::kMicrosecond);
+
+static void BM_IterateByIndex(benchmark::State &state)
+{
+    TableParams params(state);
+    ResultSet rs = get_database(params, false).execute("select name, id from t");
+    size_t name = rs.get_column_index("name"), id = rs.get_column_index("id");
+    for (auto _ : state)
+    {
+        size_t sum = 0;
+        for (const auto &row : rs)
+            sum += row.get<int32_t>(id) + row.get_view<std::string_view>(name).size();
+        benchmark::DoNotOptimize(sum);
+    }
+    state.SetItemsProcessed(state.iterations() * rs.get_row_count());
+}
+BENCHMARK(BM_IterateByIndex)->Apply(table_args)->Unit(benchmark::kMicrosecond);
+
+static void BM_Save(benchmark::State &state)
+{
+    TableParams params(state);
+    Database &db = get_database(params, true);
+    size_t bytes = 0;
+    for (auto _ : state)
+    {
+        std::stringstream ss;
+        db.save_to_file(ss);
+        bytes = ss.str().size();
+    }
+    state.SetBytesProcessed(state.iterations() * bytes);
+}
+BENCHMARK(BM_Save)->Apply(table_args)->Unit(benchmark::kMillisecond);
+
+static void BM_Load(benchmark::State &state)
+{
+    TableParams params(state);
+    std::stringstream saved;
+    get_database(params, true).save_to_file(saved);
+    const std::string data = saved.str();
+    for (auto _ : state)
+    {
+        std::stringstream ss(data);
+        Database db;
+        db.load_from_file(ss);
+        benchmark::DoNotOptimize(db);
+    }
+    state.SetBytesProcessed(state.iterations() * data.size());
+}
+BENCHMARK(BM_Load)->Apply(table_args)->Unit(benchmark::kMillisecond);
+
+static const std::string SELECT_QUERY =
+    "select id, name, data from t where num >= 100 && num < 200 && (name > \"abc\" || data = 0x0102030405060708) && id % 2 = 0";
+
+static void BM_Lexer(benchmark::State &state)
+{
+    for (auto _ : state)
+    {
+        Lexer lexer(SELECT_QUERY);
+        auto lexems = lexer.tokenize();
+        benchmark::DoNotOptimize(lexems);
+    }
+    state.SetBytesProcessed(state.iterations() * SELECT_QUERY.size());
+}
+BENCHMARK(BM_Lexer);
+
+static void BM_Parser(benchmark::State &state)
+{
+    Lexer lexer(SELECT_QUERY);
+    const auto lexems = lexer.tokenize();
+    for (auto _ : state)
+    {
+        SelectParser parser(lexems);
+        SelectDef def = parser.parse();
+        benchmark::DoNotOptimize(def);
+    }
+    state.SetItemsProcessed(state.iterations() * lexems.size());
+}
+BENCHMARK(BM_Parser);
+
+int main(int argc, char **argv)
+{
+    // JSON by default to track the results across releases
+    std::vector<char *> args(argv, argv + argc);
+    bool has_format = false;
+    for (int i = 1; i < argc; ++i)
+        has_format = has_format || std::string(argv[i]).rfind("--benchmark_format", 0) == 0;
+    std::string json_format = "--benchmark_format=json";
+    if (!has_format)
+        args.push_back(&json_format[0]);
+    int n = (int)args.size();
+
+    benchmark::Initialize(&n, args.data());
+    if (benchmark::ReportUnrecognizedArguments(n, args.data()))
+        return 1;
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
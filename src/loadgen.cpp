@@ -0,0 +1,146 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <random>
+#include <algorithm>
+#include <csignal>
+#include <unistd.h>
+
+#include <memdb.h>
+#include <server.h>
+#include <client.h>
+
+using namespace memdb;
+
+// Load generator for memdb_server. Starts a server in the same process on a temporary socket,
+// fills a table and runs clients sending point selects with the given pipelining depth:
+//     memdb_loadgen [--rows N] [--clients N] [--depth N] [--queries N] [--range N]
+// With --range the selects return N rows instead of one.
+// Prints the throughput and the latency percentiles as JSON.
+
+struct Options
+{
+    size_t rows = 100000;
+    size_t clients = 4;
+    size_t depth = 16;
+    size_t queries = 100000; // per client
+    size_t range = 1;
+};
+
+static Options parse_options(int argc, char **argv)
+{
+    Options options;
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        std::string name = argv[i];
+        size_t value = std::stoul(argv[i + 1]);
+        if (name == "--rows")
+            options.rows = value;
+        else if (name == "--clients")
+            options.clients = value;
+        else if (name == "--depth")
+            options.depth = std::max<size_t>(1, value);
+        else if (name == "--queries")
+            options.queries = value;
+        else if (name == "--range")
+            options.range = std::max<size_t>(1, value);
+        else
+            throw std::runtime_error("Unknown option " + name);
+    }
+    return options;
+}
+
+static void populate(Database &db, size_t rows)
+{
+    db.execute("create table t ({key, autoincrement} id: int32, num: int32, name: string[16])");
+    RowWriter w = db.writer("t");
+    size_t num = w.column("num"), name = w.column("name");
+    for (size_t i = 0; i < rows; ++i)
+    {
+        w.set_int(num, (int32_t)i).set_string(name, "name" + std::to_string(i)).commit();
+    }
+    db.execute("create ordered index on t by num");
+}
+
+// Sends the queries keeping depth of them in flight, returns the latency of every query
+static std::vector<int64_t> run_client(const std::string &path, const Options &options, unsigned seed)
+{
+    Client client(path);
+    std::default_random_engine gen(seed);
+    std::uniform_int_distribution<size_t> distr(0, options.rows - options.range);
+    std::vector<std::chrono::steady_clock::time_point> sent(options.queries);
+    std::vector<int64_t> latencies;
+    latencies.reserve(options.queries);
+
+    size_t next = 0;
+    while (latencies.size() < options.queries)
+    {
+        while (next < options.queries && client.pending() < options.depth)
+        {
+            size_t from = distr(gen);
+            std::string query = "select id, name from t where num >= " + std::to_string(from) +
+                                " && num < " + std::to_string(from + options.range);
+            sent[next++] = std::chrono::steady_clock::now();
+            client.send(query);
+        }
+        ResultSet rs = client.receive();
+        if (!rs.is_ok() || rs.get_row_count() != options.range)
+            throw std::runtime_error("Unexpected result: " + rs.get_error());
+        latencies.push_back(elapsed_ns(sent[latencies.size()]));
+    }
+    return latencies;
+}
+
+int main(int argc, char **argv)
+{
+    try
+    {
+        Options options = parse_options(argc, argv);
+        std::signal(SIGPIPE, SIG_IGN);
+
+        Database db;
+        populate(db, options.rows);
+        std::string path = "/tmp/memdb_loadgen_" + std::to_string(::getpid()) + ".sock";
+        Server server(db, path);
+        std::thread server_thread([&server]() { server.run(); });
+
+        std::vector<std::vector<int64_t>> latencies(options.clients);
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        std::vector<std::thread> clients;
+        for (size_t c = 0; c < options.clients; ++c)
+        {
+            clients.emplace_back([&, c]() { latencies[c] = run_client(path, options, (unsigned)c); });
+        }
+        for (auto &client : clients)
+            client.join();
+        double seconds = elapsed_ns(start) / 1e9;
+
+        server.stop();
+        server_thread.join();
+
+        std::vector<int64_t> all;
+        for (const auto &l : latencies)
+            all.insert(all.end(), l.begin(), l.end());
+        std::sort(all.begin(), all.end());
+        auto percentile = [&all](double p) { return all.empty() ? 0 : all[std::min(all.size() - 1, (size_t)(p * all.size()))]; };
+
+        std::cout << "{\n"
+                  << "  \"clients\": " << options.clients << ",\n"
+                  << "  \"depth\": " << options.depth << ",\n"
+                  << "  \"rows_per_query\": " << options.range << ",\n"
+                  << "  \"queries\": " << all.size() << ",\n"
+                  << "  \"queries_per_second\": " << (size_t)(all.size() / seconds) << ",\n"
+                  << "  \"latency_p50_ns\": " << percentile(0.5) << ",\n"
+                  << "  \"latency_p99_ns\": " << percentile(0.99) << ",\n"
+                  << "  \"latency_max_ns\": " << (all.empty() ? 0 : all.back()) << "\n"
+                  << "}" << std::endl;
+    }
+    catch (std::exception &e)
+    {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
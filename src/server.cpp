@@ -0,0 +1,63 @@
+#include <iostream>
+#include <fstream>
+#include <csignal>
+
+#include <memdb.h>
+#include <server.h>
+
+using namespace memdb;
+
+// Serves a database over a Unix domain socket:
+//     memdb_server <socket path> [database file]
+// The database is loaded from the file on start and saved back on SIGINT or SIGTERM.
+
+static Server *server = nullptr;
+
+static void on_signal(int)
+{
+    if (server)
+        server->stop();
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        std::cerr << "Usage: " << argv[0] << " <socket path> [database file]" << std::endl;
+        return 1;
+    }
+    std::string path = argv[1];
+    std::string file = argc > 2 ? argv[2] : "";
+
+    Database db;
+    try
+    {
+        if (!file.empty())
+        {
+            std::ifstream in(file, std::ios::binary);
+            if (in)
+                db.load_from_file(in);
+        }
+
+        Server srv(db, path);
+        server = &srv;
+        std::signal(SIGPIPE, SIG_IGN);
+        std::signal(SIGINT, on_signal);
+        std::signal(SIGTERM, on_signal);
+        std::cout << "Listening on " << path << std::endl;
+        srv.run();
+        server = nullptr;
+    }
+    catch (std::runtime_error &e)
+    {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+
+    if (!file.empty())
+    {
+        std::ofstream out(file, std::ios::binary);
+        db.save_to_file(out);
+    }
+    return 0;
+}